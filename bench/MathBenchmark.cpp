@@ -0,0 +1,248 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	MathBenchmark.cpp
+ *
+ * Microbenchmarks of Vec3f, Mat4f and Quat4f against the glm types that
+ * do the same job (make bench, then ./A3mathbench). Every case runs one
+ * operation over arrays of 1024 inputs, repeated until a sample takes
+ * about a millisecond, and reports the median time per operation over
+ * all samples for both libraries and their ratio.
+ *
+ * Outputs go to global arrays and keep() hides values from the optimizer,
+ * so the loops cannot be removed; the inputs are fixed pseudo-random
+ * values, so runs are repeatable.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "Mat4f.h"
+#include "Quat4f.h"
+#include "Vec3f.h"
+
+namespace {
+const int N = 1024;
+
+struct Case {
+  char const *name;
+  void (*ours)();
+  void (*glm)();
+};
+
+struct Result {
+  char const *name;
+  double oursNs, glmNs;
+};
+
+// Tell the compiler x is read, so its computation stays
+template <typename T> inline void keep(T const &x) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(&x) : "memory");
+#else
+  static void const *volatile sink;
+  sink = &x;
+#endif
+}
+
+// Inputs and outputs of both libraries, filled by fillInputs
+float f[N + 3], angle[N];
+Vec3f v[N], w[N], vOut[N];
+glm::vec3 gv[N], gw[N], gvOut[N];
+Quat4f q[N], r[N], qOut[N];
+glm::quat gq[N], gr[N], gqOut[N];
+std::vector<Mat4f> a, b, mOut;
+glm::mat4 ga[N], gb[N], gmOut[N];
+
+// Repeatable values in [-1, 1)
+float next() {
+  static unsigned state = 12345;
+  state = state * 1664525u + 1013904223u;
+  return (state >> 8) * (2.f / 16777216.f) - 1.f;
+}
+
+void fillInputs() {
+  for (float &x : f)
+    x = next();
+  for (int i = 0; i < N; ++i) {
+    angle[i] = 3.f * next();
+    v[i] = Vec3f(next(), next(), next());
+    w[i] = Vec3f(next(), next(), next() + 2.f); // away from zero
+    gv[i] = glm::vec3(v[i].x(), v[i].y(), v[i].z());
+    gw[i] = glm::vec3(w[i].x(), w[i].y(), w[i].z());
+
+    float re = next(), x = next(), y = next(), z = next();
+    q[i] = Quat4f(re, x, y, z).normalized();
+    gq[i] = glm::normalize(glm::quat(re, x, y, z));
+    re = next(), x = next(), y = next(), z = next();
+    r[i] = Quat4f(re, x, y, z).normalized();
+    gr[i] = glm::normalize(glm::quat(re, x, y, z));
+  }
+
+  a.clear();
+  b.clear();
+  mOut.clear();
+  for (int i = 0; i < N; ++i) {
+    a.push_back(Mat4f());
+    b.push_back(Mat4f());
+    mOut.push_back(Mat4f(0.f));
+    for (int k = 0; k < Mat4f::NUM_ELEM; ++k) {
+      a[i][k] = next();
+      b[i][k] = next();
+      ga[i][k / 4][k % 4] = a[i][k];
+      gb[i][k / 4][k % 4] = b[i][k];
+    }
+  }
+}
+
+// clang-format off
+const Case CASES[] = {
+  {"vec3 construct",
+   [] { for (int i = 0; i < N; ++i) new (&vOut[i]) Vec3f(f[i], f[i + 1], f[i + 2]); keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) new (&gvOut[i]) glm::vec3(f[i], f[i + 1], f[i + 2]); keep(gvOut); }},
+  {"vec3 copy",
+   [] { for (int i = 0; i < N; ++i) vOut[i] = v[i]; keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) gvOut[i] = gv[i]; keep(gvOut); }},
+  {"vec3 scale and add",
+   [] { for (int i = 0; i < N; ++i) vOut[i] = v[i] * f[i] + w[i]; keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) gvOut[i] = gv[i] * f[i] + gw[i]; keep(gvOut); }},
+  {"vec3 cross",
+   [] { for (int i = 0; i < N; ++i) vOut[i] = v[i] ^ w[i]; keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) gvOut[i] = glm::cross(gv[i], gw[i]); keep(gvOut); }},
+  {"vec3 normalize",
+   [] { for (int i = 0; i < N; ++i) vOut[i] = w[i].normalized(); keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) gvOut[i] = glm::normalize(gw[i]); keep(gvOut); }},
+  {"mat4 construct",
+   [] { for (int i = 0; i < N; ++i) { Mat4f m(f[i]); keep(m[0]); } },
+   [] { for (int i = 0; i < N; ++i) { glm::mat4 m(f[i]); keep(m); } }},
+  {"mat4 copy",
+   [] { for (int i = 0; i < N; ++i) { Mat4f m(a[i]); keep(m[0]); } },
+   [] { for (int i = 0; i < N; ++i) { glm::mat4 m(ga[i]); keep(m); } }},
+  {"mat4 move",
+   [] { for (int i = 0; i < N; ++i) { Mat4f m(std::move(a[i])); a[i] = std::move(m); } keep(a[0][0]); },
+   [] { for (int i = 0; i < N; ++i) { glm::mat4 m(std::move(ga[i])); ga[i] = std::move(m); } keep(ga); }},
+  {"mat4 multiply",
+   [] { for (int i = 0; i < N; ++i) mOut[i] = a[i] * b[i]; keep(mOut[0][0]); },
+   [] { for (int i = 0; i < N; ++i) gmOut[i] = ga[i] * gb[i]; keep(gmOut); }},
+  {"quat multiply",
+   [] { for (int i = 0; i < N; ++i) qOut[i] = q[i] * r[i]; keep(qOut); },
+   [] { for (int i = 0; i < N; ++i) gqOut[i] = gq[i] * gr[i]; keep(gqOut); }},
+  {"quat normalize",
+   [] { for (int i = 0; i < N; ++i) qOut[i] = (q[i] * 3.f).normalized(); keep(qOut); },
+   [] { for (int i = 0; i < N; ++i) gqOut[i] = glm::normalize(gq[i] * 3.f); keep(gqOut); }},
+  {"quat rotate vec3",
+   [] { for (int i = 0; i < N; ++i) vOut[i] = q[i] * v[i]; keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) gvOut[i] = gq[i] * gv[i]; keep(gvOut); }},
+  {"quat to mat4",
+   [] { for (int i = 0; i < N; ++i) mOut[i] = q[i].matrix4f(); keep(mOut[0][0]); },
+   [] { for (int i = 0; i < N; ++i) gmOut[i] = glm::mat4_cast(gq[i]); keep(gmOut); }},
+  // In place, as the camera uses it
+  {"rotateAround",
+   [] { for (int i = 0; i < N; ++i) { vOut[i] = v[i]; rotateAround(vOut[i], w[i], angle[i]); } keep(vOut); },
+   [] { for (int i = 0; i < N; ++i) gvOut[i] = glm::angleAxis(angle[i], glm::normalize(gw[i])) * gv[i]; keep(gvOut); }},
+};
+// clang-format on
+
+double seconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+// Median nanoseconds per operation
+double measure(void (*run)(), int samples) {
+  typedef std::chrono::steady_clock Clock;
+
+  // Enough passes for about 1 ms per sample
+  int passes = 1;
+  for (;;) {
+    Clock::time_point start = Clock::now();
+    for (int p = 0; p < passes; ++p)
+      run();
+    if (seconds(Clock::now() - start) > 1e-3 || passes >= 1 << 20)
+      break;
+    passes *= 2;
+  }
+
+  std::vector<double> ns;
+  for (int s = 0; s < samples; ++s) {
+    Clock::time_point start = Clock::now();
+    for (int p = 0; p < passes; ++p)
+      run();
+    ns.push_back(seconds(Clock::now() - start) * 1e9 / (double(passes) * N));
+  }
+  std::sort(ns.begin(), ns.end());
+  return ns[ns.size() / 2];
+}
+
+void writeJson(std::ostream &out, std::vector<Result> const &results) {
+  out << "{\n  \"benchmark\": \"A3mathbench\",\n"
+      << "  \"compiler\": \"" << __VERSION__ << "\",\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "    {\"case\": \"%s\", \"ours_ns\": %.4f, \"glm_ns\": "
+                  "%.4f}%s\n",
+                  results[i].name, results[i].oursNs, results[i].glmNs,
+                  i + 1 < results.size() ? "," : "");
+    out << line;
+  }
+  out << "  ]\n}\n";
+}
+
+void usage() {
+  std::cerr << "Usage: A3mathbench [--filter text] [--samples N] "
+               "[--out results.json]\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string filter, out;
+  int samples = 31;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 < argc && !std::strcmp(argv[i], "--filter"))
+      filter = argv[i + 1];
+    else if (i + 1 < argc && !std::strcmp(argv[i], "--samples"))
+      samples = std::max(1, std::atoi(argv[i + 1]));
+    else if (i + 1 < argc && !std::strcmp(argv[i], "--out"))
+      out = argv[i + 1];
+    else {
+      usage();
+      return 2;
+    }
+  }
+
+  fillInputs();
+
+  std::vector<Result> results;
+  std::printf("%-20s %12s %12s %8s\n", "ns per operation", "ours", "glm",
+              "ours/glm");
+  for (Case const &c : CASES) {
+    if (std::string(c.name).find(filter) == std::string::npos)
+      continue;
+    Result r = {c.name, measure(c.ours, samples), measure(c.glm, samples)};
+    std::printf("%-20s %12.3f %12.3f %8.2f\n", r.name, r.oursNs, r.glmNs,
+                r.oursNs / r.glmNs);
+    results.push_back(r);
+  }
+
+  if (!out.empty()) {
+    std::ofstream file(out.c_str());
+    writeJson(file, results);
+    if (!file) {
+      std::cerr << "Cannot write " << out << std::endl;
+      return 2;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,535 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SimBenchmark.cpp
+ *
+ * Headless solver benchmark (make bench, then ./A3bench). Steps the
+ * chain, cube and cloth scenes at sizes from 10^2 particles up with every
+ * integrator and thread count, and writes the median and p99 step time,
+ * particles * steps per second and memory per case as JSON.
+ *
+ * The memory figures are the case's own buffer pool bytes: the scene
+ * and solver arrays in use, and everything reserved from the system while
+ * building and stepping it. Each case starts from an empty scene and a
+ * trimmed pool, and its solvers are freed when it ends. With
+ * --baseline it compares the run against a saved result file and exits
+ * with status 1 when a case got slower than the tolerance allows.
+ *
+ * Scenes are built the same way on every run and only the step itself is
+ * timed, so two runs on the same machine are directly comparable. Each
+ * case runs a few warm-up steps, then at least --min-steps steps and
+ * --seconds of stepping (or exactly --steps).
+ *
+ * Built with make ALLOCS=1, the heap allocations of the timed steps are
+ * counted too; any allocation after the warm-up is reported and makes
+ * the run exit with status 1.
+ *
+ * --numa pins the pool threads and moves each domain of the domain
+ * integrator to its thread's NUMA node; compare it against a run without
+ * on the big scenes (--min 1e6 --max 1e7).
+ *
+ * The SIMD kernels run in the widest variant the CPU supports; --isa
+ * forces another one (sse2, sse4.2, avx2, avx512) to compare them. The
+ * variant is recorded in the JSON.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AllocCounter.h"
+#include "BufferPool.h"
+#include "DomainSolver.h"
+#include "FusedForceSolver.h"
+#include "GraphPartitioner.h"
+#include "MassSpringSystem.h"
+#include "NumaPlacement.h"
+#include "SimdKernels.h"
+#include "SpatialReorder.h"
+#include "SpringColouring.h"
+#include "ThreadPool.h"
+#include "TreeSolver.h"
+#include "XPBDSolver.h"
+
+namespace {
+enum Scene { CHAIN, CUBE, CLOTH, NUM_SCENES };
+enum Integrator { FORCE, FUSED, DOMAIN, XPBD, TREE, LATTICE, NUM_INTEGRATORS };
+
+char const *const SCENE_NAMES[NUM_SCENES] = {"chain", "cube", "cloth"};
+char const *const INTEGRATOR_NAMES[NUM_INTEGRATORS] = {
+    "force", "fused", "domain", "xpbd", "tree", "lattice"};
+
+const int WARMUP_STEPS = 3;
+// Masses per task in the force integrator's collision and integration
+const int MASS_GRAIN = 1024;
+
+struct Options {
+  std::vector<int> scenes, integrators, threads;
+  double minSize = 1e2, maxSize = 1e6;
+  int steps = 0; // fixed step count, 0 = adaptive
+  int minSteps = 10;
+  double seconds = 0.5;
+  std::string out, baseline;
+  double tolerance = 0.1;
+  bool numa = false, hugePages = false;
+  SimdKernels::Isa isa = SimdKernels::best();
+};
+
+struct Result {
+  std::string scene, integrator;
+  int threads;
+  long long size; // requested particles
+  long long particles, springs;
+  int steps;
+  double medianMs, p99Ms, meanMs;
+  double particleSteps; // per second
+  long long poolUsedBytes, poolReservedBytes;
+  double allocsPerStep; // heap allocations, with make ALLOCS=1
+};
+
+// Per-scene data of one case, kept between steps like in main()
+struct Solvers {
+  XPBDSolver xpbd;
+  TreeSolver treeSolver;
+  FusedForceSolver fused;
+  SpringColouring colouring;
+  DomainSolver domains;
+  GraphPartitioner partitioner;
+  SpatialReorder reorder;
+  PoolVector<float> lines, quads;
+};
+
+// Nearest grid for about `size` particles; the lattice integrator has its
+// own copy of the cube and cloth and no chain
+bool buildScene(int scene, int integrator, long long size) {
+  bool onLattice = integrator == LATTICE;
+  switch (scene) {
+  case CHAIN:
+    if (onLattice)
+      return false;
+    initChain(std::max<long long>(size, 2));
+    break;
+  case CUBE: {
+    int side = std::max(2, int(std::lround(std::cbrt(double(size)))));
+    if (onLattice)
+      initLatticeCube(side);
+    else
+      initCube(side);
+    break;
+  }
+  case CLOTH: {
+    int side = std::max(2, int(std::lround(std::sqrt(double(size)))));
+    if (onLattice)
+      initLatticeCloth(side, side);
+    else
+      initCloth(side, side);
+    break;
+  }
+  }
+  return true;
+}
+
+// Per-scene solver data, after the scene is built; false if the
+// integrator does not apply
+bool prepare(int integrator, int threads, Solvers &sv) {
+  switch (integrator) {
+  case FORCE:
+    sv.colouring.rebuild(masses, springs);
+    return true;
+  case FUSED:
+    sv.colouring.rebuild(masses, springs);
+    sv.fused.rebuild(masses, springs);
+    sv.lines.resize(3 * 2 * numSpring);
+    sv.quads.resize(3 * 6 * numMass);
+    return true;
+  case DOMAIN: {
+    std::vector<int> part =
+        sv.partitioner.partition(masses, springs, threads);
+    sv.reorder.reset(numMass);
+    sv.reorder.group(masses, springs, part);
+    sv.domains.rebuild(masses, springs, part, threads);
+    return true;
+  }
+  case XPBD:
+    sv.xpbd.rebuild(masses, springs);
+    return true;
+  case TREE:
+    // Only loop-free scenes (the chain)
+    return sv.treeSolver.rebuild(masses, springs);
+  case LATTICE:
+    return lattice.size() > 0;
+  }
+  return false;
+}
+
+void step(int integrator, Solvers &sv, ThreadPool &pool) {
+  stepArena.reset();
+  switch (integrator) {
+  case FORCE: {
+    // Same passes as the plain force path in main()
+    char *contacts = stepArena.allocate<char>(numMass);
+    sv.colouring.applyForces(springs, pool);
+    pool.parallelFor(0, numMass, MASS_GRAIN, [&](int begin, int end) {
+      floorContacts(masses.data() + begin, end - begin, contacts + begin);
+    });
+    pool.parallelFor(0, numMass, MASS_GRAIN, [&](int begin, int end) {
+      integrateMasses(masses.data() + begin, contacts + begin, end - begin);
+    });
+    break;
+  }
+  case FUSED:
+    sv.fused.step(masses, springs, sv.colouring, sv.lines.data(),
+                  sv.quads.data(), pool);
+    break;
+  case DOMAIN:
+    sv.domains.step(masses, springs, pool);
+    break;
+  case XPBD:
+    sv.xpbd.step(masses, springs, timestep, pool);
+    break;
+  case TREE:
+    sv.treeSolver.step(masses, springs, timestep, pool);
+    break;
+  case LATTICE:
+    lattice.step(timestep, pool);
+    break;
+  }
+}
+
+bool runCase(Options const &options, int scene, int integrator,
+             ThreadPool &pool, long long size, Result &r) {
+  BufferPool &buffers = BufferPool::global();
+  clearScene();
+  buffers.trim();
+  long long usedBefore = buffers.usedBytes();
+  long long reservedBefore = buffers.reservedBytes();
+
+  int threads = pool.size();
+  Solvers sv;
+  if (!buildScene(scene, integrator, size) ||
+      !prepare(integrator, threads, sv))
+    return false;
+  if (options.numa && integrator == DOMAIN)
+    sv.domains.place(masses, springs, pool);
+
+  typedef std::chrono::steady_clock Clock;
+  for (int i = 0; i < WARMUP_STEPS; i++)
+    step(integrator, sv, pool);
+
+  std::vector<double> ms;
+  double total = 0;
+  int64_t allocs = 0;
+  while (options.steps > 0
+             ? int(ms.size()) < options.steps
+             : int(ms.size()) < options.minSteps || total < options.seconds) {
+    int64_t allocsBefore = AllocCounter::allocations();
+    Clock::time_point start = Clock::now();
+    step(integrator, sv, pool);
+    double s = std::chrono::duration<double>(Clock::now() - start).count();
+    allocs += AllocCounter::allocations() - allocsBefore;
+    ms.push_back(s * 1e3);
+    total += s;
+  }
+
+  std::sort(ms.begin(), ms.end());
+  size_t n = ms.size();
+
+  r.scene = SCENE_NAMES[scene];
+  r.integrator = INTEGRATOR_NAMES[integrator];
+  r.threads = threads;
+  r.size = size;
+  r.particles = numMass;
+  r.springs = integrator == LATTICE ? lattice.numSprings() : numSpring;
+  r.steps = n;
+  r.medianMs = n % 2 ? ms[n / 2] : 0.5 * (ms[n / 2 - 1] + ms[n / 2]);
+  r.p99Ms = ms[std::min(n - 1, size_t(std::ceil(0.99 * n)) - 1)];
+  r.meanMs = total * 1e3 / n;
+  r.particleSteps = double(numMass) * n / total;
+  r.poolUsedBytes = buffers.usedBytes() - usedBefore;
+  r.poolReservedBytes = buffers.reservedBytes() - reservedBefore;
+  r.allocsPerStep = double(allocs) / n;
+  return true;
+}
+
+// One result per line, so a saved file can be read back line by line
+void writeJson(std::ostream &out, std::vector<Result> const &results) {
+  out << "{\n  \"benchmark\": \"A3bench\",\n"
+      << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+      << "  \"hardware_threads\": " << std::thread::hardware_concurrency()
+      << ",\n  \"isa\": \"" << SimdKernels::name(SimdKernels::selected())
+      << "\",\n  \"timestep\": " << timestep << ",\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    Result const &r = results[i];
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "    {\"scene\": \"%s\", \"integrator\": \"%s\", "
+                  "\"threads\": %d, \"size\": %lld, \"particles\": %lld, "
+                  "\"springs\": %lld, \"steps\": %d, \"median_ms\": %.6f, "
+                  "\"p99_ms\": %.6f, \"mean_ms\": %.6f, "
+                  "\"particle_steps_per_s\": %.6g, \"pool_used_bytes\": "
+                  "%lld, \"pool_reserved_bytes\": %lld",
+                  r.scene.c_str(), r.integrator.c_str(), r.threads, r.size,
+                  r.particles, r.springs, r.steps, r.medianMs, r.p99Ms,
+                  r.meanMs, r.particleSteps, r.poolUsedBytes,
+                  r.poolReservedBytes);
+    out << line;
+    if (AllocCounter::compiled()) {
+      std::snprintf(line, sizeof(line), ", \"allocs_per_step\": %.6g",
+                    r.allocsPerStep);
+      out << line;
+    }
+    out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+}
+
+// Value of "key" in one line written by writeJson
+std::string field(std::string const &line, char const *key) {
+  std::string tag = std::string("\"") + key + "\":";
+  size_t at = line.find(tag);
+  if (at == std::string::npos)
+    return "";
+  at = line.find_first_not_of(' ', at + tag.size());
+  if (at == std::string::npos)
+    return "";
+  if (line[at] == '"') {
+    size_t end = line.find('"', at + 1);
+    return line.substr(at + 1, end - at - 1);
+  }
+  size_t end = line.find_first_of(",}", at);
+  return line.substr(at, end - at);
+}
+
+bool readBaseline(char const *path, std::vector<Result> &results) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Cannot read baseline " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (field(line, "scene").empty())
+      continue;
+    Result r = Result();
+    r.scene = field(line, "scene");
+    r.integrator = field(line, "integrator");
+    r.threads = std::atoi(field(line, "threads").c_str());
+    r.size = std::atoll(field(line, "size").c_str());
+    r.medianMs = std::atof(field(line, "median_ms").c_str());
+    r.p99Ms = std::atof(field(line, "p99_ms").c_str());
+    results.push_back(r);
+  }
+  return true;
+}
+
+// Median step time against the baseline; true if nothing regressed
+bool compare(std::vector<Result> const &results,
+             std::vector<Result> const &baseline, double tolerance) {
+  int regressions = 0, matched = 0;
+  std::printf("\n%-6s %-8s %7s %9s %12s %12s %8s\n", "scene", "solver",
+              "threads", "size", "base ms", "now ms", "change");
+  for (Result const &r : results) {
+    Result const *base = nullptr;
+    for (Result const &b : baseline)
+      if (b.scene == r.scene && b.integrator == r.integrator &&
+          b.threads == r.threads && b.size == r.size)
+        base = &b;
+    if (!base || base->medianMs <= 0) {
+      std::printf("%-6s %-8s %7d %9lld %12s %12.4f %8s\n", r.scene.c_str(),
+                  r.integrator.c_str(), r.threads, r.size, "-", r.medianMs,
+                  "new");
+      continue;
+    }
+
+    ++matched;
+    double change = r.medianMs / base->medianMs - 1;
+    bool slower = change > tolerance;
+    regressions += slower;
+    std::printf("%-6s %-8s %7d %9lld %12.4f %12.4f %+7.1f%%%s\n",
+                r.scene.c_str(), r.integrator.c_str(), r.threads, r.size,
+                base->medianMs, r.medianMs, 100 * change,
+                slower ? "  REGRESSION" : "");
+  }
+
+  std::printf("%d of %d cases matched the baseline, %d regressed by more "
+              "than %.0f%%\n",
+              matched, int(results.size()), regressions, 100 * tolerance);
+  return regressions == 0;
+}
+
+// "a,b,c" -> indices into names; false on an unknown name
+bool parseNames(char const *list, char const *const *names, int count,
+                std::vector<int> &out) {
+  std::stringstream in(list);
+  std::string name;
+  while (std::getline(in, name, ',')) {
+    int i = 0;
+    while (i < count && name != names[i])
+      ++i;
+    if (i == count) {
+      std::cerr << "Unknown name " << name << std::endl;
+      return false;
+    }
+    out.push_back(i);
+  }
+  return true;
+}
+
+void usage() {
+  std::cerr
+      << "Usage: A3bench [options]\n"
+         "  --scenes chain,cube,cloth\n"
+         "  --integrators force,fused,domain,xpbd,tree,lattice\n"
+         "  --threads 1,2,4        (default: powers of 2 up to the cores)\n"
+         "  --min 1e2 --max 1e6    particle counts, every power of 10\n"
+         "  --steps N              fixed step count per case\n"
+         "  --min-steps N --seconds S   adaptive count (default 10, 0.5)\n"
+         "  --out results.json     (default: stdout)\n"
+         "  --baseline old.json --tolerance 0.1\n"
+         "  --numa                 pin threads, place domains on their nodes\n"
+         "  --huge-pages           transparent huge pages for big arrays\n"
+         "  --isa sse2|sse4.2|avx2|avx512   SIMD kernel variant\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &o) {
+  for (int i = 1; i < argc; ++i) {
+    char const *arg = argv[i];
+    if (!std::strcmp(arg, "--numa")) {
+      o.numa = true;
+      continue;
+    }
+    if (!std::strcmp(arg, "--huge-pages")) {
+      o.hugePages = true;
+      continue;
+    }
+    char const *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool ok = value != nullptr;
+    if (ok && !std::strcmp(arg, "--scenes"))
+      ok = parseNames(value, SCENE_NAMES, NUM_SCENES, o.scenes);
+    else if (ok && !std::strcmp(arg, "--integrators"))
+      ok = parseNames(value, INTEGRATOR_NAMES, NUM_INTEGRATORS,
+                      o.integrators);
+    else if (ok && !std::strcmp(arg, "--threads")) {
+      std::stringstream in(value);
+      std::string n;
+      while (std::getline(in, n, ','))
+        o.threads.push_back(std::max(1, std::atoi(n.c_str())));
+    } else if (ok && !std::strcmp(arg, "--min"))
+      o.minSize = std::atof(value);
+    else if (ok && !std::strcmp(arg, "--max"))
+      o.maxSize = std::atof(value);
+    else if (ok && !std::strcmp(arg, "--steps"))
+      o.steps = std::atoi(value);
+    else if (ok && !std::strcmp(arg, "--min-steps"))
+      o.minSteps = std::max(1, std::atoi(value));
+    else if (ok && !std::strcmp(arg, "--seconds"))
+      o.seconds = std::atof(value);
+    else if (ok && !std::strcmp(arg, "--out"))
+      o.out = value;
+    else if (ok && !std::strcmp(arg, "--baseline"))
+      o.baseline = value;
+    else if (ok && !std::strcmp(arg, "--tolerance"))
+      o.tolerance = std::atof(value);
+    else if (ok && !std::strcmp(arg, "--isa"))
+      ok = SimdKernels::parse(value, o.isa);
+    else
+      ok = false;
+
+    if (!ok) {
+      usage();
+      return false;
+    }
+    ++i;
+  }
+
+  if (o.scenes.empty())
+    for (int s = 0; s < NUM_SCENES; ++s)
+      o.scenes.push_back(s);
+  if (o.integrators.empty())
+    for (int k = 0; k < NUM_INTEGRATORS; ++k)
+      o.integrators.push_back(k);
+  if (o.threads.empty()) {
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int n = 1; n < cores; n *= 2)
+      o.threads.push_back(n);
+    o.threads.push_back(cores);
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options))
+    return 2;
+
+  std::vector<Result> baseline;
+  if (!options.baseline.empty() &&
+      !readBaseline(options.baseline.c_str(), baseline))
+    return 2;
+
+  if (options.hugePages)
+    BufferPool::global().setHugePages(true);
+  if (!SimdKernels::select(options.isa)) {
+    std::cerr << "This CPU does not support " << SimdKernels::name(options.isa)
+              << std::endl;
+    return 2;
+  }
+
+  std::vector<Result> results;
+  int allocating = 0;
+  for (int threads : options.threads) {
+    ThreadPool pool(threads);
+    if (options.numa)
+      NumaPlacement::pinThreads(pool);
+    for (int scene : options.scenes)
+      for (int integrator : options.integrators)
+        for (double size = options.minSize; size <= options.maxSize * 1.001;
+             size *= 10) {
+          Result r;
+          if (!runCase(options, scene, integrator, pool, std::llround(size),
+                       r))
+            continue;
+          std::fprintf(stderr,
+                       "%-6s %-8s %2d threads %9lld particles: median "
+                       "%.4f ms, p99 %.4f ms, %.3g particle steps/s\n",
+                       r.scene.c_str(), r.integrator.c_str(), r.threads,
+                       r.particles, r.medianMs, r.p99Ms, r.particleSteps);
+          if (r.allocsPerStep > 0) {
+            std::fprintf(stderr, "  %.3g heap allocations per step\n",
+                         r.allocsPerStep);
+            ++allocating;
+          }
+          results.push_back(r);
+        }
+  }
+  clearScene();
+
+  if (options.out.empty())
+    writeJson(std::cout, results);
+  else {
+    std::ofstream out(options.out.c_str());
+    writeJson(out, results);
+    if (!out) {
+      std::cerr << "Cannot write " << options.out << std::endl;
+      return 2;
+    }
+  }
+
+  if (allocating > 0) {
+    std::fprintf(stderr, "%d cases allocated while stepping\n", allocating);
+    return 1;
+  }
+  if (!baseline.empty() && !compare(results, baseline, options.tolerance))
+    return 1;
+  return 0;
+}
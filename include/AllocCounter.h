@@ -0,0 +1,101 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	AllocCounter.h
+ *
+ * Debug accounting of heap allocations. Building with -DA3_COUNT_ALLOCS
+ * (make ALLOCS=1) replaces the global operator new and delete with
+ * versions that count calls and bytes per phase. The phase of an
+ * allocation is the innermost PROFILE_SCOPE open on the allocating thread
+ * (ALLOC_PHASE names one without a timer), so the timer names double as
+ * allocation sites. report() prints the allocations per frame of every
+ * phase.
+ *
+ * forbid(true) makes every later allocation fatal: it prints the size
+ * and phase and aborts, so a frame loop that must not allocate can be
+ * checked on every run. Allow lifts the ban on one thread for a block
+ * (scene changes, input handling); those allocations are still counted.
+ * Ignore also leaves them out of the counts, for instrumentation that
+ * grows its own storage while profiling (the Profiler's event blocks).
+ * Only operator new is counted; malloc from C code (GL drivers, stdio)
+ * is not.
+ *
+ * Without A3_COUNT_ALLOCS nothing is counted, forbid does nothing and
+ * the macros compile to nothing.
+ */
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+#include <iosfwd>
+
+class AllocCounter {
+public:
+  // True when built with A3_COUNT_ALLOCS
+  static bool compiled();
+
+  // Frame count for the per frame figures of report()
+  static void nextFrame();
+
+  // Allocations so far, all threads and phases
+  static int64_t allocations();
+
+  // Zero all counts and the frame count, e.g. after a warm-up
+  static void reset();
+
+  static void forbid(bool on);
+
+  static void report(std::ostream &out);
+
+  // Phase of the calling thread's allocations for the enclosing block
+  class Phase {
+  public:
+    explicit Phase(char const *name);
+    ~Phase();
+
+    Phase(Phase const &) = delete;
+    Phase &operator=(Phase const &) = delete;
+
+  private:
+    char const *m_outer;
+  };
+
+  // The calling thread may allocate during the enclosing block
+  class Allow {
+  public:
+    Allow();
+    ~Allow();
+
+    Allow(Allow const &) = delete;
+    Allow &operator=(Allow const &) = delete;
+  };
+
+  // The calling thread's allocations during the enclosing block are
+  // neither counted nor forbidden
+  class Ignore {
+  public:
+    Ignore();
+    ~Ignore();
+
+    Ignore(Ignore const &) = delete;
+    Ignore &operator=(Ignore const &) = delete;
+  };
+};
+
+#ifdef A3_COUNT_ALLOCS
+#define ALLOC_CONCAT2(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT2(a, b)
+#define ALLOC_PHASE(name)                                                    \
+  AllocCounter::Phase ALLOC_CONCAT(allocPhase_, __LINE__)(name)
+#define ALLOC_ALLOW()                                                        \
+  AllocCounter::Allow ALLOC_CONCAT(allocAllow_, __LINE__)
+#define ALLOC_IGNORE()                                                       \
+  AllocCounter::Ignore ALLOC_CONCAT(allocIgnore_, __LINE__)
+#else
+#define ALLOC_PHASE(name) ((void)0)
+#define ALLOC_ALLOW() ((void)0)
+#define ALLOC_IGNORE() ((void)0)
+#endif
+
+#endif // ALLOC_COUNTER_H
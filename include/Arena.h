@@ -0,0 +1,63 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	Arena.h
+ *
+ * Monotonic arena for temporaries that live for one step (contact flags,
+ * solver work vectors). Allocation bumps a pointer in the current block;
+ * nothing is freed individually, reset() frees everything at once. When
+ * a step outgrows the block, more blocks are chained on, and the next
+ * reset() replaces them with one block of the combined size, so after the
+ * first few steps the arena never allocates again.
+ *
+ * Blocks come from BufferPool::global(). An arena is not thread safe:
+ * allocate from the thread that owns it (e.g. before a parallel loop) and
+ * hand the pointers to the workers.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+
+#include "BufferPool.h"
+
+class Arena {
+public:
+  explicit Arena(size_t blockBytes = 64 << 10);
+  ~Arena();
+
+  Arena(Arena const &) = delete;
+  Arena &operator=(Arena const &) = delete;
+
+  void *allocate(size_t bytes, size_t align = BufferPool::CACHE_LINE);
+
+  // Uninitialised storage for n T, on a cache line
+  template <typename T> T *allocate(size_t n) {
+    return static_cast<T *>(allocate(n * sizeof(T)));
+  }
+
+  // Frees everything allocated since the last reset
+  void reset();
+
+  // Bytes allocated since the last reset, and the size of all blocks
+  size_t usedBytes() const { return m_used; }
+  size_t capacity() const;
+
+private:
+  struct Block {
+    Block *next;
+    size_t size; // including this header
+  };
+  enum { HEADER = BufferPool::CACHE_LINE };
+
+  void addBlock(size_t bytes);
+  void releaseBlocks();
+
+  Block *m_blocks; // newest first
+  char *m_top, *m_end;
+  size_t m_used;
+  size_t m_blockBytes;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,123 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	BufferPool.h
+ *
+ * Pool of aligned buffers for the arrays whose size follows the scene
+ * topology (masses, springs, solver tables). Sizes are rounded up to a
+ * power of two and released buffers stay on a free list of their size
+ * class, so rebuilding a scene, or growing a vector by doubling, reuses
+ * memory instead of going back to the system allocator. Buffers of a
+ * huge page or more are rounded to whole huge pages instead, so a big
+ * array wastes less than a page, and are reused only at exactly that
+ * size. Memory is only returned to the system by trim(), which main()
+ * calls after each scene rebuild.
+ *
+ * Every buffer starts on a cache line; buffers of a huge page (2 MB) or
+ * more start on a huge page boundary. On Linux those are mapped directly
+ * (fresh pages, so NumaPlacement can place them), and after
+ * setHugePages(true) they ask for transparent huge pages.
+ *
+ * PoolAllocator puts a standard container in the global pool, and
+ * PoolVector<T> is a std::vector that does.
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <new>
+#include <vector>
+
+class BufferPool {
+public:
+  enum { CACHE_LINE = 64, HUGE_PAGE = 2 << 20 };
+
+  BufferPool();
+  ~BufferPool();
+
+  BufferPool(BufferPool const &) = delete;
+  BufferPool &operator=(BufferPool const &) = delete;
+
+  // Pool shared by PoolAllocator; never destroyed, so globals can free
+  // into it at exit
+  static BufferPool &global();
+
+  // At least bytes, aligned as described above. Throws std::bad_alloc.
+  void *allocate(size_t bytes);
+  // bytes must be the size the buffer was allocated with
+  void release(void *p, size_t bytes);
+
+  // Return the free buffers to the system
+  void trim();
+
+  // madvise(MADV_HUGEPAGE) on buffers of HUGE_PAGE bytes or more that
+  // are mapped from now on (Linux)
+  void setHugePages(bool on);
+
+  // Bytes obtained from the system (in use or free), and in use
+  size_t reservedBytes() const;
+  size_t usedBytes() const;
+  // Buffers obtained from the system so far
+  int64_t systemAllocations() const;
+
+  void report(std::ostream &out) const;
+
+private:
+  enum { MIN_CLASS = 6, NUM_CLASSES = 8 * sizeof(size_t) };
+
+  static int sizeClass(size_t bytes);
+  // Bytes actually reserved for a request of bytes
+  static size_t bufferSize(size_t bytes);
+  void *systemAllocate(size_t size);
+  void systemRelease(void *p, size_t size);
+
+  struct FreeBuffer {
+    FreeBuffer *next;
+  };
+  struct LargeBuffer {
+    LargeBuffer *next;
+    size_t size;
+  };
+
+  mutable std::mutex m_mutex;
+  FreeBuffer *m_free[NUM_CLASSES];
+  // Free buffers of HUGE_PAGE bytes or more, any size
+  LargeBuffer *m_large;
+  size_t m_reserved, m_used;
+  int64_t m_systemAllocations;
+  bool m_hugePages;
+};
+
+template <typename T> class PoolAllocator {
+public:
+  typedef T value_type;
+
+  PoolAllocator() {}
+  template <typename U> PoolAllocator(PoolAllocator<U> const &) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(BufferPool::global().allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    BufferPool::global().release(p, n * sizeof(T));
+  }
+
+  template <typename U> struct rebind { typedef PoolAllocator<U> other; };
+};
+
+template <typename T, typename U>
+bool operator==(PoolAllocator<T> const &, PoolAllocator<U> const &) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(PoolAllocator<T> const &, PoolAllocator<U> const &) {
+  return false;
+}
+
+template <typename T> using PoolVector = std::vector<T, PoolAllocator<T>>;
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,64 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	ChebyshevAccelerator.h
+ *
+ * Chebyshev semi-iterative acceleration for a fixed-point iteration
+ * x_{k+1} = F(x_k) (Jacobi-style constraint projection, relaxation, ...).
+ * After each plain iterate the accelerator blends it with the previous
+ * two iterates:
+ *
+ *   x_{k+1} = omega_{k+1} (F(x_k) - x_{k-1}) + x_{k-1}
+ *   omega_1 = 2 / (2 - rho^2),  omega_{k+1} = 4 / (4 - rho^2 omega_k)
+ *
+ * rho, the spectral radius of the iteration, is estimated automatically
+ * from the ratio of successive update norms during the first few
+ * unaccelerated iterations of every solve and smoothed across solves.
+ *
+ * Reference: Wang, "A Chebyshev Semi-Iterative Approach for Accelerating
+ * Projective and Position-based Dynamics", 2015.
+ */
+
+#ifndef CHEBYSHEV_ACCELERATOR_H
+#define CHEBYSHEV_ACCELERATOR_H
+
+#include <vector>
+
+#include "BufferPool.h"
+#include "ThreadPool.h"
+
+class ChebyshevAccelerator {
+public:
+  // `delay` plain iterations run before acceleration starts
+  explicit ChebyshevAccelerator(int delay = 5);
+
+  // Forget the spectral radius estimate (new scene)
+  void reset();
+
+  // Start a solve from state x (n floats)
+  void begin(float const *x, int n);
+
+  // x holds F(x_k); overwrite it with the accelerated iterate.
+  // Returns the RMS of the plain update |F(x_k) - x_k|.
+  float update(float *x, int n, ThreadPool &pool);
+
+  float spectralRadius() const;
+
+  // rho < 0 re-enables automatic estimation
+  void setSpectralRadius(float rho);
+
+private:
+  int m_delay;
+  int m_k;
+  float m_omega;
+
+  float m_rho;
+  bool m_autoRho;
+  bool m_haveRho;
+  float m_lastNorm;
+
+  PoolVector<float> m_prev; // x_{k-1}
+  PoolVector<float> m_curr; // x_k
+};
+
+#endif // CHEBYSHEV_ACCELERATOR_H
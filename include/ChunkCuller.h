@@ -0,0 +1,84 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	ChunkCuller.h
+ *
+ * Frustum culling and distance LOD for the spring lines and mass quads.
+ * The elements (springs or masses) are split into chunks of CHUNK
+ * consecutive elements; with the scene sorted along a space-filling curve
+ * (SpatialReorder) each chunk is a compact cluster. Chunk bounds are
+ * refreshed every frame and tested against the planes of P * V.
+ *
+ * Every chunk draws from the same static index buffer, whose element
+ * order is the bit reversal of 0 .. CHUNK-1. The first CHUNK >> l
+ * elements of that order are every 2^l-th element of the chunk, so a
+ * chunk at LOD level l is a prefix of the buffer: one entry of
+ * glMultiDrawElementsBaseVertex with a shorter count.
+ */
+
+#ifndef CHUNK_CULLER_H
+#define CHUNK_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Mat4f.h"
+#include "MassSpringSystem.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+class ChunkCuller {
+public:
+  enum { CHUNK = 1024, MAX_LEVEL = 4 };
+
+  struct Box {
+    glm::vec3 lo, hi;
+  };
+
+  // Visible chunks as glMultiDrawElementsBaseVertex arguments, plus the
+  // partial last chunk (drawn unindexed at full detail) if it is visible
+  struct DrawList {
+    std::vector<int> counts;
+    std::vector<int> baseVertex;
+    std::vector<void const *> indices; // all 0, the buffer is shared
+    int tailFirst, tailCount;
+    int elements; // elements drawn
+  };
+
+  ChunkCuller();
+
+  // Bounds of every CHUNK elements of vertsPerElement vertices each
+  static void bounds(Vec3f const *v, int numElements, int vertsPerElement,
+                     std::vector<Box> &out, ThreadPool &pool);
+
+  // The same from the simulation state, for when the vertices are in
+  // write-only (mapped) memory. Quads extend `pad` around their mass.
+  static void massBounds(PoolVector<Mass> const &ms, float pad,
+                         std::vector<Box> &out, ThreadPool &pool);
+  static void springBounds(PoolVector<Spring> const &ss,
+                           std::vector<Box> &out, ThreadPool &pool);
+
+  // Index buffer contents for elements of vertsPerElement vertices
+  static void lodIndices(int vertsPerElement, std::vector<uint16_t> &out);
+
+  void setView(Mat4f const &viewProjection, glm::vec3 eye);
+
+  // Full detail up to this distance from the eye; every doubling of the
+  // distance halves the elements drawn, down to CHUNK >> MAX_LEVEL
+  void setLodDistance(float distance);
+
+  void select(std::vector<Box> const &chunks, int numElements,
+              int vertsPerElement, DrawList &out) const;
+
+private:
+  bool visible(Box const &box) const;
+  int level(Box const &box) const;
+
+  glm::vec4 m_planes[6]; // inside where dot(plane, (p, 1)) >= 0
+  glm::vec3 m_eye;
+  float m_lodDistance;
+};
+
+#endif // CHUNK_CULLER_H
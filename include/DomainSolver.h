@@ -0,0 +1,100 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	DomainSolver.h
+ *
+ * The force-based step (applyForces/resolveForces) split into one domain
+ * per thread. The domains come from GraphPartitioner and their masses are
+ * expected to be contiguous (SpatialReorder::group), so each thread keeps
+ * working on the same block of memory from frame to frame.
+ *
+ * A domain evaluates the springs whose first endpoint it owns. Forces on
+ * its own masses are added directly; a force on a mass of another domain
+ * goes to a halo slot (one per domain and foreign mass) instead of the
+ * shared mass. Each domain then adds the halo slots aimed at its masses
+ * and integrates them, so no two threads ever write the same mass.
+ *
+ * The phases run as a TaskGraph rather than with barriers in between.
+ * Per domain there is a force node, a contact node (the floor test, which
+ * only reads positions and so overlaps with the forces) and an integrate
+ * node. A domain integrates as soon as its own nodes and the force nodes
+ * of the domains that write its halo are done; those are also the only
+ * domains that read its positions. Force and integrate nodes are pinned
+ * to thread d % threads.
+ */
+
+#ifndef DOMAIN_SOLVER_H
+#define DOMAIN_SOLVER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "MassSpringSystem.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+
+class DomainSolver {
+public:
+  DomainSolver();
+
+  // part[i] = domain of mass i, in [0, numDomains)
+  void rebuild(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss,
+               std::vector<int> const &part, int numDomains);
+
+  // After a re-sort that kept every mass in its domain (SpatialReorder
+  // apply with massStart() as blocks): rewrites the indices, keeps the
+  // halo slots and the task graph. Does not allocate.
+  void remap(PoolVector<int> const &massIndex,
+             PoolVector<int> const &springIndex);
+
+  int numDomains() const;
+  int numHaloSlots() const;
+
+  // Masses of domain d are [massStart()[d], massStart()[d + 1]) once
+  // grouped
+  PoolVector<int> const &massStart() const;
+
+  // One force step with the global timestep, like the loops in main()
+  void step(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+            ThreadPool &pool);
+
+  // Move each domain's masses and springs to the NUMA node of the thread
+  // that steps it (NumaPlacement::firstTouch). Call from the thread that
+  // calls step, after rebuild; masses must be grouped by domain.
+  void place(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+             ThreadPool &pool);
+
+private:
+  void buildGraph();
+  void accumulate(int domain);
+  void findContacts(int domain);
+  void integrate(int domain);
+
+  int m_numDomains;
+
+  // Masses of domain d: m_masses[m_massStart[d] .. m_massStart[d+1])
+  PoolVector<int> m_massStart, m_masses;
+
+  // Springs evaluated by each domain, with the halo slot that receives
+  // the force on endpoint b (-1 when the domain owns b)
+  PoolVector<int> m_springStart, m_springs, m_springSlot;
+
+  // Halo slots written by the domains, and per owning domain the slots
+  // it has to collect
+  PoolVector<glm::vec3> m_halo;
+  PoolVector<int> m_haloTarget;
+  PoolVector<int> m_collectStart, m_collect;
+
+  // Floor contact of each mass, from the contact nodes; in stepArena,
+  // valid while the graph runs
+  unsigned char *m_contact;
+
+  TaskGraph m_graph;
+
+  // Scene being stepped, valid while the graph runs
+  PoolVector<Mass> *m_ms;
+  PoolVector<Spring> const *m_ss;
+};
+
+#endif // DOMAIN_SOLVER_H
@@ -0,0 +1,112 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	FrameRecorder.h
+ *
+ * Records rendered frames as PPM images without stalling the GL thread.
+ * Frames are drawn into an offscreen multisampled framebuffer, resolved,
+ * and read back into a ring of pixel buffer objects: glReadPixels only
+ * queues the copy, and a buffer is mapped a few frames later once its
+ * fence has signalled. Mapped pixels are copied into a slot of a fixed
+ * queue and written by a writer thread, either to one file per frame or as a
+ * PPM stream into a pipe (e.g. to ffmpeg -f image2pipe -c:v ppm -i -).
+ *
+ * If the writer falls more than MAX_QUEUED frames behind, endFrame()
+ * waits for it rather than dropping frames. A frame whose fence fails is
+ * dropped and a write that fails stops the writer; both make failed()
+ * true. Recording into a pipe ignores SIGPIPE, so an encoder that exits
+ * is a failed write instead of killing the process.
+ */
+
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glad/glad.h"
+
+class FrameRecorder {
+public:
+  enum { RING = 3, MAX_QUEUED = 8 };
+
+  FrameRecorder();
+  ~FrameRecorder();
+
+  FrameRecorder(FrameRecorder const &) = delete;
+  FrameRecorder &operator=(FrameRecorder const &) = delete;
+
+  // `target` is a printf pattern for the file names ("out/f%05d.ppm"),
+  // a directory (frames become frame_00000.ppm, ...), or "|command" to
+  // pipe a PPM stream into command
+  bool start(int width, int height, int samples, std::string const &target);
+
+  // True if `pattern` has exactly one integer conversion (%d, %05d, ...)
+  // and no other conversions than %%, so it can format the frame index
+  static bool validPattern(std::string const &pattern);
+
+  // Read back the frames still in flight and finish writing them
+  void stop();
+
+  bool recording() const;
+  int width() const;
+  int height() const;
+  int framesWritten() const;
+  // A frame was dropped or could not be written since start()
+  bool failed() const;
+
+  // Draw between these two; beginFrame() sets the viewport
+  void beginFrame();
+  void endFrame();
+
+  // Show the last recorded frame in the default framebuffer
+  void blitToScreen(int width, int height) const;
+
+private:
+  struct Image {
+    int index;
+    std::vector<uint8_t> rgba; // bottom-up rows, as read back
+  };
+
+  void collect(bool wait);
+  void enqueue(void const *pixels, int index);
+  void writerLoop();
+  bool writeImage(Image const &image);
+
+  int m_width, m_height;
+  bool m_recording;
+
+  GLuint m_fbo, m_colorRB, m_depthRB; // multisampled target
+  GLuint m_resolveFBO, m_resolveRB;   // single sample, read back
+
+  GLuint m_pbo[RING];
+  GLsync m_fence[RING];
+  int m_frameOf[RING];
+  int m_next;    // ring slot of the next readback
+  int m_pending; // slots with a readback in flight
+  int m_frame;   // frames read back so far
+
+  // Writer thread state
+  std::string m_pattern;
+  FILE *m_pipe;
+  std::thread m_writer;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;
+
+  // Frames waiting for the writer are m_queue[(m_head + i) % MAX_QUEUED]
+  // for i < m_queued. Slots keep their pixel storage, so recording does
+  // not allocate once every slot has been used.
+  Image m_queue[MAX_QUEUED];
+  int m_head, m_queued;
+  bool m_quit;
+  int m_written;
+  bool m_failed;
+  std::vector<uint8_t> m_row; // writer only
+};
+
+#endif // FRAME_RECORDER_H
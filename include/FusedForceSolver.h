@@ -0,0 +1,45 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	FusedForceSolver.h
+ *
+ * The force-based step with integration and vertex packing fused into
+ * one pass. After the spring forces are accumulated (in parallel, colour
+ * by colour of the given SpringColouring), each chunk of masses is
+ * integrated and its new positions are written straight away to every
+ * line vertex that uses them and to their quads, in the render format
+ * (3 floats per vertex). The positions are never read back in a separate
+ * packing pass, and the destination can be mapped GL buffer memory.
+ *
+ * rebuild() builds the mass -> line vertex incidence map: line vertex 2s
+ * is endpoint a of spring s and 2s+1 is endpoint b, as in packFrame.
+ * It is a linear pass, also used after a re-sort, and does not allocate
+ * when the scene keeps its size.
+ */
+
+#ifndef FUSED_FORCE_SOLVER_H
+#define FUSED_FORCE_SOLVER_H
+
+#include <vector>
+
+#include "MassSpringSystem.h"
+#include "SpringColouring.h"
+#include "ThreadPool.h"
+
+class FusedForceSolver {
+public:
+  void rebuild(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss);
+
+  // lines: 2 vertices per spring, quads: 6 vertices per mass
+  void step(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+            SpringColouring const &colouring, float *lines, float *quads,
+            ThreadPool &pool);
+
+private:
+  // Line vertices of mass i: m_slots[m_slotStart[i] .. m_slotStart[i+1])
+  PoolVector<int> m_slotStart;
+  PoolVector<int> m_slots;
+  PoolVector<int> m_fill;
+};
+
+#endif // FUSED_FORCE_SOLVER_H
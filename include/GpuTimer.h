@@ -0,0 +1,50 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	GpuTimer.h
+ *
+ * GPU time of render passes from GL_TIME_ELAPSED queries (GL 3.3). Each
+ * pass has one query per frame in a ring of RING frames. beginFrame()
+ * collects the results of older frames that are already available and
+ * never waits for one, so the times shown are a frame or two behind.
+ * A query that is still pending when its slot comes round again is
+ * dropped.
+ */
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <vector>
+
+#include "glad/glad.h"
+
+class GpuTimer {
+public:
+  enum { RING = 3 };
+
+  GpuTimer();
+
+  void create(int numPasses);
+  void destroy();
+
+  void beginFrame();
+
+  // Only one pass can be timed at a time (queries of one target do not
+  // nest)
+  void begin(int pass);
+  void end();
+
+  // Latest finished time of the pass, -1 before the first result
+  float milliseconds(int pass) const;
+
+private:
+  GLuint &query(int slot, int pass);
+
+  int m_numPasses;
+  int m_frame;
+  std::vector<GLuint> m_queries; // [slot * m_numPasses + pass]
+  std::vector<char> m_issued;
+  std::vector<float> m_ms;
+};
+
+#endif // GPU_TIMER_H
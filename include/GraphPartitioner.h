@@ -0,0 +1,62 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	GraphPartitioner.h
+ *
+ * Multilevel k-way partitioning of the mass-spring graph, after the
+ * scheme used by METIS:
+ *
+ *  1. Coarsen: repeatedly contract a heavy-edge matching, so strongly
+ *     connected masses end up in the same coarse vertex.
+ *  2. Partition the small coarsest graph by greedy region growing.
+ *  3. Uncoarsen: project the parts back level by level and at each level
+ *     move boundary vertices to the neighbouring part they share the
+ *     most edge weight with, as long as the parts stay balanced.
+ *
+ * The result keeps the number of springs crossing between parts small
+ * while every part holds about the same number of masses.
+ */
+
+#ifndef GRAPH_PARTITIONER_H
+#define GRAPH_PARTITIONER_H
+
+#include <vector>
+
+#include "MassSpringSystem.h"
+
+class GraphPartitioner {
+public:
+  // Compressed adjacency with edge and vertex weights
+  struct Graph {
+    std::vector<int> start; // size() + 1 entries
+    std::vector<int> adj;
+    std::vector<int> edgeWeight;
+    std::vector<int> vertexWeight;
+
+    int size() const { return int(start.size()) - 1; }
+  };
+
+  GraphPartitioner();
+
+  // part[i] in [0, numParts) for every mass
+  std::vector<int> partition(PoolVector<Mass> const &ms,
+                             PoolVector<Spring> const &ss, int numParts);
+
+  // Allowed imbalance of the heaviest part over the average (0.03 = 3%)
+  void setImbalance(float tolerance);
+
+  // Springs whose endpoints ended up in different parts
+  static int edgeCut(PoolVector<Mass> const &ms,
+                     PoolVector<Spring> const &ss,
+                     std::vector<int> const &part);
+
+private:
+  Graph coarsen(Graph const &g, int maxWeight, std::vector<int> &toCoarse);
+  void growRegions(Graph const &g, int numParts, std::vector<int> &part);
+  void refine(Graph const &g, int numParts, std::vector<int> &part);
+
+  float m_imbalance;
+  unsigned m_seed;
+};
+
+#endif // GRAPH_PARTITIONER_H
@@ -0,0 +1,23 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	HeadlessContext.h
+ *
+ * A GL 3.3 core context without a window or display server, through EGL
+ * (Mesa's surfaceless platform when available, so llvmpipe works on
+ * machines with no GPU and no X). Everything is drawn into an offscreen
+ * framebuffer (FrameRecorder). Only built with -DA3_HEADLESS
+ * (make HEADLESS=1); otherwise createHeadlessContext() reports that it is
+ * unavailable.
+ */
+
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+bool createHeadlessContext();
+void destroyHeadlessContext();
+
+// For gladLoadGLLoader
+void *headlessProcAddress(char const *name);
+
+#endif // HEADLESS_CONTEXT_H
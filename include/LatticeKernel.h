@@ -0,0 +1,86 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	LatticeKernel.h
+ *
+ * Mass-spring lattice with implicit topology. Particles sit on an
+ * nx * ny * nz grid (index x + nx*(y + ny*z)) and every particle is
+ * connected to the neighbours given by a fixed stencil of grid offsets,
+ * so no Spring array is stored at all. Each stencil entry keeps its own
+ * rest length; the stiffness is shared by the lattice.
+ *
+ * Forces are gathered: each particle sums the pull of all its stencil
+ * neighbours (+offset and -offset) and only writes to itself. A stencil
+ * entry is a constant index offset, so a grid row is a contiguous loop
+ * over structure-of-arrays positions that vectorises, and rows are
+ * independent and run in parallel.
+ */
+
+#ifndef LATTICE_KERNEL_H
+#define LATTICE_KERNEL_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "BufferPool.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+class LatticeKernel {
+public:
+  struct Offset {
+    int dx, dy, dz;
+  };
+
+  LatticeKernel();
+
+  // Particle (x,y,z) starts at origin + x*ex + y*ey + z*ez. `stencil`
+  // lists one of each +/- pair; rest lengths come from the start pose.
+  void init(int nx, int ny, int nz, glm::vec3 origin, glm::vec3 ex,
+            glm::vec3 ey, glm::vec3 ez, std::vector<Offset> const &stencil,
+            float mass, float stiffness);
+  void clear();
+
+  void setFixed(int x, int y, int z, bool fixed);
+
+  // Floor plane at y = floorY (off by default)
+  void setFloor(bool on, float floorY);
+
+  int size() const;
+  int index(int x, int y, int z) const;
+  glm::vec3 position(int i) const;
+
+  // Number of distinct springs the stencil implies (for drawing)
+  int numSprings() const;
+
+  void step(float dt, ThreadPool &pool);
+
+  // Two line vertices per implied spring
+  void packLines(std::vector<Vec3f> &out) const;
+
+  // Rest length at each of those line vertices
+  void packRestLengths(std::vector<float> &out) const;
+
+private:
+  void accumulateRow(int y, int z);
+
+  int m_nx, m_ny, m_nz;
+  float m_stiffness;
+  bool m_floor;
+  float m_floorY;
+
+  // Half stencil (as given) and its rest lengths; the kernel also
+  // visits the negated offsets
+  std::vector<Offset> m_stencil;
+  PoolVector<float> m_restLength;
+
+  // Structure of arrays particle state
+  PoolVector<float> m_px, m_py, m_pz;
+  PoolVector<float> m_vx, m_vy, m_vz;
+  PoolVector<float> m_fx, m_fy, m_fz;
+  PoolVector<float> m_invMass;
+  float m_mass;
+};
+
+#endif // LATTICE_KERNEL_H
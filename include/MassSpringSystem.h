@@ -0,0 +1,105 @@
+/**
+ * Author: 	Shannon TJ
+ * Date:		March 23, 2017
+ * Course:		CPSC 587 Computer Animation
+ *
+ * File:		MassSpringSystem.h
+ *
+ * Masses, springs and the scenes built from them. The simulation state is
+ * kept in globals (like the rest of the program) so the solvers and the
+ * renderer can share it.
+ */
+
+#ifndef MASS_SPRING_SYSTEM_H
+#define MASS_SPRING_SYSTEM_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Arena.h"
+#include "BufferPool.h"
+#include "LatticeKernel.h"
+#include "StrandBatch.h"
+
+struct Mass
+{
+	float mass;
+	bool fixedPoint;
+
+	glm::vec3 position;
+	glm::vec3 velocity;
+	glm::vec3 acc;
+};
+
+struct Spring
+{
+	Mass *a, *b;
+	float stiffness;
+	float restLength;
+};
+
+//Pooled, so rebuilding a scene reuses the memory of the last one
+extern PoolVector<Mass> masses;
+extern PoolVector<Spring> springs;
+
+extern int numMass;
+extern int numSpring;
+
+extern float damping;
+extern float timestep;
+
+//True when the floor at y = -2 is active (jello cube)
+extern bool sim3;
+
+//Grid size of sims 3 and 4: mass (or lattice particle) x + gx*(y + gy*z)
+//is grid point (x, y, z). Zero for the other scenes.
+extern glm::ivec3 massGrid;
+
+//Temporaries of the current step; whoever steps the simulation resets
+//it before each step
+extern Arena stepArena;
+
+//Independent strands for sim6, stepped on their own (empty otherwise)
+extern StrandBatch strands;
+
+//Stencil lattice for the implicit-topology versions of sim3 and sim4
+extern LatticeKernel lattice;
+
+float getLength(Mass *a, Mass *b);
+Mass initMass(Mass ms, float weight, bool fix, glm::vec3 pos);
+Spring initSpring(Spring ss, Mass *a, Mass *b, float k, float rLen);
+void clearScene();
+
+void initSim1();
+void initSim2();
+void initSim3();
+void initSim4();
+void initSim5();
+void initSim6();
+void initLatticeSim3();
+void initLatticeSim4();
+
+//The rope, jello cube and cloth at any size (sims 5, 3 and 4 use 40, 5
+//and 11 x 7), with the same spacing, stiffness and springs but built in
+//O(n) from the grid stencil, for benchmarks
+void initChain(int n);
+void initCube(int side);
+void initCloth(int width, int rows);
+void initLatticeCube(int side);
+void initLatticeCloth(int width, int rows);
+
+//Force-based path: accumulate spring forces, then integrate each mass
+void applyForces(Spring s, Mass *a, Mass *b);
+void resolveForces(Mass *m);
+
+//Collision test used by resolveForces (the sim3 floor), and the
+//integration step given its result
+bool onFloor(Mass const *m);
+void resolveForces(Mass *m, bool contact);
+//onFloor of masses[0..count) into contact, vectorised
+void floorContacts(Mass const *masses, int count, char *contact);
+//resolveForces(&masses[i], contact[i]) for i in [0, count), vectorised
+void integrateMasses(Mass *masses, char const *contact, int count);
+
+#endif // MASS_SPRING_SYSTEM_H
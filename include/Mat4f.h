@@ -55,6 +55,10 @@ public:
   Mat4f operator*(const Mat4f &other) const;
   Mat4f operator*(float scalar) const;
 
+  // out = a * b into existing storage, so it does not allocate like
+  // operator* does. out must not be a or b.
+  static void multiply(const Mat4f &a, const Mat4f &b, Mat4f &out);
+
   Mat4f &operator=(const Mat4f &copied);
   Mat4f &operator=(Mat4f &&moved);
 
@@ -0,0 +1,45 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	NumaPlacement.h
+ *
+ * Memory placement for machines with several NUMA nodes (sockets). Linux
+ * puts a page on the node of the thread that first writes it, so arrays
+ * filled by one thread end up on one socket and every other socket reads
+ * them remotely. pinThreads fixes each pool thread to one core, with
+ * consecutive threads on the same node, and firstTouch moves blocks of an
+ * array to the node of the thread that works on them: the pages are
+ * dropped and each thread writes its blocks back, so the kernel allocates
+ * them again on that thread's node. Block b goes to thread
+ * b % pool.size(), the thread DomainSolver runs domain b on.
+ *
+ * Only pages entirely inside one block move; a page shared by two blocks
+ * stays where it was. The pages go through a small buffer per thread, so
+ * placing an array does not need a copy of it. Both functions must be
+ * called from the thread that later drives the pool (thread 0 of
+ * forEachThread), and nothing may use the array while firstTouch runs.
+ * Without Linux they do nothing.
+ */
+
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <cstddef>
+
+#include "ThreadPool.h"
+
+class NumaPlacement {
+public:
+  // Nodes with CPUs, 1 if unknown
+  static int numNodes();
+
+  // False if the threads could not be pinned
+  static bool pinThreads(ThreadPool &pool);
+
+  // Elements [start[b], start[b + 1]) of data, for b < numBlocks, are
+  // moved to the node of thread b % pool.size()
+  static void firstTouch(void *data, size_t elemSize, int const *start,
+                         int numBlocks, ThreadPool &pool);
+};
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,79 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	PerfCounters.h
+ *
+ * Hardware counters per simulation phase (Linux perf_event_open; other
+ * systems report that they are unavailable). enable() opens a counting
+ * group on every thread the process has at that moment (main, physics,
+ * pool workers), so the work a phase hands to the pool is included.
+ * PERF_PHASE("name") reads all groups when the enclosing block starts
+ * and ends and adds the difference, with the wall time, to that phase.
+ *
+ * Counts are summed over all threads for the phase's interval, so other
+ * threads' work during it is included too; run with --serial for clean
+ * per-phase numbers. Counters the CPU or kernel does not offer (VMs
+ * often have no hardware events) are shown as "-". Counts are scaled by
+ * time enabled / time running when the kernel multiplexes them.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+class PerfCounters {
+public:
+  enum Counter {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    TASK_CLOCK, // CPU time in ns, summed over threads
+    PAGE_FAULTS,
+    NUM_COUNTERS
+  };
+
+  struct Snapshot {
+    double value[NUM_COUNTERS];
+  };
+
+  // False (with the reason on stderr) if no counter could be opened
+  static bool enable();
+  static void disable();
+  static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  // Per phase: calls, wall time and counts, totals and per call
+  static void report(std::ostream &out);
+
+  class Phase {
+  public:
+    explicit Phase(char const *name);
+    ~Phase();
+
+    Phase(Phase const &) = delete;
+    Phase &operator=(Phase const &) = delete;
+
+  private:
+    char const *m_name;
+    int64_t m_start;
+    Snapshot m_begin;
+  };
+
+private:
+  static void read(Snapshot &s);
+  static void add(char const *name, int64_t ns, Snapshot const &begin,
+                  Snapshot const &end);
+
+  static std::atomic<bool> s_enabled;
+};
+
+#define PERF_CONCAT2(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT2(a, b)
+#define PERF_PHASE(name)                                                     \
+  PerfCounters::Phase PERF_CONCAT(perfPhase_, __LINE__)(name)
+
+#endif // PERF_COUNTERS_H
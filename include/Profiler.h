@@ -0,0 +1,94 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	Profiler.h
+ *
+ * Scoped timers for the hot paths. PROFILE_SCOPE("name") records how long
+ * the enclosing block took, on the calling thread, while profiling is
+ * enabled (--profile). A disabled scope costs one relaxed load; building
+ * with -DA3_NO_PROFILE (make NOPROFILE=1) removes the scopes completely.
+ * Scopes also name the allocation phases of AllocCounter.
+ *
+ * Every thread appends to its own buffer, a list of fixed size blocks
+ * that only the owner writes, so recording takes no lock. Each block
+ * publishes its event count with a release store, so the buffers can be
+ * read from another thread at any time. Names must be string literals
+ * (only the pointer is stored).
+ *
+ * writeReport prints count, total, percentiles and a log2 histogram of
+ * the durations per name. writeChromeTrace writes trace-event JSON for
+ * chrome://tracing or Perfetto, with one track per thread and the frame
+ * number of every event.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#include "AllocCounter.h"
+
+class Profiler {
+public:
+  static void enable(bool on);
+  static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  // Nanoseconds on the steady clock
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static void record(char const *name, int64_t start, int64_t end);
+
+  // Frame number stamped on the following events (all threads)
+  static void nextFrame();
+
+  // Track name in the trace; index >= 0 is appended ("worker 3"). The
+  // name must stay valid.
+  static void setThreadName(char const *name, int index = -1);
+
+  static void writeReport(std::ostream &out);
+  static bool writeChromeTrace(char const *path);
+
+  class Scope {
+  public:
+    explicit Scope(char const *name)
+        : m_name(enabled() ? name : nullptr), m_start(m_name ? now() : 0) {}
+    ~Scope() {
+      if (m_name)
+        record(m_name, m_start, now());
+    }
+
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+
+  private:
+    char const *m_name;
+    int64_t m_start;
+  };
+
+private:
+  static std::atomic<bool> s_enabled;
+};
+
+// With A3_COUNT_ALLOCS every scope is also an allocation phase
+// (AllocCounter.h)
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#if defined(A3_NO_PROFILE)
+#define PROFILE_SCOPE(name) ALLOC_PHASE(name)
+#elif defined(A3_COUNT_ALLOCS)
+#define PROFILE_SCOPE(name)                                                  \
+  Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(name);             \
+  ALLOC_PHASE(name)
+#else
+#define PROFILE_SCOPE(name)                                                  \
+  Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,102 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SimdKernels.h
+ *
+ * The hot inner loops (spring forces, integration, floor collision and
+ * line packing), compiled once per instruction set and picked at startup.
+ * The Makefile builds for plain x86-64, which only guarantees SSE2, so
+ * SimdKernels.cpp compiles the same loop bodies again for SSE4.2, AVX2
+ * and AVX-512 (GCC target pragmas) and best() asks CPUID which of them
+ * the machine and OS support. One binary then uses the widest vectors
+ * available wherever it runs.
+ *
+ * The callers fetch the table with get() and call through it. select()
+ * switches to another variant (A3 and A3bench take --isa), e.g. to
+ * compare them; it must happen before any thread uses the kernels. The
+ * AVX-512 variant may fuse multiplies and adds, so its results can
+ * differ from the others in the last bits.
+ *
+ * Without GCC on x86 only the baseline variant exists.
+ */
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "MassSpringSystem.h"
+
+class SimdKernels {
+public:
+  enum Isa { SSE2, SSE4_2, AVX2, AVX512, NUM_ISAS };
+
+  struct Table {
+    // LatticeKernel: hooke = -k(x-x0)AB on each particle in [x0, x1) of
+    // a row from the particle `off` entries further on
+    void (*gatherRow)(float const *ax, float const *ay, float const *az,
+                      int off, float *fx, float *fy, float *fz, int x0,
+                      int x1, float k, float rest);
+
+    // LatticeKernel: symplectic Euler of [begin, end), clamped to the
+    // floor at floorY
+    void (*integrateRange)(float *px, float *py, float *pz, float *vx,
+                           float *vy, float *vz, float const *fx,
+                           float const *fy, float const *fz,
+                           float const *invMass, int begin, int end,
+                           float mass, float g, float d, float floorY,
+                           float dt);
+
+    // StrandBatch: spring forces, then integration, of one block
+    void (*strandForces)(float const *pos, float *acc, float const *rest,
+                         int particles, float k);
+    void (*strandIntegrate)(float *pos, float *vel, float const *acc,
+                            float const *mass, float const *invMass,
+                            int particles, float g, float d, float dt);
+
+    // contact[i] = masses[i] is below floorY (onFloor for every mass)
+    void (*floorContacts)(Mass const *masses, int count, float floorY,
+                          char *contact);
+
+    // applyForces for springs[order[k]], k in [begin, end): one colour of
+    // a SpringColouring, so no two of them share a mass
+    void (*springForceRange)(Spring const *springs, int const *order,
+                             int begin, int end);
+
+    // resolveForces for masses [0, count) with gravity g and the floor
+    // clamp at floorY where contact[i] is set
+    void (*integrateMasses)(Mass *masses, char const *contact, int count,
+                            float damping, float g, float floorY,
+                            float dt);
+
+    // packFrame: 6 quad vertices (18 floats) per mass, corners +-half
+    // around the position, and both endpoints (6 floats) per spring
+    void (*packQuads)(Mass const *masses, int count, float half,
+                      float *out);
+    void (*packSpringLines)(Spring const *springs, int count, float *out);
+
+    // LatticeKernel::packLines: both line vertices (6 floats) of the
+    // springs from x to x + off, for x in [x0, x1)
+    void (*packLatticeRow)(float const *px, float const *py,
+                           float const *pz, int off, int x0, int x1,
+                           float *out);
+  };
+
+  // Widest variant the CPU and OS support
+  static Isa best();
+  static bool supported(Isa isa);
+
+  // False (and no change) if the variant is not supported
+  static bool select(Isa isa);
+  static Isa selected();
+
+  static char const *name(Isa isa);
+  // "sse2", "sse4.2", "avx2", "avx512"; false if unknown
+  static bool parse(char const *name, Isa &isa);
+
+  static Table const &get() { return *s_table; }
+
+private:
+  static Table const *s_table;
+  static Isa s_selected;
+};
+
+#endif // SIMD_KERNELS_H
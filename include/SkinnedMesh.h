@@ -0,0 +1,53 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SkinnedMesh.h
+ *
+ * A fine render surface embedded in a coarse simulated grid of masses
+ * (massGrid). Each fine vertex stores only its continuous grid coordinate
+ * (e.g. (3.25, 0, 1.5) lies in the cell between grid points 3..4 and
+ * 1..2) and the two grid axes its face spans. skin_vs.glsl deforms it
+ * every frame by trilinear interpolation of the eight surrounding
+ * particles, read from a texture buffer of the coarse positions, and
+ * takes the normal from the derivatives along the two face axes.
+ *
+ * The vertex data is static, so per frame only the coarse positions are
+ * uploaded and the cost of the simulation stays at the coarse size.
+ */
+
+#ifndef SKINNED_MESH_H
+#define SKINNED_MESH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class SkinnedMesh {
+public:
+  // Floats per vertex: grid coordinate (3), face axes (2)
+  enum { VERTEX_FLOATS = 5 };
+
+  SkinnedMesh();
+
+  // Surface of the grid box with `subdivisions` fine quads along every
+  // cell edge: the six faces of a solid grid, or one sheet if the grid is
+  // flat along an axis
+  void build(glm::ivec3 grid, int subdivisions);
+  void clear();
+
+  glm::ivec3 grid() const;
+  int numVertices() const;
+
+  std::vector<float> const &vertices() const;
+  std::vector<uint32_t> const &indices() const;
+
+private:
+  void addFace(int normalAxis, int layer, int subdivisions);
+
+  glm::ivec3 m_grid;
+  std::vector<float> m_vertices;
+  std::vector<uint32_t> m_indices;
+};
+
+#endif // SKINNED_MESH_H
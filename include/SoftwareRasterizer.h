@@ -0,0 +1,117 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SoftwareRasterizer.h
+ *
+ * CPU renderer for previews on machines without any GL. It draws the
+ * same mass quads and spring lines as displayFunc (same matrices, colours
+ * and depth test) into an RGB image that can be written as PPM or PNG.
+ *
+ * Drawing is deferred and tiled: drawTriangles/drawLines only record the
+ * primitives, and finish() transforms the vertices, bins every primitive
+ * into the TILE x TILE screen tiles its bounds touch, then rasterises
+ * the tiles in parallel. Each tile's pixels belong to exactly one task,
+ * so there is no locking, and primitives are binned in chunks that are
+ * replayed in order, so the image is the same for any thread count.
+ *
+ * A primitive whose bounds touch more than MAX_PRIM_TILES tiles goes to
+ * a list of its chunk that every tile checks instead. The bins then hold
+ * at most MAX_PRIM_TILES entries per primitive whatever the view, so
+ * their storage is sized by the primitive count and a frame of the same
+ * scene does not allocate.
+ */
+
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Mat4f.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+class SoftwareRasterizer {
+public:
+  enum { TILE = 64, MAX_PRIM_TILES = 4 };
+
+  SoftwareRasterizer();
+
+  void resize(int width, int height);
+  int width() const;
+  int height() const;
+
+  // Start a frame; colour and depth are cleared by finish()
+  void begin(glm::vec3 clearColor);
+
+  // Clip transform for the following draws
+  void setTransform(Mat4f const &mvp);
+
+  // n vertices: 3 per triangle, 2 per line. The vertices are not copied
+  // and must stay valid until finish().
+  void drawTriangles(Vec3f const *v, int n, glm::vec3 color);
+  void drawLines(Vec3f const *v, int n, glm::vec3 color);
+
+  void finish(ThreadPool &pool);
+
+  // Top row first, 3 bytes per pixel
+  uint8_t const *pixels() const;
+
+  bool writePPM(FILE *out) const;
+  // Uncompressed (stored) deflate, so no zlib is needed
+  bool writePNG(FILE *out) const;
+
+private:
+  struct Batch {
+    Vec3f const *v;
+    int first, count; // vertices, in m_screen from `first`
+    int vertsPerPrim;
+    uint8_t color[3];
+    float clip[16]; // row-major
+  };
+
+  struct Prim {
+    int batch;
+    int vertex; // first vertex in m_screen
+  };
+
+  void add(Vec3f const *v, int n, int vertsPerPrim, glm::vec3 color);
+  bool tileBounds(int prim, int *bounds) const;
+  void binChunk(int chunk, int first, int last);
+  void rasterTile(int tile);
+  void drawPrim(int prim, int x0, int y0, int x1, int y1);
+  void triangle(glm::vec3 const *p, uint8_t const *color, int x0, int y0,
+                int x1, int y1);
+  void line(glm::vec3 a, glm::vec3 b, uint8_t const *color, int x0, int y0,
+            int x1, int y1);
+  void plot(int x, int y, float z, uint8_t const *color);
+
+  int m_width, m_height;
+  int m_tilesX, m_tilesY;
+  float m_clip[16];
+  uint8_t m_clear[3];
+
+  std::vector<uint8_t> m_rgb;
+  std::vector<float> m_depth;
+
+  std::vector<Batch> m_batches;
+  std::vector<Prim> m_prims;
+  std::vector<glm::vec4> m_screen; // x, y in pixels, depth, clip w
+  int m_numVerts;
+
+  // Bins of chunk c: the primitives of tile t are m_binPrims[c *
+  // CHUNK_PRIMS * MAX_PRIM_TILES + i] for i in [m_binStart[c * (tiles + 1)
+  // + t], m_binStart[c * (tiles + 1) + t + 1]), in primitive order. The
+  // wide ones are m_widePrims[c * CHUNK_PRIMS + i], i < m_numWide[c].
+  std::vector<int> m_binStart, m_binPrims, m_widePrims, m_numWide;
+  int m_numChunks;
+
+  // Scratch of writePNG (filtered rows, zlib stream, one chunk), kept so
+  // writing a frame of the same size does not allocate
+  mutable std::vector<uint8_t> m_pngRaw, m_pngData, m_pngChunk;
+};
+
+#endif // SOFTWARE_RASTERIZER_H
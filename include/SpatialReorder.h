@@ -0,0 +1,87 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SpatialReorder.h
+ *
+ * Reorders the masses of a scene along a Morton (Z-order) or Hilbert
+ * curve so masses that are close in space are close in memory, then
+ * rewrites the spring pointers and sorts the springs by their first
+ * endpoint. The spring pass then walks memory almost sequentially
+ * instead of gathering endpoints from all over the mass array.
+ *
+ * Scenes that deform a lot drift away from the curve order; setInterval
+ * re-sorts every n frames. The original mass index (its position in the
+ * initSim loops) is tracked through every re-sort.
+ *
+ * group() instead makes masses with the same group id (a graph
+ * partition) contiguous, keeping their relative order. apply() with
+ * blocks sorts inside each block only, so such a grouping survives.
+ *
+ * The arrays are permuted in place: they keep their buffers (and the
+ * pages NumaPlacement put on each node), and the scratch space is kept
+ * between calls, so re-sorting a scene of the same size never allocates.
+ * Anything that caches mass or spring indices (the solvers) has to be
+ * rebuilt, or remapped with massIndex() and springIndex(), afterwards.
+ */
+
+#ifndef SPATIAL_REORDER_H
+#define SPATIAL_REORDER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "MassSpringSystem.h"
+
+class SpatialReorder {
+public:
+  enum Curve { MORTON, HILBERT };
+
+  SpatialReorder();
+
+  // Identity mapping for a freshly built scene
+  void reset(int numMasses);
+
+  // blocks: sort only inside [blocks[k], blocks[k + 1]) for each k
+  void apply(PoolVector<Mass> &ms, PoolVector<Spring> &ss, Curve curve,
+             PoolVector<int> const *blocks = nullptr);
+
+  // ids[i] (the group of mass i) is permuted along with the masses
+  void group(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+             std::vector<int> &ids);
+
+  // Call once per frame; true when a periodic re-sort is due
+  bool tick();
+  void setInterval(int frames); // 0 = never re-sort
+
+  // Map between initSim order and the current order
+  int currentIndex(int originalId) const;
+  int originalId(int currentIndex) const;
+
+  // New index of each mass and spring by its index before the last
+  // apply() or group()
+  PoolVector<int> const &massIndex() const;
+  PoolVector<int> const &springIndex() const;
+
+  static uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z);
+  static uint32_t hilbertCode(uint32_t x, uint32_t y, uint32_t z);
+
+private:
+  // Moves mass i to m_massIndex[i]
+  void permute(PoolVector<Mass> &ms, PoolVector<Spring> &ss);
+
+  PoolVector<int> m_toCurrent;
+  PoolVector<int> m_toOriginal;
+  int m_interval;
+  int m_frame;
+
+  PoolVector<int> m_massIndex, m_springIndex;
+
+  // Scratch of apply() and permute()
+  PoolVector<std::pair<uint32_t, int>> m_keys;
+  PoolVector<std::pair<std::pair<int, int>, int>> m_springOrder;
+  PoolVector<int> m_indexA, m_indexB;
+  PoolVector<Mass> m_massScratch;
+  PoolVector<Spring> m_springScratch;
+};
+
+#endif // SPATIAL_REORDER_H
@@ -0,0 +1,50 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SpringColouring.h
+ *
+ * Greedy colouring of the spring graph: no two springs of one colour
+ * share a mass. The springs of a colour can then be processed in
+ * parallel without locks, and colours one after another. The XPBD
+ * solver projects its constraints this way, and the force-based paths
+ * (main's force step, FusedForceSolver) accumulate the spring forces
+ * this way with applyForces.
+ *
+ * Within a colour every mass receives at most one force, so the order in
+ * which forces are added to a mass depends only on the colouring, not
+ * on the number of threads.
+ */
+
+#ifndef SPRING_COLOURING_H
+#define SPRING_COLOURING_H
+
+#include "MassSpringSystem.h"
+#include "ThreadPool.h"
+
+class SpringColouring {
+public:
+  // Call whenever masses/springs change
+  void rebuild(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss);
+
+  // After a re-sort of the same scene (springIndex[old] = new index of a
+  // spring). The colours stay valid. Does not allocate.
+  void remap(PoolVector<int> const &springIndex);
+
+  int numColours() const;
+  int numSprings() const;
+
+  // Springs of colour c are spring(k) for k in [colourStart(c),
+  // colourStart(c + 1))
+  int colourStart(int colour) const { return m_colourStart[colour]; }
+  int spring(int k) const { return m_order[k]; }
+
+  // applyForces for every spring, colour by colour
+  void applyForces(PoolVector<Spring> &ss, ThreadPool &pool) const;
+
+private:
+  // Spring indices sorted by colour
+  PoolVector<int> m_order;
+  PoolVector<int> m_colourStart;
+};
+
+#endif // SPRING_COLOURING_H
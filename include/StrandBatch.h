@@ -0,0 +1,76 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	StrandBatch.h
+ *
+ * Many short, independent chains (hair, grass) stepped in lockstep.
+ * Every strand has the same number of particles and is anchored at its
+ * first particle. Strands are grouped LANES at a time and stored
+ * array-of-structures-of-arrays:
+ *
+ *   [block][particle][x|y|z][lane]
+ *
+ * so one SIMD register holds the same coordinate of the same particle
+ * for LANES different strands. The spring update is a fixed stride walk
+ * down each block with no indices or pointers, and the lane loops
+ * vectorise. Physics match applyForces/resolveForces (Hooke springs,
+ * gravity, linear damping, symplectic Euler).
+ */
+
+#ifndef STRAND_BATCH_H
+#define STRAND_BATCH_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "BufferPool.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+class StrandBatch {
+public:
+  enum { LANES = 8 };
+
+  StrandBatch();
+
+  // One strand per root, laid out from the root along `direction`
+  void init(std::vector<glm::vec3> const &roots, glm::vec3 direction,
+            int particles, float segmentLength, float mass, float stiffness);
+  void clear();
+
+  int numStrands() const;
+  int particlesPerStrand() const;
+  int numSegments() const;
+
+  glm::vec3 position(int strand, int particle) const;
+
+  void step(float dt, ThreadPool &pool);
+
+  // Two line vertices per segment, strand after strand
+  void packLines(std::vector<Vec3f> &out, ThreadPool &pool) const;
+
+  // Rest length at each of those line vertices
+  void packRestLengths(std::vector<float> &out) const;
+
+private:
+  int offset(int block, int particle) const;
+  void stepBlock(int block, float dt);
+
+  int m_numStrands;
+  int m_numBlocks;
+  int m_particles;
+  float m_stiffness;
+
+  // AoSoA particle state
+  PoolVector<float> m_pos;
+  PoolVector<float> m_vel;
+  PoolVector<float> m_acc;
+
+  // Per lane (block * LANES + lane); padding lanes have zero mass
+  PoolVector<float> m_mass;
+  PoolVector<float> m_invMass;
+  PoolVector<float> m_restLength;
+};
+
+#endif // STRAND_BATCH_H
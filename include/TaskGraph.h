@@ -0,0 +1,65 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TaskGraph.h
+ *
+ * A dependency graph of tasks run on a ThreadPool. A node starts as soon
+ * as every node it depends on has finished, so independent phases (e.g.
+ * contact detection and spring forces) overlap instead of waiting at a
+ * barrier between them.
+ *
+ * The graph is built once and can be run any number of times; running it
+ * does not allocate. It must be acyclic. A node can be pinned to a thread
+ * (as in ThreadPool::spawnOn) to keep its data in that core's cache
+ * between runs.
+ */
+
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.h"
+
+class TaskGraph {
+public:
+  typedef std::function<void()> Work;
+
+  TaskGraph();
+
+  // Returns the node id. thread < 0 lets any thread run the node.
+  int add(Work const &work, int thread = -1);
+
+  // `after` waits for `before`
+  void precede(int before, int after);
+
+  void clear();
+  int size() const;
+
+  // Run every node once and return when all of them have finished
+  void run(ThreadPool &pool);
+
+private:
+  struct Node {
+    Work work;
+    int thread;
+    std::vector<int> successors;
+    int numPredecessors;
+  };
+
+  static void runNode(void *graph, int node, int);
+  void launch(int node);
+
+  std::vector<Node> m_nodes;
+  std::unique_ptr<std::atomic<int>[]> m_remaining;
+  int m_remainingSize;
+
+  // Valid while run() is executing
+  ThreadPool *m_pool;
+  ThreadPool::TaskGroup *m_group;
+};
+
+#endif // TASK_GRAPH_H
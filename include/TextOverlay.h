@@ -0,0 +1,48 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TextOverlay.h
+ *
+ * Text drawn over the scene with a built-in 5x7 bitmap font (ASCII 32 to
+ * 95; lower case is shown as upper case). print() queues text at pixel
+ * positions (top left origin) and draw() uploads all queued characters as
+ * one vertex buffer and draws them twice: a dark shadow, then the text.
+ */
+
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+#include <string>
+#include <vector>
+
+#include "glad/glad.h"
+
+class TextOverlay {
+public:
+  enum { GLYPH_W = 5, GLYPH_H = 7, CELL_W = 6, CELL_H = 9 };
+
+  TextOverlay();
+
+  void create(std::string const &vsSource, std::string const &fsSource);
+  void destroy();
+
+  // Font texels per screen pixel
+  void setScale(int scale);
+
+  // Height of one line of text in pixels
+  int lineHeight() const;
+
+  void clear();
+  void print(int x, int y, char const *text);
+
+  // Draw the queued text over the viewport of the given size; depth
+  // test is off while drawing and restored afterwards
+  void draw(int width, int height);
+
+private:
+  GLuint m_program, m_vao, m_buffer, m_font;
+  int m_scale;
+  std::vector<float> m_vertices; // x, y, u, v
+};
+
+#endif // TEXT_OVERLAY_H
@@ -0,0 +1,190 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	ThreadPool.h
+ *
+ * Work-stealing pool of persistent worker threads.
+ *
+ * Every worker owns a deque of tasks: it pushes and pops at the back
+ * (most recent, still in cache) and idle threads steal from the front of
+ * the other deques (oldest, largest pieces of work). Threads that are not
+ * workers (the GLFW thread, anything else) share deque 0. A worker that
+ * finds nothing to run or steal parks on a condition variable until new
+ * work is pushed.
+ *
+ * parallelFor splits [begin, end) into chunks of at least `grain`
+ * iterations by recursive halving, so thieves take half of what is left.
+ * parallelReduce does the same and combines the per-chunk results in
+ * chunk order. Ranges smaller than one grain run inline. The calling
+ * thread always works on its own loop and helps with queued tasks while
+ * it waits, so loops may be nested inside tasks.
+ *
+ * forEachThread runs a body once on every thread with a fixed index
+ * (0 = caller, 1.. = workers). It is built on spawnOn, which pins a task
+ * to one thread so work can stay on the same core from frame to frame;
+ * pinned tasks are never stolen.
+ *
+ * spawn/spawnOn/wait are the low level interface used by TaskGraph.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  // Non-owning reference to a callable, valid while the call it is
+  // passed to runs. Unlike std::function it never allocates, whatever
+  // the lambda captures, so loops in the frame stay allocation-free.
+  template <typename... Args> class FunctionRef {
+  public:
+    template <typename F>
+    FunctionRef(F const &f) : m_callable(&f), m_call(&invoke<F>) {}
+
+    void operator()(Args... args) const { m_call(m_callable, args...); }
+
+  private:
+    template <typename F> static void invoke(void const *f, Args... args) {
+      (*static_cast<F const *>(f))(args...);
+    }
+
+    void const *m_callable;
+    void (*m_call)(void const *, Args...);
+  };
+
+  typedef FunctionRef<int, int> RangeFunc; // (begin, end)
+  typedef FunctionRef<int> ThreadFunc;     // (thread)
+  typedef void (*TaskFunc)(void *context, int a, int b);
+
+  // parallelReduce keeps one result per chunk on the stack
+  enum { MAX_REDUCE_CHUNKS = 256 };
+
+  // Tasks spawned into a group are waited for together
+  class TaskGroup {
+  public:
+    TaskGroup() : m_pending(0) {}
+
+  private:
+    friend class ThreadPool;
+    std::atomic<int> m_pending;
+  };
+
+  // 0 threads = one per hardware thread (the caller counts as one)
+  explicit ThreadPool(unsigned numThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  void parallelFor(int begin, int end, int grain, RangeFunc const &body);
+
+  // combine(identity, map(b0, e0), map(b1, e1), ...) over the chunks.
+  // T must be default constructible.
+  template <typename T, typename MapFunc, typename CombineFunc>
+  T parallelReduce(int begin, int end, int grain, T identity,
+                   MapFunc const &map, CombineFunc const &combine);
+
+  void forEachThread(ThreadFunc const &body);
+
+  // Queue fn(context, a, b). `context` must outlive the task.
+  void spawn(TaskGroup &group, TaskFunc fn, void *context, int a = 0,
+             int b = 0);
+
+  // Queue a task that only thread `thread % size()` will run. Thread 0
+  // means the calling thread, whichever that is.
+  void spawnOn(int thread, TaskGroup &group, TaskFunc fn, void *context,
+               int a = 0, int b = 0);
+
+  // Run queued tasks until every task spawned into `group` has finished
+  void wait(TaskGroup &group);
+
+  unsigned size() const; // workers + caller
+
+  // 1.. on the workers of this pool, 0 on any other thread
+  int threadIndex() const;
+
+private:
+  struct Task {
+    TaskFunc fn;
+    void *context;
+    int a, b;
+    TaskGroup *group;
+  };
+
+  // Ring buffer deque; short critical sections, so a mutex is enough
+  class TaskDeque {
+  public:
+    TaskDeque();
+    void push(Task const &t);
+    bool popBack(Task &t);
+    bool popFront(Task &t);
+
+  private:
+    std::mutex m_mutex;
+    std::vector<Task> m_ring;
+    unsigned m_head, m_count;
+  };
+
+  struct Queue {
+    TaskDeque tasks;  // may be stolen
+    TaskDeque pinned; // spawnOn, owner only
+    std::atomic<int> numPinned;
+    char pad[64]; // keep neighbouring queues off each other's lines
+  };
+
+  struct RangeJob;
+  static void runRange(void *job, int firstChunk, int lastChunk);
+  static void runThreadBody(void *body, int thread, int);
+
+  int chunkSize(int count, int grain) const;
+  bool runOne(int self);
+  void wakeWorkers(bool all);
+  void workerLoop(int index);
+
+  unsigned m_numThreads;
+  std::unique_ptr<Queue[]> m_queues; // 0 = non-worker threads
+  std::vector<std::thread> m_workers;
+
+  // Parking
+  std::mutex m_parkMutex;
+  std::condition_variable m_wake;
+  std::atomic<int> m_queued; // stealable tasks not yet started
+  std::atomic<int> m_sleeping;
+  std::atomic<bool> m_quit;
+};
+
+template <typename T, typename MapFunc, typename CombineFunc>
+T ThreadPool::parallelReduce(int begin, int end, int grain, T identity,
+                             MapFunc const &map, CombineFunc const &combine) {
+  int count = end - begin;
+  if (count <= 0)
+    return identity;
+
+  int chunk = std::max(chunkSize(count, grain),
+                       (count + MAX_REDUCE_CHUNKS - 1) / MAX_REDUCE_CHUNKS);
+  int numChunks = (count + chunk - 1) / chunk;
+  if (numChunks == 1)
+    return combine(identity, map(begin, end));
+
+  T partial[MAX_REDUCE_CHUNKS];
+  parallelFor(0, numChunks, 1, [&](int c0, int c1) {
+    for (int c = c0; c < c1; ++c) {
+      int lo = begin + c * chunk;
+      partial[c] = map(lo, std::min(lo + chunk, end));
+    }
+  });
+
+  T result = identity;
+  for (int c = 0; c < numChunks; ++c)
+    result = combine(result, partial[c]);
+  return result;
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,78 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TreeSolver.h
+ *
+ * Exact O(n) implicit (backward Euler) solver for spring networks whose
+ * free masses form a forest: chains like the pendulum in initSim2, ropes,
+ * hair and other branching strands. Fixed masses act as anchors and split
+ * the graph, so a rope pinned at both ends is still accepted.
+ *
+ * Each step linearises the spring forces and solves
+ *
+ *   (M + h D - h^2 K) dv = h (f + h K v)
+ *
+ * by block (3x3) Gaussian elimination from the leaves towards a root and
+ * back substitution from the root outwards. On a tree this produces no
+ * fill-in, so the cost is linear in the number of masses. Independent
+ * strands (connected components) are solved in parallel.
+ */
+
+#ifndef TREE_SOLVER_H
+#define TREE_SOLVER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "MassSpringSystem.h"
+#include "ThreadPool.h"
+
+class TreeSolver {
+public:
+  TreeSolver();
+
+  // Analyse the topology. Returns false (and step() does nothing) if the
+  // free masses do not form a forest.
+  bool rebuild(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss);
+
+  // After a re-sort of the same scene (SpatialReorder: new index of each
+  // mass and spring by its old index). Keeps the strands and their BFS
+  // order and only rewrites the indices. Does not allocate.
+  void remap(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss,
+             PoolVector<int> const &massIndex,
+             PoolVector<int> const &springIndex);
+
+  bool isTree() const;
+  int numStrands() const;
+
+  void step(PoolVector<Mass> &ms, PoolVector<Spring> &ss, float dt,
+            ThreadPool &pool);
+
+private:
+  void solveStrand(int strand, PoolVector<Mass> &ms,
+                   PoolVector<Spring> const &ss, float dt);
+
+  bool m_isTree;
+
+  // Free masses of each strand in BFS order from its root,
+  // strand s = m_order[m_strandStart[s] .. m_strandStart[s+1])
+  PoolVector<int> m_order;
+  PoolVector<int> m_strandStart;
+
+  // Springs contributing to each strand, same layout
+  PoolVector<int> m_strandSprings;
+  PoolVector<int> m_strandSpringStart;
+
+  // Parent mass in the BFS tree (-1 for a root), and room to permute it
+  PoolVector<int> m_parent, m_parentScratch;
+
+  PoolVector<int> m_indexA, m_indexB;
+
+  // Per-mass blocks of the linear system, reused every step
+  PoolVector<glm::mat3> m_diag;    // A_ii, then its inverse
+  PoolVector<glm::mat3> m_offDiag; // A_i,parent(i)
+  PoolVector<glm::vec3> m_rhs;
+};
+
+#endif // TREE_SOLVER_H
@@ -0,0 +1,51 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TripleBuffer.h
+ *
+ * Lock-free hand-off of whole frames from one producer thread to one
+ * consumer thread. There are three slots: the producer fills its write
+ * slot and publishes it by swapping it with the middle slot; the consumer
+ * swaps the middle slot with its read slot when a newer frame is there.
+ * Neither side ever waits for the other, and the consumer always sees a
+ * complete frame (never one that is still being written).
+ */
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+template <typename T> class TripleBuffer {
+public:
+  TripleBuffer() : m_middle(1), m_write(0), m_read(2) {}
+
+  TripleBuffer(TripleBuffer const &) = delete;
+  TripleBuffer &operator=(TripleBuffer const &) = delete;
+
+  // Producer side
+  T &writeBuffer() { return m_slots[m_write]; }
+  void publish() {
+    m_write = m_middle.exchange(m_write | FRESH) & INDEX;
+  }
+
+  // Consumer side. True if a newer frame replaced the read buffer.
+  bool acquire() {
+    if (!(m_middle.load() & FRESH))
+      return false;
+    m_read = m_middle.exchange(m_read) & INDEX;
+    return true;
+  }
+  T const &readBuffer() const { return m_slots[m_read]; }
+
+private:
+  static const unsigned INDEX = 3;
+  static const unsigned FRESH = 4; // middle slot not yet consumed
+
+  T m_slots[3];
+  std::atomic<unsigned> m_middle;
+  unsigned m_write; // producer only
+  unsigned m_read;  // consumer only
+};
+
+#endif // TRIPLE_BUFFER_H
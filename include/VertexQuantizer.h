@@ -0,0 +1,57 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	VertexQuantizer.h
+ *
+ * Compact vertex formats for the per-frame position upload. Positions are
+ * stored as 3 x 16 bits (half of the 3 x GL_FLOAT layout) and decoded in
+ * basic_vs.glsl as
+ *
+ *   position = positionOffset + positionScale * attribute
+ *
+ * UNORM16: normalized unsigned shorts over the frame's bounding box
+ *          (offset = box corner, scale = box size), so the error is at
+ *          most size / 131070 per axis.
+ * HALF16:  half floats relative to the box centre (offset = centre,
+ *          scale = 1), which keeps the exponent small for scenes far from
+ *          the origin.
+ */
+
+#ifndef VERTEX_QUANTIZER_H
+#define VERTEX_QUANTIZER_H
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+class VertexQuantizer {
+public:
+  enum Format { FLOAT32, UNORM16, HALF16 };
+
+  // Axis-aligned box around n vertices
+  static void bounds(Vec3f const *v, int n, glm::vec3 &lo, glm::vec3 &hi,
+                     ThreadPool &pool);
+
+  // Decode parameters for encoding the box [lo, hi] in `format`
+  static void decodeParams(Format format, glm::vec3 lo, glm::vec3 hi,
+                           glm::vec3 &offset, glm::vec3 &scale);
+
+  // 3 values per vertex into dst
+  static void encode(Format format, Vec3f const *v, int n, glm::vec3 offset,
+                     glm::vec3 scale, uint16_t *dst, ThreadPool &pool);
+
+  static uint16_t toHalf(float f);
+
+  // GL attribute type and normalisation of a format
+  static unsigned glType(Format format);
+  static bool glNormalized(Format format);
+  static int bytesPerVertex(Format format);
+
+  // Single-component texture buffer format that reads the same values
+  static unsigned glTexelFormat(Format format);
+};
+
+#endif // VERTEX_QUANTIZER_H
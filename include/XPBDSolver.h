@@ -0,0 +1,112 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	XPBDSolver.h
+ *
+ * Extended position based dynamics (XPBD) for the mass-spring scenes.
+ * Every Spring becomes a distance constraint with compliance 1/stiffness,
+ * so the result converges to the same rest state as the force-based path
+ * but stays stable for any stiffness and a fixed number of iterations.
+ *
+ * Springs are greedily graph coloured so no two springs in a colour share
+ * a mass. Colours are swept in Gauss-Seidel order and the springs inside
+ * one colour are independent, so each colour is projected in parallel.
+ *
+ * JACOBI mode instead projects every spring from the same positions and
+ * averages the corrections per mass. Each iteration is fully parallel but
+ * converges more slowly, so it is normally wrapped in Chebyshev
+ * acceleration; iterations stop early once the RMS update drops below the
+ * tolerance.
+ */
+
+#ifndef XPBD_SOLVER_H
+#define XPBD_SOLVER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "ChebyshevAccelerator.h"
+#include "MassSpringSystem.h"
+#include "SpringColouring.h"
+#include "ThreadPool.h"
+
+class XPBDSolver {
+public:
+  enum Mode { GAUSS_SEIDEL, JACOBI };
+
+  explicit XPBDSolver(int iterations = 10);
+
+  // Recolour the constraint graph. Call whenever masses/springs change.
+  void rebuild(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss);
+
+  // After a re-sort of the same scene (SpatialReorder, springIndex[old] =
+  // new spring index): keeps the colouring and the Chebyshev state and
+  // only rewrites the indices. Does not allocate.
+  void remap(PoolVector<Mass> const &ms, PoolVector<Spring> const &ss,
+             PoolVector<int> const &springIndex);
+
+  void step(PoolVector<Mass> &ms, PoolVector<Spring> &ss, float dt,
+            ThreadPool &pool);
+
+  int iterations() const;
+  void setIterations(int n);
+  int numColours() const;
+
+  Mode mode() const;
+  void setMode(Mode mode);
+
+  // Chebyshev acceleration of the Jacobi iteration (automatic rho)
+  bool chebyshev() const;
+  void setChebyshev(bool on);
+
+  // Stop early once the RMS update is below tol (0 = always iterate fully)
+  void setTolerance(float tol);
+
+  // Statistics from the last step (Jacobi mode)
+  int lastIterations() const;
+  float lastResidual() const;
+
+private:
+  // m_indexA/B and m_invMass from the scene, then the incidence lists
+  void buildIndices(PoolVector<Mass> const &ms,
+                    PoolVector<Spring> const &ss);
+
+  void solveGaussSeidel(PoolVector<Mass> &ms, PoolVector<Spring> const &ss,
+                        float invDt2, ThreadPool &pool);
+  void solveJacobi(PoolVector<Mass> &ms, PoolVector<Spring> const &ss,
+                   float invDt2, ThreadPool &pool);
+
+  void projectColour(int colour, PoolVector<Mass> &ms,
+                     PoolVector<Spring> const &ss, float invDt2,
+                     ThreadPool &pool);
+
+  int m_iterations;
+  Mode m_mode;
+  bool m_chebyshev;
+  float m_tolerance;
+  int m_lastIterations;
+  float m_lastResidual;
+
+  SpringColouring m_colouring;
+
+  // Per-spring endpoint indices and per-mass inverse mass
+  PoolVector<int> m_indexA, m_indexB;
+  PoolVector<float> m_invMass;
+
+  // Springs touching each mass (CSR), stored as 2 * spring + (mass is b)
+  PoolVector<int> m_incidentStart;
+  PoolVector<int> m_incident;
+  PoolVector<int> m_fill;
+
+  // Per-step scratch
+  PoolVector<float> m_lambda;
+  PoolVector<glm::vec3> m_prevPosition;
+
+  // Jacobi state: 3 floats per mass followed by one lambda per spring
+  PoolVector<float> m_state;
+  PoolVector<glm::vec3> m_correction;
+  ChebyshevAccelerator m_accelerator;
+};
+
+#endif // XPBD_SOLVER_H
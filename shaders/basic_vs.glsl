@@ -4,10 +4,15 @@ layout( location = 0 ) in vec3 vert_modelSpace;
 uniform mat4 MVP;
 uniform vec3 inputColor;
 
+// Positions may be uploaded quantised (see VertexQuantizer.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 out vec3 interpolateColor;
 
 void main()
 {
-	gl_Position = MVP * vec4( vert_modelSpace, 1.0 );
+	vec3 position = positionOffset + positionScale * vert_modelSpace;
+	gl_Position = MVP * vec4( position, 1.0 );
 	interpolateColor = inputColor;
 }
@@ -0,0 +1,58 @@
+#version 330
+layout( location = 0 ) in vec3 gridCoord;
+layout( location = 1 ) in vec2 faceAxes;
+
+uniform mat4 MVP;
+uniform vec3 inputColor;
+
+// Coarse particle positions, 3 floats per grid point (see SkinnedMesh.h)
+uniform samplerBuffer gridPositions;
+uniform ivec3 gridSize;
+
+out vec3 interpolateColor;
+
+vec3 gridPosition( ivec3 g )
+{
+	int i = 3 * ( g.x + gridSize.x * ( g.y + gridSize.y * g.z ) );
+	return vec3( texelFetch( gridPositions, i ).r,
+				 texelFetch( gridPositions, i + 1 ).r,
+				 texelFetch( gridPositions, i + 2 ).r );
+}
+
+void main()
+{
+	// Cell corner and position in the cell; flat axes have one layer
+	ivec3 base = min( ivec3( gridCoord ), max( gridSize - 2, 0 ) );
+	ivec3 next = min( ivec3( 1 ), gridSize - 1 );
+	vec3 t = gridCoord - vec3( base );
+	int a = int( faceAxes.x );
+	int b = int( faceAxes.y );
+
+	// Trilinear blend and its derivatives along the two face axes
+	vec3 position = vec3( 0.0 );
+	vec3 dA = vec3( 0.0 );
+	vec3 dB = vec3( 0.0 );
+	for( int k = 0; k < 8; k++ )
+	{
+		ivec3 corner = ivec3( k & 1, ( k >> 1 ) & 1, ( k >> 2 ) & 1 );
+		vec3 p = gridPosition( base + corner * next );
+
+		vec3 w = mix( 1.0 - t, t, vec3( corner ) );
+		vec3 dw = mix( vec3( -1.0 ), vec3( 1.0 ), vec3( corner ) );
+		vec3 wA = w;
+		vec3 wB = w;
+		wA[a] = dw[a];
+		wB[b] = dw[b];
+
+		position += w.x * w.y * w.z * p;
+		dA += wA.x * wA.y * wA.z * p;
+		dB += wB.x * wB.y * wB.z * p;
+	}
+
+	// Two-sided diffuse light from above
+	vec3 normal = normalize( cross( dA, dB ) );
+	float diffuse = abs( dot( normal, normalize( vec3( 0.3, 1.0, 0.5 ) ) ) );
+	interpolateColor = inputColor * ( 0.25 + 0.75 * diffuse );
+
+	gl_Position = MVP * vec4( position, 1.0 );
+}
@@ -0,0 +1,42 @@
+#version 330
+layout( location = 0 ) in vec3 vert_modelSpace;
+layout( location = 1 ) in float restLength;
+
+uniform mat4 MVP;
+
+// Positions may be uploaded quantised (see VertexQuantizer.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+// The line vertex buffer again, one component per texel, so each vertex
+// can read the other end of its spring (vertex 2s pairs with 2s+1)
+uniform samplerBuffer linePositions;
+
+// Strain drawn at full colour
+uniform float strainRange;
+
+out vec3 interpolateColor;
+
+vec3 linePosition( int v )
+{
+	vec3 p = vec3( texelFetch( linePositions, 3 * v ).r,
+				   texelFetch( linePositions, 3 * v + 1 ).r,
+				   texelFetch( linePositions, 3 * v + 2 ).r );
+	return positionOffset + positionScale * p;
+}
+
+void main()
+{
+	vec3 position = positionOffset + positionScale * vert_modelSpace;
+	vec3 other = linePosition( gl_VertexID ^ 1 );
+	float strain = ( distance( position, other ) - restLength ) /
+				   max( restLength, 1e-6 );
+
+	// Compressed -> blue, at rest -> the plain line colour, stretched -> red
+	float t = clamp( strain / strainRange, -1.0, 1.0 );
+	vec3 rest = vec3( 0.0, 1.0, 1.0 );
+	interpolateColor = t < 0.0 ? mix( rest, vec3( 0.0, 0.0, 1.0 ), -t )
+							   : mix( rest, vec3( 1.0, 0.0, 0.0 ), t );
+
+	gl_Position = MVP * vec4( position, 1.0 );
+}
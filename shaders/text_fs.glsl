@@ -0,0 +1,15 @@
+#version 330 core
+
+in vec2 texel;
+
+uniform sampler2D font;
+uniform vec3 textColor;
+
+out vec3 color;
+
+void main()
+{
+	if( texelFetch( font, ivec2( texel ), 0 ).r < 0.5 )
+		discard;
+	color = textColor;
+}
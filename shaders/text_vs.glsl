@@ -0,0 +1,15 @@
+#version 330
+// x, y in pixels from the top left corner, u, v in font texels
+layout( location = 0 ) in vec4 vert_screen;
+
+uniform vec2 screenSize;
+uniform vec2 offset;
+
+out vec2 texel;
+
+void main()
+{
+	vec2 p = (vert_screen.xy + offset) / screenSize;
+	gl_Position = vec4( 2.0 * p.x - 1.0, 1.0 - 2.0 * p.y, 0.0, 1.0 );
+	texel = vert_screen.zw;
+}
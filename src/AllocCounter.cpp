@@ -0,0 +1,199 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	AllocCounter.cpp
+ */
+
+#include "AllocCounter.h"
+
+#ifdef A3_COUNT_ALLOCS
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ostream>
+
+namespace {
+// Fixed table, since the counters cannot allocate themselves. Phases
+// are found by name pointer; report() merges equal names.
+const int MAX_PHASES = 128;
+
+struct PhaseCount {
+  std::atomic<char const *> name;
+  std::atomic<int64_t> count, bytes;
+};
+
+PhaseCount s_phases[MAX_PHASES];
+std::atomic<int> s_numPhases(0);
+std::atomic<int> s_adding(0); // spin lock for new table entries
+std::atomic<int64_t> s_total(0);
+std::atomic<int> s_frames(0);
+std::atomic<bool> s_forbidden(false);
+
+char const *const NO_PHASE = "(none)";
+
+thread_local char const *t_phase = nullptr;
+thread_local int t_allowed = 0;
+thread_local int t_ignored = 0;
+
+PhaseCount &phaseCount(char const *name) {
+  int n = s_numPhases.load(std::memory_order_acquire);
+  for (int i = 0; i < n; ++i)
+    if (s_phases[i].name.load(std::memory_order_relaxed) == name)
+      return s_phases[i];
+
+  while (s_adding.exchange(1, std::memory_order_acquire))
+    ;
+  n = s_numPhases.load(std::memory_order_relaxed);
+  int i = 0;
+  while (i < n && s_phases[i].name.load(std::memory_order_relaxed) != name)
+    ++i;
+  if (i == n && n < MAX_PHASES) {
+    s_phases[n].name.store(name, std::memory_order_relaxed);
+    s_numPhases.store(n + 1, std::memory_order_release);
+  }
+  s_adding.store(0, std::memory_order_release);
+
+  // A full table puts the rest in the last entry
+  return s_phases[i < MAX_PHASES ? i : MAX_PHASES - 1];
+}
+
+void *allocate(std::size_t size) {
+  if (t_ignored > 0)
+    return std::malloc(size ? size : 1);
+
+  char const *phase = t_phase ? t_phase : NO_PHASE;
+  if (s_forbidden.load(std::memory_order_relaxed) && t_allowed == 0) {
+    std::fprintf(stderr,
+                 "Allocation of %zu bytes in phase \"%s\" while allocations "
+                 "are forbidden\n",
+                 size, phase);
+    std::abort();
+  }
+
+  PhaseCount &c = phaseCount(phase);
+  c.count.fetch_add(1, std::memory_order_relaxed);
+  c.bytes.fetch_add(size, std::memory_order_relaxed);
+  s_total.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+} // namespace
+
+void *operator new(std::size_t size) {
+  if (void *p = allocate(size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+  if (void *p = allocate(size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::nothrow_t const &) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, std::nothrow_t const &) noexcept {
+  std::free(p);
+}
+
+bool AllocCounter::compiled() { return true; }
+
+void AllocCounter::nextFrame() {
+  s_frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t AllocCounter::allocations() { return s_total.load(); }
+
+void AllocCounter::reset() {
+  int n = s_numPhases.load(std::memory_order_acquire);
+  for (int i = 0; i < n; ++i) {
+    s_phases[i].count.store(0);
+    s_phases[i].bytes.store(0);
+  }
+  s_total.store(0);
+  s_frames.store(0);
+}
+
+void AllocCounter::forbid(bool on) { s_forbidden.store(on); }
+
+void AllocCounter::report(std::ostream &out) {
+  bool forbidden = s_forbidden.exchange(false);
+  int frames = s_frames.load();
+  int n = s_numPhases.load(std::memory_order_acquire);
+
+  out << "Allocations (" << s_total.load() << " in " << frames
+      << " frames)" << std::endl;
+  for (int i = 0; i < n; ++i) {
+    char const *name = s_phases[i].name.load();
+    int first = 0;
+    while (std::strcmp(s_phases[first].name.load(), name) != 0)
+      ++first;
+    if (first < i)
+      continue; // merged into the first entry of that name
+
+    int64_t count = 0, bytes = 0;
+    for (int j = i; j < n; ++j)
+      if (std::strcmp(s_phases[j].name.load(), name) == 0) {
+        count += s_phases[j].count.load();
+        bytes += s_phases[j].bytes.load();
+      }
+
+    if (count == 0)
+      continue;
+
+    char line[128];
+    std::snprintf(line, sizeof(line),
+                  "%-16s %10lld allocs %12lld bytes %10.2f per frame", name,
+                  (long long)count, (long long)bytes,
+                  frames > 0 ? double(count) / frames : 0.0);
+    out << line << std::endl;
+  }
+  s_forbidden.store(forbidden);
+}
+
+AllocCounter::Phase::Phase(char const *name) : m_outer(t_phase) {
+  t_phase = name;
+}
+
+AllocCounter::Phase::~Phase() { t_phase = m_outer; }
+
+AllocCounter::Allow::Allow() { ++t_allowed; }
+
+AllocCounter::Allow::~Allow() { --t_allowed; }
+
+AllocCounter::Ignore::Ignore() { ++t_ignored; }
+
+AllocCounter::Ignore::~Ignore() { --t_ignored; }
+
+#else // A3_COUNT_ALLOCS
+
+bool AllocCounter::compiled() { return false; }
+void AllocCounter::nextFrame() {}
+int64_t AllocCounter::allocations() { return 0; }
+void AllocCounter::reset() {}
+void AllocCounter::forbid(bool) {}
+void AllocCounter::report(std::ostream &) {}
+AllocCounter::Phase::Phase(char const *) : m_outer(nullptr) {}
+AllocCounter::Phase::~Phase() {}
+AllocCounter::Allow::Allow() {}
+AllocCounter::Allow::~Allow() {}
+AllocCounter::Ignore::Ignore() {}
+AllocCounter::Ignore::~Ignore() {}
+
+#endif // A3_COUNT_ALLOCS
@@ -0,0 +1,62 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	Arena.cpp
+ */
+
+#include "Arena.h"
+
+#include <cstdint>
+
+Arena::Arena(size_t blockBytes)
+    : m_blocks(nullptr), m_top(nullptr), m_end(nullptr), m_used(0),
+      m_blockBytes(blockBytes) {}
+
+Arena::~Arena() { releaseBlocks(); }
+
+void *Arena::allocate(size_t bytes, size_t align) {
+  uintptr_t top = (uintptr_t(m_top) + align - 1) & ~uintptr_t(align - 1);
+  if (!m_blocks || top + bytes > uintptr_t(m_end)) {
+    size_t need = HEADER + bytes + align;
+    addBlock(need > m_blockBytes ? need : m_blockBytes);
+    top = (uintptr_t(m_top) + align - 1) & ~uintptr_t(align - 1);
+  }
+
+  m_used += top + bytes - uintptr_t(m_top);
+  m_top = reinterpret_cast<char *>(top + bytes);
+  return reinterpret_cast<void *>(top);
+}
+
+void Arena::reset() {
+  if (m_blocks && m_blocks->next) {
+    size_t total = capacity();
+    releaseBlocks();
+    addBlock(total);
+  } else if (m_blocks)
+    m_top = reinterpret_cast<char *>(m_blocks) + HEADER;
+  m_used = 0;
+}
+
+size_t Arena::capacity() const {
+  size_t total = 0;
+  for (Block *b = m_blocks; b; b = b->next)
+    total += b->size;
+  return total;
+}
+
+void Arena::addBlock(size_t bytes) {
+  Block *b = static_cast<Block *>(BufferPool::global().allocate(bytes));
+  b->next = m_blocks;
+  b->size = bytes;
+  m_blocks = b;
+  m_top = reinterpret_cast<char *>(b) + HEADER;
+  m_end = reinterpret_cast<char *>(b) + bytes;
+}
+
+void Arena::releaseBlocks() {
+  while (Block *b = m_blocks) {
+    m_blocks = b->next;
+    BufferPool::global().release(b, b->size);
+  }
+  m_top = m_end = nullptr;
+}
@@ -0,0 +1,180 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	BufferPool.cpp
+ */
+
+#include "BufferPool.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+BufferPool::BufferPool()
+    : m_large(nullptr), m_reserved(0), m_used(0), m_systemAllocations(0),
+      m_hugePages(false) {
+  for (int c = 0; c < NUM_CLASSES; ++c)
+    m_free[c] = nullptr;
+}
+
+// Buffers still in use stay allocated
+BufferPool::~BufferPool() { trim(); }
+
+BufferPool &BufferPool::global() {
+  static BufferPool *pool = new BufferPool();
+  return *pool;
+}
+
+// Smallest c >= MIN_CLASS with bytes <= 2^c
+int BufferPool::sizeClass(size_t bytes) {
+  int c = MIN_CLASS;
+  while (c < NUM_CLASSES - 1 && (size_t(1) << c) < bytes)
+    ++c;
+  return c;
+}
+
+size_t BufferPool::bufferSize(size_t bytes) {
+  if (bytes >= HUGE_PAGE)
+    return (bytes + HUGE_PAGE - 1) & ~size_t(HUGE_PAGE - 1);
+  return size_t(1) << sizeClass(bytes);
+}
+
+void *BufferPool::allocate(size_t bytes) {
+  size_t size = bufferSize(bytes);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_used += size;
+  if (size >= HUGE_PAGE) {
+    // First free buffer of exactly this size
+    for (LargeBuffer **b = &m_large; *b; b = &(*b)->next) {
+      if ((*b)->size == size) {
+        LargeBuffer *found = *b;
+        *b = found->next;
+        return found;
+      }
+    }
+  } else if (FreeBuffer *b = m_free[sizeClass(size)]) {
+    m_free[sizeClass(size)] = b->next;
+    return b;
+  }
+
+  void *p = systemAllocate(size);
+  if (!p) {
+    m_used -= size;
+    throw std::bad_alloc();
+  }
+  m_reserved += size;
+  ++m_systemAllocations;
+  return p;
+}
+
+void BufferPool::release(void *p, size_t bytes) {
+  if (!p)
+    return;
+  size_t size = bufferSize(bytes);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (size >= HUGE_PAGE) {
+    LargeBuffer *b = static_cast<LargeBuffer *>(p);
+    b->next = m_large;
+    b->size = size;
+    m_large = b;
+  } else {
+    FreeBuffer *b = static_cast<FreeBuffer *>(p);
+    int c = sizeClass(size);
+    b->next = m_free[c];
+    m_free[c] = b;
+  }
+  m_used -= size;
+}
+
+void BufferPool::trim() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (int c = 0; c < NUM_CLASSES; ++c) {
+    while (FreeBuffer *b = m_free[c]) {
+      m_free[c] = b->next;
+      systemRelease(b, size_t(1) << c);
+      m_reserved -= size_t(1) << c;
+    }
+  }
+  while (LargeBuffer *b = m_large) {
+    m_large = b->next;
+    m_reserved -= b->size;
+    systemRelease(b, b->size);
+  }
+}
+
+void BufferPool::setHugePages(bool on) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_hugePages = on;
+}
+
+// Huge buffers are whole huge pages (bufferSize)
+void *BufferPool::systemAllocate(size_t size) {
+#ifdef __linux__
+  if (size >= HUGE_PAGE) {
+    // Map one huge page more and cut the ends off to align it
+    size_t mapped = size + HUGE_PAGE;
+    void *m = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED)
+      return nullptr;
+    uintptr_t start = uintptr_t(m);
+    uintptr_t aligned = (start + HUGE_PAGE - 1) & ~uintptr_t(HUGE_PAGE - 1);
+    if (aligned > start)
+      munmap(m, aligned - start);
+    if (start + mapped > aligned + size)
+      munmap(reinterpret_cast<void *>(aligned + size),
+             start + mapped - (aligned + size));
+
+    void *p = reinterpret_cast<void *>(aligned);
+    if (m_hugePages)
+      madvise(p, size, MADV_HUGEPAGE);
+    return p;
+  }
+#endif
+  void *p = nullptr;
+  size_t align = size >= HUGE_PAGE ? HUGE_PAGE : CACHE_LINE;
+  return posix_memalign(&p, align, size) == 0 ? p : nullptr;
+}
+
+void BufferPool::systemRelease(void *p, size_t size) {
+#ifdef __linux__
+  if (size >= HUGE_PAGE) {
+    munmap(p, size);
+    return;
+  }
+#endif
+  std::free(p);
+}
+
+size_t BufferPool::reservedBytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_reserved;
+}
+
+size_t BufferPool::usedBytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_used;
+}
+
+int64_t BufferPool::systemAllocations() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_systemAllocations;
+}
+
+void BufferPool::report(std::ostream &out) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  char line[128];
+  std::snprintf(line, sizeof(line),
+                "Buffer pool: %.2f MB reserved, %.2f MB in use, %lld system "
+                "allocations",
+                m_reserved / 1048576.0, m_used / 1048576.0,
+                (long long)m_systemAllocations);
+  out << line << std::endl;
+}
@@ -0,0 +1,102 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	ChebyshevAccelerator.cpp
+ */
+
+#include "ChebyshevAccelerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+const int BLOCK = 4096;
+
+// Underestimating rho only slows convergence; overestimating diverges
+const float RHO_SAFETY = 0.99f;
+const float RHO_MAX = 0.9995f;
+const float RHO_SMOOTHING = 0.8f;
+} // namespace
+
+ChebyshevAccelerator::ChebyshevAccelerator(int delay)
+    : m_delay(std::max(delay, 2)), m_k(0), m_omega(1.f), m_rho(0.f),
+      m_autoRho(true), m_haveRho(false), m_lastNorm(0.f) {}
+
+void ChebyshevAccelerator::reset() {
+  if (m_autoRho) {
+    m_rho = 0.f;
+    m_haveRho = false;
+  }
+}
+
+float ChebyshevAccelerator::spectralRadius() const { return m_rho; }
+
+void ChebyshevAccelerator::setSpectralRadius(float rho) {
+  m_autoRho = rho < 0.f;
+  m_haveRho = !m_autoRho;
+  m_rho = m_autoRho ? 0.f : std::min(rho, RHO_MAX);
+}
+
+void ChebyshevAccelerator::begin(float const *x, int n) {
+  m_prev.assign(x, x + n);
+  m_curr.assign(x, x + n);
+  m_k = 0;
+  m_omega = 1.f;
+  m_lastNorm = 0.f;
+}
+
+float ChebyshevAccelerator::update(float *x, int n, ThreadPool &pool) {
+  int numBlocks = (n + BLOCK - 1) / BLOCK;
+
+  // Chebyshev weight for this iteration
+  float omega = 1.f;
+  if (m_haveRho && m_k >= m_delay) {
+    float rho2 = m_rho * m_rho;
+    omega = (m_k == m_delay) ? 2.f / (2.f - rho2)
+                             : 4.f / (4.f - rho2 * m_omega);
+  }
+  m_omega = omega;
+
+  float *prev = m_prev.data();
+  float const *curr = m_curr.data();
+
+  // One pass: measure the plain update, blend, and rotate the history so
+  // m_prev becomes the new iterate (swapped into m_curr below)
+  double total = pool.parallelReduce(
+      0, numBlocks, 1, 0.0,
+      [&](int begin, int end) {
+        double sum = 0.0;
+        for (int b = begin; b < end; ++b) {
+          int lo = b * BLOCK;
+          int hi = std::min(lo + BLOCK, n);
+
+          for (int i = lo; i < hi; ++i) {
+            float d = x[i] - curr[i];
+            sum += double(d) * d;
+
+            if (omega != 1.f)
+              x[i] = omega * (x[i] - prev[i]) + prev[i];
+            prev[i] = x[i];
+          }
+        }
+        return sum;
+      },
+      [](double a, double b) { return a + b; });
+  m_prev.swap(m_curr);
+
+  float norm = n > 0 ? float(std::sqrt(total / n)) : 0.f;
+
+  // Estimate rho from the contraction of the last plain iteration
+  if (m_autoRho && m_k == m_delay - 1 && m_lastNorm > 0.f) {
+    float ratio = std::min(norm / m_lastNorm, 1.f) * RHO_SAFETY;
+    m_rho = m_haveRho ? RHO_SMOOTHING * m_rho + (1.f - RHO_SMOOTHING) * ratio
+                      : ratio;
+    m_rho = std::min(m_rho, RHO_MAX);
+    m_haveRho = true;
+  }
+
+  m_lastNorm = norm;
+  ++m_k;
+  return norm;
+}
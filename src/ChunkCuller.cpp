@@ -0,0 +1,167 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	ChunkCuller.cpp
+ */
+
+#include "ChunkCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+namespace {
+// Chunks per task when computing bounds
+const int CHUNK_GRAIN = 16;
+
+const int CHUNK_BITS = 10;
+static_assert(ChunkCuller::CHUNK == 1 << CHUNK_BITS, "CHUNK is 2^CHUNK_BITS");
+
+ChunkCuller::Box const EMPTY = {vec3(1e30f), vec3(-1e30f)};
+
+int reverseBits(int j) {
+  int r = 0;
+  for (int b = 0; b < CHUNK_BITS; ++b)
+    r |= ((j >> b) & 1) << (CHUNK_BITS - 1 - b);
+  return r;
+}
+
+inline void grow(ChunkCuller::Box &box, vec3 p) {
+  box.lo = min(box.lo, p);
+  box.hi = max(box.hi, p);
+}
+} // namespace
+
+ChunkCuller::ChunkCuller() : m_eye(0.f), m_lodDistance(20.f) {
+  for (vec4 &plane : m_planes)
+    plane = vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+void ChunkCuller::bounds(Vec3f const *v, int numElements,
+                         int vertsPerElement, std::vector<Box> &out,
+                         ThreadPool &pool) {
+  int numChunks = (numElements + CHUNK - 1) / CHUNK;
+  out.resize(numChunks);
+
+  pool.parallelFor(0, numChunks, CHUNK_GRAIN, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      int first = c * CHUNK * vertsPerElement;
+      int last = std::min(c * CHUNK + CHUNK, numElements) * vertsPerElement;
+
+      Box box = EMPTY;
+      for (int i = first; i < last; ++i)
+        grow(box, vec3(v[i].x(), v[i].y(), v[i].z()));
+      out[c] = box;
+    }
+  });
+}
+
+void ChunkCuller::massBounds(PoolVector<Mass> const &ms, float pad,
+                             std::vector<Box> &out, ThreadPool &pool) {
+  int n = ms.size();
+  int numChunks = (n + CHUNK - 1) / CHUNK;
+  out.resize(numChunks);
+
+  pool.parallelFor(0, numChunks, CHUNK_GRAIN, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      Box box = EMPTY;
+      for (int i = c * CHUNK; i < std::min(c * CHUNK + CHUNK, n); ++i)
+        grow(box, ms[i].position);
+      box.lo -= vec3(pad, pad, 0.f);
+      box.hi += vec3(pad, pad, 0.f);
+      out[c] = box;
+    }
+  });
+}
+
+void ChunkCuller::springBounds(PoolVector<Spring> const &ss,
+                               std::vector<Box> &out, ThreadPool &pool) {
+  int n = ss.size();
+  int numChunks = (n + CHUNK - 1) / CHUNK;
+  out.resize(numChunks);
+
+  pool.parallelFor(0, numChunks, CHUNK_GRAIN, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      Box box = EMPTY;
+      for (int i = c * CHUNK; i < std::min(c * CHUNK + CHUNK, n); ++i) {
+        grow(box, ss[i].a->position);
+        grow(box, ss[i].b->position);
+      }
+      out[c] = box;
+    }
+  });
+}
+
+void ChunkCuller::lodIndices(int vertsPerElement, std::vector<uint16_t> &out) {
+  out.resize(CHUNK * vertsPerElement);
+  for (int j = 0; j < CHUNK; ++j) {
+    int element = reverseBits(j);
+    for (int k = 0; k < vertsPerElement; ++k)
+      out[j * vertsPerElement + k] = element * vertsPerElement + k;
+  }
+}
+
+// Gribb-Hartmann: the planes are sums and differences of the rows of the
+// (row-major) clip matrix
+void ChunkCuller::setView(Mat4f const &viewProjection, vec3 eye) {
+  vec4 row[4];
+  for (int r = 0; r < 4; ++r)
+    row[r] = vec4(viewProjection(r, 0), viewProjection(r, 1),
+                  viewProjection(r, 2), viewProjection(r, 3));
+
+  for (int axis = 0; axis < 3; ++axis) {
+    m_planes[2 * axis] = row[3] + row[axis];
+    m_planes[2 * axis + 1] = row[3] - row[axis];
+  }
+  m_eye = eye;
+}
+
+void ChunkCuller::setLodDistance(float distance) {
+  m_lodDistance = std::max(distance, 1e-3f);
+}
+
+bool ChunkCuller::visible(Box const &box) const {
+  for (vec4 const &plane : m_planes) {
+    // Corner furthest along the plane normal
+    vec3 p(plane.x >= 0.f ? box.hi.x : box.lo.x,
+           plane.y >= 0.f ? box.hi.y : box.lo.y,
+           plane.z >= 0.f ? box.hi.z : box.lo.z);
+    if (dot(vec3(plane), p) + plane.w < 0.f)
+      return false;
+  }
+  return true;
+}
+
+int ChunkCuller::level(Box const &box) const {
+  float d = distance(clamp(m_eye, box.lo, box.hi), m_eye);
+  if (d <= m_lodDistance)
+    return 0;
+  return std::min(int(std::log2(d / m_lodDistance)), int(MAX_LEVEL));
+}
+
+void ChunkCuller::select(std::vector<Box> const &chunks, int numElements,
+                         int vertsPerElement, DrawList &out) const {
+  out.counts.clear();
+  out.baseVertex.clear();
+  out.indices.clear();
+  out.tailFirst = out.tailCount = 0;
+  out.elements = 0;
+
+  int full = std::min(numElements / CHUNK, int(chunks.size()));
+  for (int c = 0; c < full; ++c) {
+    if (!visible(chunks[c]))
+      continue;
+    int elements = CHUNK >> level(chunks[c]);
+    out.counts.push_back(elements * vertsPerElement);
+    out.baseVertex.push_back(c * CHUNK * vertsPerElement);
+    out.indices.push_back(nullptr);
+    out.elements += elements;
+  }
+
+  if (full < int(chunks.size()) && visible(chunks[full])) {
+    out.tailFirst = full * CHUNK * vertsPerElement;
+    out.tailCount = (numElements - full * CHUNK) * vertsPerElement;
+    out.elements += numElements - full * CHUNK;
+  }
+}
@@ -0,0 +1,206 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	DomainSolver.cpp
+ */
+
+#include "DomainSolver.h"
+
+#include <algorithm>
+#include <map>
+
+#include "NumaPlacement.h"
+
+using namespace glm;
+
+DomainSolver::DomainSolver()
+    : m_numDomains(0), m_contact(nullptr), m_ms(nullptr), m_ss(nullptr) {}
+
+int DomainSolver::numDomains() const { return m_numDomains; }
+int DomainSolver::numHaloSlots() const { return m_halo.size(); }
+PoolVector<int> const &DomainSolver::massStart() const { return m_massStart; }
+
+void DomainSolver::rebuild(PoolVector<Mass> const &ms,
+                           PoolVector<Spring> const &ss,
+                           std::vector<int> const &part, int numDomains) {
+  int nm = ms.size();
+  int ns = ss.size();
+  m_numDomains = std::max(numDomains, 1);
+  int nd = m_numDomains;
+
+  // Bucket masses and springs by domain (counting sort keeps them in
+  // memory order inside a domain)
+  m_massStart.assign(nd + 1, 0);
+  for (int i = 0; i < nm; ++i)
+    ++m_massStart[part[i] + 1];
+  for (int d = 0; d < nd; ++d)
+    m_massStart[d + 1] += m_massStart[d];
+  m_masses.resize(nm);
+  std::vector<int> fill(m_massStart.begin(), m_massStart.end() - 1);
+  for (int i = 0; i < nm; ++i)
+    m_masses[fill[part[i]]++] = i;
+
+  m_springStart.assign(nd + 1, 0);
+  for (int s = 0; s < ns; ++s)
+    ++m_springStart[part[ss[s].a - ms.data()] + 1];
+  for (int d = 0; d < nd; ++d)
+    m_springStart[d + 1] += m_springStart[d];
+  m_springs.resize(ns);
+  fill.assign(m_springStart.begin(), m_springStart.end() - 1);
+  for (int s = 0; s < ns; ++s)
+    m_springs[fill[part[ss[s].a - ms.data()]]++] = s;
+
+  // Halo slots, allocated domain by domain so each writer's slots are
+  // contiguous
+  m_springSlot.assign(ns, -1);
+  m_haloTarget.clear();
+  for (int d = 0; d < nd; ++d) {
+    std::map<int, int> slotOf;
+    for (int k = m_springStart[d]; k < m_springStart[d + 1]; ++k) {
+      int b = ss[m_springs[k]].b - ms.data();
+      if (part[b] == d)
+        continue;
+
+      std::map<int, int>::iterator it = slotOf.find(b);
+      if (it == slotOf.end()) {
+        it = slotOf.insert(std::make_pair(b, int(m_haloTarget.size()))).first;
+        m_haloTarget.push_back(b);
+      }
+      m_springSlot[k] = it->second;
+    }
+  }
+  m_halo.assign(m_haloTarget.size(), vec3(0.f));
+
+  // Slots each domain collects for its own masses
+  int nh = m_haloTarget.size();
+  m_collectStart.assign(nd + 1, 0);
+  for (int h = 0; h < nh; ++h)
+    ++m_collectStart[part[m_haloTarget[h]] + 1];
+  for (int d = 0; d < nd; ++d)
+    m_collectStart[d + 1] += m_collectStart[d];
+  m_collect.resize(nh);
+  fill.assign(m_collectStart.begin(), m_collectStart.end() - 1);
+  for (int h = 0; h < nh; ++h)
+    m_collect[fill[part[m_haloTarget[h]]]++] = h;
+
+  // Domains whose force node writes the halo of each domain
+  std::vector<std::vector<int>> writers(nd);
+  for (int d = 0; d < nd; ++d) {
+    for (int k = m_springStart[d]; k < m_springStart[d + 1]; ++k) {
+      if (m_springSlot[k] >= 0)
+        writers[part[ss[m_springs[k]].b - ms.data()]].push_back(d);
+    }
+  }
+
+  m_graph.clear();
+  std::vector<int> forceNode(nd), contactNode(nd), integrateNode(nd);
+  for (int d = 0; d < nd; ++d) {
+    forceNode[d] = m_graph.add([this, d] { accumulate(d); }, d);
+    contactNode[d] = m_graph.add([this, d] { findContacts(d); });
+    integrateNode[d] = m_graph.add([this, d] { integrate(d); }, d);
+  }
+  for (int d = 0; d < nd; ++d) {
+    std::sort(writers[d].begin(), writers[d].end());
+    writers[d].erase(std::unique(writers[d].begin(), writers[d].end()),
+                     writers[d].end());
+
+    m_graph.precede(forceNode[d], integrateNode[d]);
+    m_graph.precede(contactNode[d], integrateNode[d]);
+    for (int e : writers[d])
+      m_graph.precede(forceNode[e], integrateNode[d]);
+  }
+}
+
+void DomainSolver::remap(PoolVector<int> const &massIndex,
+                         PoolVector<int> const &springIndex) {
+  // A spring's domain is that of its first endpoint, which did not move
+  // to another domain, so the halo slots and the graph stay valid
+  for (int &i : m_masses)
+    i = massIndex[i];
+  for (int d = 0; d < m_numDomains; ++d)
+    std::sort(m_masses.begin() + m_massStart[d],
+              m_masses.begin() + m_massStart[d + 1]);
+  for (int &s : m_springs)
+    s = springIndex[s];
+  for (int &b : m_haloTarget)
+    b = massIndex[b];
+}
+
+void DomainSolver::place(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                         ThreadPool &pool) {
+  int nm = ms.size();
+  int ns = ss.size();
+  int nd = m_numDomains;
+  if (int(m_masses.size()) != nm)
+    return;
+  for (int i = 0; i < nm; ++i)
+    if (m_masses[i] != i)
+      return; // not grouped
+  NumaPlacement::firstTouch(ms.data(), sizeof(Mass), m_massStart.data(), nd,
+                            pool);
+
+  // A spring belongs to the domain of its endpoint a, as in rebuild().
+  // Grouping sorts springs by that endpoint, so the springs of a domain
+  // follow each other.
+  std::vector<int> springStart(nd + 1, 0);
+  int d = 0;
+  for (int s = 0; s < ns; ++s) {
+    int a = ss[s].a - ms.data();
+    while (d < nd && a >= m_massStart[d + 1])
+      springStart[++d] = s;
+  }
+  while (d < nd)
+    springStart[++d] = ns;
+  NumaPlacement::firstTouch(ss.data(), sizeof(Spring), springStart.data(),
+                            nd, pool);
+}
+
+void DomainSolver::step(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                        ThreadPool &pool) {
+  m_ms = &ms;
+  m_ss = &ss;
+  m_contact = stepArena.allocate<unsigned char>(ms.size());
+  m_graph.run(pool);
+}
+
+// Same force as applyForces, with foreign endpoints routed to the halo
+void DomainSolver::accumulate(int domain) {
+  PoolVector<Spring> const &ss = *m_ss;
+
+  for (int k = m_springStart[domain]; k < m_springStart[domain + 1]; ++k) {
+    Spring const &s = ss[m_springs[k]];
+
+    float springLength = getLength(s.a, s.b);
+    vec3 unitAB = (s.b->position - s.a->position) / springLength;
+
+    // hooke = -k(x-x0)AB
+    vec3 hooke = (-s.stiffness) * (springLength - s.restLength) * unitAB;
+    vec3 bAcc = hooke / (s.b->mass);
+
+    s.a->acc -= bAcc;
+    if (m_springSlot[k] < 0)
+      s.b->acc += bAcc;
+    else
+      m_halo[m_springSlot[k]] += bAcc;
+  }
+}
+
+void DomainSolver::findContacts(int domain) {
+  PoolVector<Mass> const &ms = *m_ms;
+
+  for (int k = m_massStart[domain]; k < m_massStart[domain + 1]; ++k)
+    m_contact[m_masses[k]] = onFloor(&ms[m_masses[k]]);
+}
+
+void DomainSolver::integrate(int domain) {
+  PoolVector<Mass> &ms = *m_ms;
+
+  for (int k = m_collectStart[domain]; k < m_collectStart[domain + 1]; ++k) {
+    int h = m_collect[k];
+    ms[m_haloTarget[h]].acc += m_halo[h];
+    m_halo[h] = vec3(0.f);
+  }
+
+  for (int k = m_massStart[domain]; k < m_massStart[domain + 1]; ++k)
+    resolveForces(&ms[m_masses[k]], m_contact[m_masses[k]]);
+}
@@ -0,0 +1,332 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	FrameRecorder.cpp
+ */
+
+#include "FrameRecorder.h"
+
+#include <cctype>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+FrameRecorder::FrameRecorder()
+    : m_width(0), m_height(0), m_recording(false), m_fbo(0), m_colorRB(0),
+      m_depthRB(0), m_resolveFBO(0), m_resolveRB(0), m_next(0), m_pending(0),
+      m_frame(0), m_pipe(NULL), m_head(0), m_queued(0), m_quit(false),
+      m_written(0), m_failed(false) {
+  for (int i = 0; i < RING; ++i) {
+    m_pbo[i] = 0;
+    m_fence[i] = 0;
+    m_frameOf[i] = 0;
+  }
+}
+
+// The GL objects need the context, which may already be gone here; only
+// make sure the writer thread does not outlive the recorder
+FrameRecorder::~FrameRecorder() {
+  if (m_writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_wake.notify_all();
+    m_writer.join();
+  }
+  if (m_pipe)
+    pclose(m_pipe);
+}
+
+bool FrameRecorder::recording() const { return m_recording; }
+int FrameRecorder::width() const { return m_width; }
+int FrameRecorder::height() const { return m_height; }
+int FrameRecorder::framesWritten() const { return m_written; }
+
+bool FrameRecorder::failed() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_failed;
+}
+
+bool FrameRecorder::validPattern(std::string const &pattern) {
+  int conversions = 0;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%')
+      continue;
+    if (++i < pattern.size() && pattern[i] == '%')
+      continue;
+    while (i < pattern.size() && std::strchr("-+ #0", pattern[i]))
+      ++i;
+    while (i < pattern.size() && std::isdigit((unsigned char)pattern[i]))
+      ++i;
+    if (i == pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i'))
+      return false;
+    ++conversions;
+  }
+  return conversions == 1;
+}
+
+bool FrameRecorder::start(int width, int height, int samples,
+                          std::string const &target) {
+  stop();
+
+  if (!target.empty() && target[0] == '|') {
+    // A write to an encoder that has exited then fails with EPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+    m_pattern.clear();
+    m_pipe = popen(target.c_str() + 1, "w");
+    if (!m_pipe) {
+      std::cerr << "FrameRecorder: cannot run " << target.c_str() + 1
+                << std::endl;
+      return false;
+    }
+  } else if (target.find('%') != std::string::npos) {
+    m_pattern = target;
+  } else {
+    m_pattern = target + "/frame_%05d.ppm";
+  }
+  if (!m_pipe && !validPattern(m_pattern)) {
+    std::cerr << "FrameRecorder: " << target
+              << " needs exactly one integer conversion such as %05d"
+              << std::endl;
+    return false;
+  }
+
+  m_width = width;
+  m_height = height;
+
+  glGenFramebuffers(1, &m_fbo);
+  glGenRenderbuffers(1, &m_colorRB);
+  glGenRenderbuffers(1, &m_depthRB);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_colorRB);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width,
+                                   height);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depthRB);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples,
+                                   GL_DEPTH_COMPONENT24, width, height);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, m_colorRB);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, m_depthRB);
+  bool complete =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+  glGenFramebuffers(1, &m_resolveFBO);
+  glGenRenderbuffers(1, &m_resolveRB);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_resolveRB);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_resolveFBO);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, m_resolveRB);
+  complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+                             GL_FRAMEBUFFER_COMPLETE;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenBuffers(RING, m_pbo);
+  for (int i = 0; i < RING; ++i) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, 4 * width * height, NULL,
+                 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  m_next = m_pending = m_frame = 0;
+  m_written = 0;
+  m_failed = false;
+  m_head = m_queued = 0;
+  m_quit = false;
+  m_recording = true;
+  m_writer = std::thread(&FrameRecorder::writerLoop, this);
+
+  if (!complete) {
+    std::cerr << "FrameRecorder: offscreen framebuffer incomplete"
+              << std::endl;
+    stop();
+    return false;
+  }
+  return true;
+}
+
+void FrameRecorder::stop() {
+  if (!m_recording)
+    return;
+
+  while (m_pending > 0)
+    collect(true);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  m_writer.join();
+
+  if (m_pipe) {
+    pclose(m_pipe);
+    m_pipe = NULL;
+  }
+
+  glDeleteBuffers(RING, m_pbo);
+  glDeleteRenderbuffers(1, &m_colorRB);
+  glDeleteRenderbuffers(1, &m_depthRB);
+  glDeleteRenderbuffers(1, &m_resolveRB);
+  glDeleteFramebuffers(1, &m_fbo);
+  glDeleteFramebuffers(1, &m_resolveFBO);
+  m_recording = false;
+}
+
+void FrameRecorder::beginFrame() {
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glViewport(0, 0, m_width, m_height);
+}
+
+void FrameRecorder::endFrame() {
+  // Resolve the samples
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFBO);
+  glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+  // Every slot still in flight: the oldest has to be finished first
+  if (m_pending == RING)
+    collect(true);
+
+  // Queue the copy into the next pixel buffer; this does not wait
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolveFBO);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[m_next]);
+  glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE,
+               (void *)0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  m_fence[m_next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_frameOf[m_next] = m_frame++;
+  m_next = (m_next + 1) % RING;
+  ++m_pending;
+
+  collect(false);
+}
+
+// Hand finished readbacks, oldest first, to the writer. With `wait` the
+// oldest one is waited for.
+void FrameRecorder::collect(bool wait) {
+  GLsizeiptr bytes = 4 * m_width * m_height;
+
+  while (m_pending > 0) {
+    int slot = (m_next - m_pending + RING) % RING;
+
+    GLenum status;
+    do {
+      status = glClientWaitSync(m_fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+                                wait ? 1000000 : 0);
+    } while (wait && status == GL_TIMEOUT_EXPIRED);
+    if (status == GL_TIMEOUT_EXPIRED)
+      break;
+    wait = false;
+
+    glDeleteSync(m_fence[slot]);
+    if (status == GL_WAIT_FAILED) {
+      std::cerr << "FrameRecorder: fence failed, dropping frame "
+                << m_frameOf[slot] << std::endl;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_failed = true;
+      --m_pending;
+      continue;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[slot]);
+    void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes,
+                                    GL_MAP_READ_BIT);
+    if (pixels) {
+      enqueue(pixels, m_frameOf[slot]);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    --m_pending;
+  }
+}
+
+void FrameRecorder::enqueue(void const *pixels, int index) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_wake.wait(lock, [this] { return m_queued < MAX_QUEUED; });
+  Image &image = m_queue[(m_head + m_queued) % MAX_QUEUED];
+  lock.unlock();
+
+  // The writer does not touch the slot until it is counted
+  image.index = index;
+  image.rgba.resize(4 * m_width * m_height);
+  std::memcpy(image.rgba.data(), pixels, image.rgba.size());
+
+  lock.lock();
+  ++m_queued;
+  m_wake.notify_all();
+}
+
+void FrameRecorder::writerLoop() {
+  bool failed = false;
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;) {
+    m_wake.wait(lock, [this] { return m_quit || m_queued > 0; });
+    if (m_queued == 0)
+      break;
+
+    Image const &image = m_queue[m_head];
+    lock.unlock();
+
+    if (!failed && !writeImage(image)) {
+      std::cerr << "FrameRecorder: write failed at frame " << image.index
+                << std::endl;
+      failed = true;
+    }
+
+    lock.lock();
+    if (failed)
+      m_failed = true;
+    else
+      ++m_written;
+    m_head = (m_head + 1) % MAX_QUEUED;
+    --m_queued;
+    m_wake.notify_all();
+  }
+}
+
+// Binary PPM, rows flipped to top-down
+bool FrameRecorder::writeImage(Image const &image) {
+  FILE *out = m_pipe;
+  if (!out) {
+    char name[1024];
+    int n = std::snprintf(name, sizeof(name), m_pattern.c_str(), image.index);
+    if (n < 0 || n >= int(sizeof(name)))
+      return false;
+    out = std::fopen(name, "wb");
+    if (!out)
+      return false;
+  }
+
+  bool ok = std::fprintf(out, "P6\n%d %d\n255\n", m_width, m_height) > 0;
+  m_row.resize(3 * m_width);
+  for (int y = m_height - 1; ok && y >= 0; --y) {
+    uint8_t const *src = &image.rgba[4 * m_width * y];
+    for (int x = 0; x < m_width; ++x) {
+      m_row[3 * x] = src[4 * x];
+      m_row[3 * x + 1] = src[4 * x + 1];
+      m_row[3 * x + 2] = src[4 * x + 2];
+    }
+    ok = std::fwrite(m_row.data(), 1, m_row.size(), out) == m_row.size();
+  }
+
+  if (out != m_pipe)
+    ok = std::fclose(out) == 0 && ok;
+  return ok;
+}
+
+void FrameRecorder::blitToScreen(int width, int height) const {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolveFBO);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, width, height,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
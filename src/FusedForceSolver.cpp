@@ -0,0 +1,68 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	FusedForceSolver.cpp
+ */
+
+#include "FusedForceSolver.h"
+
+#include "SimdKernels.h"
+
+using namespace glm;
+
+namespace {
+// Masses per task in the integrate-and-pack pass
+const int MASS_GRAIN = 1024;
+
+// Half size of the quad drawn at each mass (packFrame)
+const float QUAD = 0.05f;
+} // namespace
+
+void FusedForceSolver::rebuild(PoolVector<Mass> const &ms,
+                               PoolVector<Spring> const &ss) {
+  int nm = ms.size();
+  int ns = ss.size();
+
+  m_slotStart.assign(nm + 1, 0);
+  for (Spring const &s : ss) {
+    ++m_slotStart[s.a - ms.data() + 1];
+    ++m_slotStart[s.b - ms.data() + 1];
+  }
+  for (int i = 0; i < nm; ++i)
+    m_slotStart[i + 1] += m_slotStart[i];
+
+  m_slots.resize(2 * ns);
+  m_fill.assign(m_slotStart.begin(), m_slotStart.end() - 1);
+  for (int s = 0; s < ns; ++s) {
+    m_slots[m_fill[ss[s].a - ms.data()]++] = 2 * s;
+    m_slots[m_fill[ss[s].b - ms.data()]++] = 2 * s + 1;
+  }
+}
+
+void FusedForceSolver::step(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                            SpringColouring const &colouring, float *lines,
+                            float *quads, ThreadPool &pool) {
+  int nm = ms.size();
+
+  colouring.applyForces(ss, pool);
+
+  // Every mass writes only its own vertices, so masses run in parallel.
+  // Each chunk is still in cache from the integration when it is packed.
+  SimdKernels::Table const &simd = SimdKernels::get();
+  char *contacts = stepArena.allocate<char>(nm);
+  pool.parallelFor(0, nm, MASS_GRAIN, [&](int begin, int end) {
+    floorContacts(&ms[begin], end - begin, contacts + begin);
+    integrateMasses(&ms[begin], contacts + begin, end - begin);
+    simd.packQuads(&ms[begin], end - begin, QUAD, quads + 18 * begin);
+
+    for (int i = begin; i < end; ++i) {
+      vec3 p = ms[i].position;
+      for (int k = m_slotStart[i]; k < m_slotStart[i + 1]; ++k) {
+        float *v = lines + 3 * m_slots[k];
+        v[0] = p.x;
+        v[1] = p.y;
+        v[2] = p.z;
+      }
+    }
+  });
+}
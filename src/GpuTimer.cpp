@@ -0,0 +1,67 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	GpuTimer.cpp
+ */
+
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() : m_numPasses(0), m_frame(0) {}
+
+void GpuTimer::create(int numPasses) {
+  m_numPasses = numPasses;
+  m_frame = 0;
+  m_queries.assign(RING * numPasses, 0);
+  m_issued.assign(RING * numPasses, 0);
+  m_ms.assign(numPasses, -1.f);
+  glGenQueries(m_queries.size(), m_queries.data());
+}
+
+void GpuTimer::destroy() {
+  if (!m_queries.empty())
+    glDeleteQueries(m_queries.size(), m_queries.data());
+  m_queries.clear();
+  m_issued.clear();
+}
+
+GLuint &GpuTimer::query(int slot, int pass) {
+  return m_queries[slot * m_numPasses + pass];
+}
+
+void GpuTimer::beginFrame() {
+  ++m_frame;
+
+  // Oldest frame first, so the newest available result wins
+  for (int age = RING - 1; age >= 0; --age) {
+    if (m_frame < age)
+      continue;
+    int slot = (m_frame - age) % RING;
+    for (int pass = 0; pass < m_numPasses; ++pass) {
+      char &issued = m_issued[slot * m_numPasses + pass];
+      if (!issued)
+        continue;
+
+      GLint available = 0;
+      glGetQueryObjectiv(query(slot, pass), GL_QUERY_RESULT_AVAILABLE,
+                         &available);
+      if (available) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query(slot, pass), GL_QUERY_RESULT, &ns);
+        m_ms[pass] = ns * 1e-6f;
+        issued = 0;
+      } else if (age == 0) {
+        issued = 0; // about to be reused
+      }
+    }
+  }
+}
+
+void GpuTimer::begin(int pass) {
+  int slot = m_frame % RING;
+  glBeginQuery(GL_TIME_ELAPSED, query(slot, pass));
+  m_issued[slot * m_numPasses + pass] = 1;
+}
+
+void GpuTimer::end() { glEndQuery(GL_TIME_ELAPSED); }
+
+float GpuTimer::milliseconds(int pass) const { return m_ms[pass]; }
@@ -0,0 +1,336 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	GraphPartitioner.cpp
+ *
+ * Reference: Karypis and Kumar, "A Fast and High Quality Multilevel
+ * Scheme for Partitioning Irregular Graphs", 1998.
+ */
+
+#include "GraphPartitioner.h"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <random>
+
+namespace {
+typedef GraphPartitioner::Graph Graph;
+
+// Collapse g onto nc vertices through map, merging parallel edges and
+// dropping the ones that become self loops
+Graph contract(Graph const &g, std::vector<int> const &map, int nc) {
+  int n = g.size();
+
+  // Fine vertices grouped by coarse vertex
+  std::vector<int> memberStart(nc + 1, 0), members(n);
+  for (int v = 0; v < n; ++v)
+    ++memberStart[map[v] + 1];
+  for (int c = 0; c < nc; ++c)
+    memberStart[c + 1] += memberStart[c];
+  std::vector<int> fill(memberStart.begin(), memberStart.end() - 1);
+  for (int v = 0; v < n; ++v)
+    members[fill[map[v]]++] = v;
+
+  Graph c;
+  c.start.assign(nc + 1, 0);
+  c.vertexWeight.assign(nc, 0);
+  c.adj.reserve(g.adj.size());
+  c.edgeWeight.reserve(g.adj.size());
+
+  // slot[u] = where edge (cv, u) went, if it is at or after start[cv]
+  std::vector<int> slot(nc, -1);
+
+  for (int cv = 0; cv < nc; ++cv) {
+    int begin = c.adj.size();
+    c.start[cv] = begin;
+
+    for (int m = memberStart[cv]; m < memberStart[cv + 1]; ++m) {
+      int v = members[m];
+      c.vertexWeight[cv] += g.vertexWeight[v];
+
+      for (int e = g.start[v]; e < g.start[v + 1]; ++e) {
+        int u = map[g.adj[e]];
+        if (u == cv)
+          continue;
+        if (slot[u] < begin) {
+          slot[u] = c.adj.size();
+          c.adj.push_back(u);
+          c.edgeWeight.push_back(g.edgeWeight[e]);
+        } else {
+          c.edgeWeight[slot[u]] += g.edgeWeight[e];
+        }
+      }
+    }
+  }
+  c.start[nc] = c.adj.size();
+  return c;
+}
+
+int totalWeight(Graph const &g) {
+  int w = 0;
+  for (int vw : g.vertexWeight)
+    w += vw;
+  return w;
+}
+} // namespace
+
+GraphPartitioner::GraphPartitioner() : m_imbalance(0.03f), m_seed(587) {}
+
+void GraphPartitioner::setImbalance(float tolerance) {
+  m_imbalance = std::max(tolerance, 0.f);
+}
+
+int GraphPartitioner::edgeCut(PoolVector<Mass> const &ms,
+                              PoolVector<Spring> const &ss,
+                              std::vector<int> const &part) {
+  int cut = 0;
+  for (Spring const &s : ss)
+    cut += part[s.a - ms.data()] != part[s.b - ms.data()];
+  return cut;
+}
+
+std::vector<int> GraphPartitioner::partition(PoolVector<Mass> const &ms,
+                                             PoolVector<Spring> const &ss,
+                                             int numParts) {
+  int n = ms.size();
+  std::vector<int> part(n, 0);
+  if (numParts <= 1 || n == 0)
+    return part;
+  if (n <= numParts) {
+    for (int i = 0; i < n; ++i)
+      part[i] = i;
+    return part;
+  }
+
+  // One vertex per mass, one unit-weight edge per spring
+  Graph raw;
+  raw.start.assign(n + 1, 0);
+  raw.vertexWeight.assign(n, 1);
+  for (Spring const &s : ss) {
+    ++raw.start[s.a - ms.data() + 1];
+    ++raw.start[s.b - ms.data() + 1];
+  }
+  for (int i = 0; i < n; ++i)
+    raw.start[i + 1] += raw.start[i];
+  raw.adj.resize(raw.start[n]);
+  raw.edgeWeight.assign(raw.start[n], 1);
+  std::vector<int> fill(raw.start.begin(), raw.start.end() - 1);
+  for (Spring const &s : ss) {
+    int a = s.a - ms.data(), b = s.b - ms.data();
+    raw.adj[fill[a]++] = b;
+    raw.adj[fill[b]++] = a;
+  }
+
+  std::vector<int> identity(n);
+  for (int i = 0; i < n; ++i)
+    identity[i] = i;
+
+  std::vector<Graph> levels;
+  std::vector<std::vector<int>> maps;
+  levels.push_back(contract(raw, identity, n));
+
+  // Coarsen until the graph is a small multiple of the part count. Capping
+  // the coarse vertex weight keeps the coarsest graph balanceable.
+  int coarsest = std::max(20 * numParts, 64);
+  int maxWeight = std::max(1, (3 * n) / (2 * coarsest));
+  while (levels.back().size() > coarsest) {
+    std::vector<int> map;
+    Graph c = coarsen(levels.back(), maxWeight, map);
+    if (c.size() > levels.back().size() * 95 / 100)
+      break; // matching has stalled
+    maps.push_back(map);
+    levels.push_back(c);
+  }
+
+  std::vector<int> coarsePart;
+  growRegions(levels.back(), numParts, coarsePart);
+  refine(levels.back(), numParts, coarsePart);
+
+  // Project back up, refining the boundary at every level
+  for (int l = int(maps.size()) - 1; l >= 0; --l) {
+    std::vector<int> finePart(levels[l].size());
+    for (int v = 0; v < levels[l].size(); ++v)
+      finePart[v] = coarsePart[maps[l][v]];
+    refine(levels[l], numParts, finePart);
+    coarsePart.swap(finePart);
+  }
+
+  return coarsePart;
+}
+
+// Heavy-edge matching: visit vertices in random order and pair each
+// unmatched one with the unmatched neighbour it shares the most weight with
+Graph GraphPartitioner::coarsen(Graph const &g, int maxWeight,
+                                std::vector<int> &toCoarse) {
+  int n = g.size();
+  std::vector<int> order(n);
+  for (int v = 0; v < n; ++v)
+    order[v] = v;
+  std::mt19937 rng(m_seed++);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  std::vector<int> match(n, -1);
+  for (int v : order) {
+    if (match[v] >= 0)
+      continue;
+
+    int best = v, bestWeight = 0;
+    for (int e = g.start[v]; e < g.start[v + 1]; ++e) {
+      int u = g.adj[e];
+      if (match[u] >= 0 ||
+          g.vertexWeight[u] + g.vertexWeight[v] > maxWeight)
+        continue;
+      if (g.edgeWeight[e] > bestWeight) {
+        best = u;
+        bestWeight = g.edgeWeight[e];
+      }
+    }
+    match[v] = best;
+    match[best] = v;
+  }
+
+  int nc = 0;
+  toCoarse.assign(n, -1);
+  for (int v = 0; v < n; ++v) {
+    if (toCoarse[v] < 0)
+      toCoarse[v] = toCoarse[match[v]] = nc++;
+  }
+
+  return contract(g, toCoarse, nc);
+}
+
+// Grow the parts one after another. Each part starts next to the parts
+// already grown and then absorbs the frontier vertex most connected to it
+// until it holds its share of the weight.
+void GraphPartitioner::growRegions(Graph const &g, int numParts,
+                                   std::vector<int> &part) {
+  int n = g.size();
+  part.assign(n, -1);
+
+  // Edge weight from each vertex to finished parts / the current part
+  std::vector<int> touch(n, 0), conn(n, 0);
+  int total = totalWeight(g);
+  int assigned = 0;
+
+  for (int p = 0; p < numParts - 1; ++p) {
+    long long target = (long long)total * (p + 1) / numParts;
+    std::priority_queue<std::pair<int, int>> frontier;
+    std::fill(conn.begin(), conn.end(), 0);
+
+    while (assigned < target) {
+      int v = -1;
+      while (!frontier.empty() && v < 0) {
+        std::pair<int, int> top = frontier.top();
+        frontier.pop();
+        if (part[top.second] < 0 && top.first == conn[top.second])
+          v = top.second;
+      }
+
+      // New seed (first part, or the region ran into a dead end)
+      if (v < 0) {
+        int bestTouch = -1;
+        for (int u = 0; u < n; ++u) {
+          if (part[u] < 0 && touch[u] > bestTouch) {
+            v = u;
+            bestTouch = touch[u];
+          }
+        }
+        if (v < 0)
+          break;
+      }
+
+      part[v] = p;
+      assigned += g.vertexWeight[v];
+      for (int e = g.start[v]; e < g.start[v + 1]; ++e) {
+        int u = g.adj[e];
+        if (part[u] >= 0)
+          continue;
+        conn[u] += g.edgeWeight[e];
+        frontier.push(std::make_pair(conn[u], u));
+      }
+    }
+
+    for (int v = 0; v < n; ++v) {
+      if (part[v] != p)
+        continue;
+      for (int e = g.start[v]; e < g.start[v + 1]; ++e)
+        touch[g.adj[e]] += g.edgeWeight[e];
+    }
+  }
+
+  for (int v = 0; v < n; ++v) {
+    if (part[v] < 0)
+      part[v] = numParts - 1;
+  }
+}
+
+// Greedy boundary refinement: move a vertex to the neighbouring part it is
+// most connected to when that lowers the cut, or keeps it and improves the
+// balance, without pushing the target part over the weight limit
+void GraphPartitioner::refine(Graph const &g, int numParts,
+                              std::vector<int> &part) {
+  int n = g.size();
+  int total = totalWeight(g);
+  int heaviest = *std::max_element(g.vertexWeight.begin(),
+                                   g.vertexWeight.end());
+  int limit = std::max(int(total * (1.f + m_imbalance) / numParts),
+                       total / numParts + heaviest);
+
+  std::vector<int> weight(numParts, 0);
+  for (int v = 0; v < n; ++v)
+    weight[part[v]] += g.vertexWeight[v];
+
+  std::vector<int> conn(numParts, 0);
+  std::vector<int> touched;
+
+  for (int pass = 0; pass < 8; ++pass) {
+    int moved = 0;
+
+    for (int v = 0; v < n; ++v) {
+      int own = part[v];
+      int vw = g.vertexWeight[v];
+      if (weight[own] == vw)
+        continue; // never empty a part
+
+      touched.clear();
+      for (int e = g.start[v]; e < g.start[v + 1]; ++e) {
+        int q = part[g.adj[e]];
+        if (conn[q] == 0)
+          touched.push_back(q);
+        conn[q] += g.edgeWeight[e];
+      }
+
+      int internal = conn[own];
+      bool overweight = weight[own] > limit;
+      int best = own;
+      int bestGain = overweight ? std::numeric_limits<int>::min() : 0;
+
+      for (int q : touched) {
+        if (q == own || weight[q] + vw > limit)
+          continue;
+        int gain = conn[q] - internal;
+        bool lighter = weight[q] + vw < weight[own];
+        if (gain > bestGain ||
+            (gain == bestGain && (lighter || overweight) &&
+             (best == own || weight[q] < weight[best]))) {
+          best = q;
+          bestGain = gain;
+        }
+      }
+
+      for (int q : touched)
+        conn[q] = 0;
+
+      if (best != own) {
+        part[v] = best;
+        weight[own] -= vw;
+        weight[best] += vw;
+        ++moved;
+      }
+    }
+
+    if (moved == 0)
+      break;
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	HeadlessContext.cpp
+ */
+
+#include "HeadlessContext.h"
+
+#include <iostream>
+
+#ifdef A3_HEADLESS
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace {
+EGLDisplay s_display = EGL_NO_DISPLAY;
+EGLContext s_context = EGL_NO_CONTEXT;
+EGLSurface s_surface = EGL_NO_SURFACE;
+} // namespace
+
+bool createHeadlessContext() {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay)
+    s_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, NULL);
+  if (s_display == EGL_NO_DISPLAY)
+    s_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  EGLint major, minor;
+  if (s_display == EGL_NO_DISPLAY ||
+      !eglInitialize(s_display, &major, &minor)) {
+    std::cerr << "Headless: no EGL display" << std::endl;
+    return false;
+  }
+  eglBindAPI(EGL_OPENGL_API);
+
+  // Surfaceless platforms may offer no pbuffer configs
+  EGLint pbufferConfig[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLint anyConfig[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint count = 0;
+  bool pbuffer = eglChooseConfig(s_display, pbufferConfig, &config, 1,
+                                 &count) && count > 0;
+  if (!pbuffer &&
+      (!eglChooseConfig(s_display, anyConfig, &config, 1, &count) ||
+       count == 0)) {
+    std::cerr << "Headless: no EGL config for desktop GL" << std::endl;
+    return false;
+  }
+
+  EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                             3,
+                             EGL_CONTEXT_MINOR_VERSION,
+                             3,
+                             EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                             EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                             EGL_NONE};
+  s_context =
+      eglCreateContext(s_display, config, EGL_NO_CONTEXT, contextAttribs);
+  if (s_context == EGL_NO_CONTEXT) {
+    std::cerr << "Headless: cannot create a GL 3.3 core context"
+              << std::endl;
+    return false;
+  }
+
+  // Nothing is drawn to the surface, so 1x1 (or none) is enough
+  if (pbuffer) {
+    EGLint size[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    s_surface = eglCreatePbufferSurface(s_display, config, size);
+  }
+  if (!eglMakeCurrent(s_display, s_surface, s_surface, s_context)) {
+    std::cerr << "Headless: cannot make the context current" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void destroyHeadlessContext() {
+  if (s_display == EGL_NO_DISPLAY)
+    return;
+  eglMakeCurrent(s_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (s_surface != EGL_NO_SURFACE)
+    eglDestroySurface(s_display, s_surface);
+  if (s_context != EGL_NO_CONTEXT)
+    eglDestroyContext(s_display, s_context);
+  eglTerminate(s_display);
+  s_display = EGL_NO_DISPLAY;
+}
+
+void *headlessProcAddress(char const *name) {
+  return (void *)eglGetProcAddress(name);
+}
+
+#else
+
+bool createHeadlessContext() {
+  std::cerr << "Headless mode needs a build with -DA3_HEADLESS "
+               "(make clean && make HEADLESS=1)"
+            << std::endl;
+  return false;
+}
+
+void destroyHeadlessContext() {}
+
+void *headlessProcAddress(char const *) { return 0; }
+
+#endif // A3_HEADLESS
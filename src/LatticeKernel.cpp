@@ -0,0 +1,191 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	LatticeKernel.cpp
+ */
+
+#include "LatticeKernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MassSpringSystem.h"
+#include "SimdKernels.h"
+
+using namespace glm;
+
+namespace {
+// Empty the array and hand its storage back to the buffer pool
+void release(PoolVector<float> &a) { PoolVector<float>().swap(a); }
+} // namespace
+
+LatticeKernel::LatticeKernel()
+    : m_nx(0), m_ny(0), m_nz(0), m_stiffness(0.f), m_floor(false),
+      m_floorY(0.f), m_mass(1.f) {}
+
+int LatticeKernel::size() const { return m_nx * m_ny * m_nz; }
+
+int LatticeKernel::index(int x, int y, int z) const {
+  return x + m_nx * (y + m_ny * z);
+}
+
+vec3 LatticeKernel::position(int i) const {
+  return vec3(m_px[i], m_py[i], m_pz[i]);
+}
+
+void LatticeKernel::clear() {
+  m_nx = m_ny = m_nz = 0;
+  m_stencil.clear();
+  release(m_restLength);
+  release(m_px), release(m_py), release(m_pz);
+  release(m_vx), release(m_vy), release(m_vz);
+  release(m_fx), release(m_fy), release(m_fz);
+  release(m_invMass);
+}
+
+void LatticeKernel::init(int nx, int ny, int nz, vec3 origin, vec3 ex,
+                         vec3 ey, vec3 ez, std::vector<Offset> const &stencil,
+                         float mass, float stiffness) {
+  m_nx = nx;
+  m_ny = ny;
+  m_nz = nz;
+  m_mass = mass;
+  m_stiffness = stiffness;
+  m_floor = false;
+  m_stencil = stencil;
+
+  m_restLength.clear();
+  for (Offset const &o : m_stencil)
+    m_restLength.push_back(length(float(o.dx) * ex + float(o.dy) * ey +
+                                  float(o.dz) * ez));
+
+  int n = size();
+  m_px.resize(n), m_py.resize(n), m_pz.resize(n);
+  m_vx.assign(n, 0.f), m_vy.assign(n, 0.f), m_vz.assign(n, 0.f);
+  m_fx.assign(n, 0.f), m_fy.assign(n, 0.f), m_fz.assign(n, 0.f);
+  m_invMass.assign(n, 1.f / mass);
+
+  for (int z = 0; z < nz; ++z) {
+    for (int y = 0; y < ny; ++y) {
+      for (int x = 0; x < nx; ++x) {
+        vec3 p = origin + float(x) * ex + float(y) * ey + float(z) * ez;
+        int i = index(x, y, z);
+        m_px[i] = p.x;
+        m_py[i] = p.y;
+        m_pz[i] = p.z;
+      }
+    }
+  }
+}
+
+void LatticeKernel::setFixed(int x, int y, int z, bool fixed) {
+  m_invMass[index(x, y, z)] = fixed ? 0.f : 1.f / m_mass;
+}
+
+void LatticeKernel::setFloor(bool on, float floorY) {
+  m_floor = on;
+  m_floorY = floorY;
+}
+
+int LatticeKernel::numSprings() const {
+  int count = 0;
+  for (Offset const &o : m_stencil) {
+    count += std::max(m_nx - std::abs(o.dx), 0) *
+             std::max(m_ny - std::abs(o.dy), 0) *
+             std::max(m_nz - std::abs(o.dz), 0);
+  }
+  return count;
+}
+
+void LatticeKernel::accumulateRow(int y, int z) {
+  int base = index(0, y, z);
+  float k = m_stiffness;
+  SimdKernels::Table const &simd = SimdKernels::get();
+
+  float const *px = m_px.data();
+  float const *py = m_py.data();
+  float const *pz = m_pz.data();
+  float *fx = m_fx.data() + base;
+  float *fy = m_fy.data() + base;
+  float *fz = m_fz.data() + base;
+
+  std::fill(fx, fx + m_nx, 0.f);
+  std::fill(fy, fy + m_nx, 0.f);
+  std::fill(fz, fz + m_nx, 0.f);
+
+  for (int s = 0; s < int(m_stencil.size()); ++s) {
+    for (int sign = 1; sign >= -1; sign -= 2) {
+      int ox = sign * m_stencil[s].dx;
+      int oy = sign * m_stencil[s].dy;
+      int oz = sign * m_stencil[s].dz;
+
+      if (y + oy < 0 || y + oy >= m_ny || z + oz < 0 || z + oz >= m_nz)
+        continue;
+
+      int x0 = std::max(0, -ox);
+      int x1 = std::min(m_nx, m_nx - ox);
+      int off = ox + m_nx * (oy + m_ny * oz);
+      simd.gatherRow(px + base, py + base, pz + base, off, fx, fy, fz, x0,
+                     x1, k, m_restLength[s]);
+    }
+  }
+}
+
+void LatticeKernel::step(float dt, ThreadPool &pool) {
+  int rows = m_ny * m_nz;
+  int rowGrain = std::max(1, 2048 / std::max(m_nx, 1));
+
+  pool.parallelFor(0, rows, rowGrain, [&](int begin, int end) {
+    for (int r = begin; r < end; ++r)
+      accumulateRow(r % m_ny, r / m_ny);
+  });
+
+  // Same update as resolveForces
+  float g = -9.81f;
+  float d = damping;
+  float mass = m_mass;
+  float floorY = m_floor ? m_floorY : -1e30f;
+  SimdKernels::Table const &simd = SimdKernels::get();
+
+  pool.parallelFor(0, size(), 4096, [&](int begin, int end) {
+    simd.integrateRange(m_px.data(), m_py.data(), m_pz.data(), m_vx.data(),
+                        m_vy.data(), m_vz.data(), m_fx.data(), m_fy.data(),
+                        m_fz.data(), m_invMass.data(), begin, end, mass, g,
+                        d, floorY, dt);
+  });
+}
+
+void LatticeKernel::packLines(std::vector<Vec3f> &out) const {
+  out.resize(2 * numSprings());
+  float *v = reinterpret_cast<float *>(out.data());
+  SimdKernels::Table const &simd = SimdKernels::get();
+
+  for (Offset const &o : m_stencil) {
+    int x0 = std::max(0, -o.dx), x1 = std::min(m_nx, m_nx - o.dx);
+    int y0 = std::max(0, -o.dy), y1 = std::min(m_ny, m_ny - o.dy);
+    int z0 = std::max(0, -o.dz), z1 = std::min(m_nz, m_nz - o.dz);
+    int off = o.dx + m_nx * (o.dy + m_ny * o.dz);
+
+    for (int z = z0; z < z1; ++z) {
+      for (int y = y0; y < y1; ++y) {
+        int base = index(0, y, z);
+        simd.packLatticeRow(&m_px[base], &m_py[base], &m_pz[base], off, x0,
+                            x1, v);
+        v += 6 * (x1 - x0);
+      }
+    }
+  }
+}
+
+void LatticeKernel::packRestLengths(std::vector<float> &out) const {
+  out.clear();
+  out.reserve(2 * numSprings());
+
+  for (std::size_t k = 0; k < m_stencil.size(); ++k) {
+    Offset const &o = m_stencil[k];
+    int count = std::max(m_nx - std::abs(o.dx), 0) *
+                std::max(m_ny - std::abs(o.dy), 0) *
+                std::max(m_nz - std::abs(o.dz), 0);
+    out.insert(out.end(), 2 * count, m_restLength[k]);
+  }
+}
@@ -0,0 +1,695 @@
+/**
+ * Author: 	Shannon TJ
+ * Date:		March 23, 2017
+ * Course:		CPSC 587 Computer Animation
+ *
+ * File:		MassSpringSystem.cpp
+ *
+ * Scene setup and force-based integration for the mass-spring
+ * simulations.
+ */
+
+#include "MassSpringSystem.h"
+
+#include <cmath>
+#include <limits>
+
+#include "SimdKernels.h"
+
+using namespace std;
+using namespace glm;
+
+int numMass = 2;
+int numSpring = 1;
+
+float damping = 0.8f;
+float timestep = 0.01f;
+
+bool sim3;
+
+ivec3 massGrid(0);
+
+StrandBatch strands;
+LatticeKernel lattice;
+
+PoolVector<Mass> masses;
+PoolVector<Spring> springs;
+
+Arena stepArena;
+
+//Masses and Spring for sim1
+Mass m;
+Spring s;
+
+//Masses and Springs for sim2
+Mass mChain;
+Spring sChain;
+
+//Masses and springs for sim3
+Mass mCube;
+Spring sCube;
+
+//Masses and springs for sim4
+Mass mCloth;
+Spring sCloth;
+
+//Masses and springs for sim5
+Mass mRope;
+Spring sRope;
+
+//Get length between masses
+float getLength(Mass *a, Mass *b)
+{
+	float length1 = ((b->position.x)-(a->position.x))*((b->position.x)-(a->position.x));
+	float length2 = ((b->position.y)-(a->position.y))*((b->position.y)-(a->position.y));
+	float length3 = ((b->position.z)-(a->position.z))*((b->position.z)-(a->position.z));	
+	float springLength = sqrt(length1 + length2 + length3);
+	
+	return springLength;
+}
+
+//Empty every scene representation before building a new one. The
+//mass and spring arrays go back to the buffer pool, so a smaller scene
+//does not keep the storage of a bigger one.
+void clearScene()
+{
+	PoolVector<Mass>().swap(masses);
+	PoolVector<Spring>().swap(springs);
+	strands.clear();
+	lattice.clear();
+	massGrid = ivec3(0);
+}
+
+//Initialize masses
+Mass initMass(Mass ms, float weight, bool fix, vec3 pos)
+{
+	ms.mass = weight;
+	ms.fixedPoint = fix;
+	ms.position = pos;
+	ms.velocity = vec3(0,0,0);
+	ms.acc = vec3(0,0,0);
+	
+	return ms;
+} 
+
+//Initialize springs
+Spring initSpring(Spring ss, Mass *a, Mass *b, float k, float rLen)
+{
+	ss.a = a;
+	ss.b = b;
+	ss.stiffness = k;
+	ss.restLength = rLen;
+	
+	return ss;
+}
+
+//Single spring
+void initSim1()
+{
+	clearScene();
+	
+	m = initMass(m, 1.f, true, vec3(0,3.5f,0));
+	masses.push_back(m);
+	masses[0] = m;
+	
+	m = initMass(m, 1.f, false, vec3(2.f,2.f,0));	
+	masses.push_back(m);
+	masses[1] = m;
+	
+	s = initSpring(s, &masses[0], &masses[1], 25.f, 1.f);	
+	springs.push_back(s);
+	springs[0] = s;
+
+	numMass = masses.size();
+	numSpring = springs.size();
+	sim3 = false;
+}
+
+//Chain pendulum
+void initSim2()
+{
+	clearScene();
+	
+	mChain = initMass(mChain, 1.f, true, vec3(0,3.5f,0));	
+	masses.push_back(mChain);
+	masses[0] = mChain;
+	
+	mChain = initMass(mChain, 0.5f, false, vec3(0,3.f,0));		
+	masses.push_back(mChain);
+	masses[1] = mChain;
+	
+	mChain = initMass(mChain, 0.5f, false, vec3(0.5f,3.5f,0));	
+	masses.push_back(mChain);		
+	masses[2] = mChain;
+	
+	mChain = initMass(mChain, 1.5f, false, vec3(1.f,3.5f,0));	
+	masses.push_back(mChain);		
+	masses[3] = mChain;
+
+	sChain = initSpring(sChain, &masses[0], &masses[1], 25.f, 1.f);	
+	springs.push_back(sChain);	
+	springs[0] = sChain;
+	
+	sChain = initSpring(sChain, &masses[1], &masses[2], 25.f, 1.f);	
+	springs.push_back(sChain);		
+    springs[1] = sChain;
+	
+	sChain = initSpring(sChain, &masses[2], &masses[3], 25.f, 1.f);	
+	springs.push_back(sChain);		
+	springs[2] = sChain;
+	
+	numMass = masses.size();
+	numSpring = springs.size();
+	sim3 = false;
+}
+
+//Jello cube
+void initSim3()
+{
+	clearScene();
+	
+	int count = 1;
+	int count2 = 1;
+	
+	//Size of cube
+	int numCube = 5;
+	numMass = numCube*numCube*numCube;
+	
+	//Mass coordinates
+	float originalX = -2.f;
+	float x = originalX;
+	float originalY = 5.5f;
+	float y = originalY;
+	float z = 0;
+	
+	//Size of gap between masses
+	float space = 1.f;
+	
+	//Spring stiffness + restlength
+	float k = 1000;
+	float rLen = 0;
+		
+	//Initialize the masses
+	for(int i = 0; i < numMass; i++)
+	{		
+		mCube = initMass(mCube, 1.f, false, vec3(x,y,z));
+		masses.push_back(mCube);
+		masses[i] = mCube;
+		x += space;
+		
+		//Initialize mass positions
+		if(i == (count*numCube - 1))
+		{
+			if(i/(numCube*numCube*count2 - 1) == 1)
+			{
+				//Move to a new row (Z axis)
+				x = originalX;
+				y = originalY;
+				z = z - space;
+				
+				count2++;
+				count++;					
+			}
+			//Move to a new row (Y axis)
+			else
+			{
+				x = originalX;
+				y = y - space;
+				
+				count++;
+			}
+		}
+	}	
+	
+	//Initialize the springs
+	int m = 0;
+	for(int i = 0; i < numMass; i++)
+	{
+		for(int j = 0; j < numMass; j++)
+		{
+			rLen = getLength(&masses[i], &masses[j]);
+			
+			//X axis
+			if(masses[i].position.x - masses[j].position.x == space && masses[i].position.y == masses[j].position.y)
+			{
+				if(masses[i].position.z == masses[j].position.z)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;
+				}
+			}
+						
+			//Y axis
+			if(masses[i].position.y - masses[j].position.y == space && masses[i].position.z == masses[j].position.z)
+			{
+				if(masses[i].position.x == masses[j].position.x)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;
+				}
+			}	
+			
+			//Z axis
+			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.y == masses[j].position.y)
+			{
+				if(masses[i].position.x == masses[j].position.x)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;	
+				}
+			}
+			
+			//Side crosses
+			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.y - masses[j].position.y == space)
+			{
+				if(masses[i].position.x == masses[j].position.x)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;		
+				}
+			}			
+			
+			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.y - masses[j].position.y == -space)
+			{
+				if(masses[i].position.x == masses[j].position.x)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;	
+				}
+			}		
+		
+			//Horizontal crosses
+			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.x - masses[j].position.x == space)
+			{
+				if(masses[i].position.y == masses[j].position.y)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;	
+				}
+			}			
+			
+			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.x - masses[j].position.x == -space)
+			{
+				if(masses[i].position.y == masses[j].position.y)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;	
+				}
+			}			
+			
+			//Front and back crosses
+			if(masses[i].position.x - masses[j].position.x == space && masses[i].position.y - masses[j].position.y == space)
+			{
+				if(masses[i].position.z == masses[j].position.z)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;	
+				}
+			}			
+			
+			if(masses[i].position.x - masses[j].position.x == space && masses[i].position.y - masses[j].position.y == -space)
+			{
+				if(masses[i].position.z == masses[j].position.z)
+				{
+					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCube);	
+					springs[m] = sCube;
+					m++;		
+				}
+			} 				
+		}	
+	}
+	
+	numSpring = springs.size();
+	sim3 = true;
+	massGrid = ivec3(numCube, numCube, numCube);
+}
+
+//Hanging cloth
+void initSim4()
+{
+	clearScene();
+	
+	int count = 1;
+	
+	//Size of cloth
+	int numCloth = 11;
+	int numRows = 7;
+	numMass = numCloth*numRows;
+	
+	//Mass coordinates
+	float originalX = -2.5f;
+	float x = originalX;
+	float y = 3.5f;
+	float z = 0;
+	
+	//Size of gap between masses
+	float xSpace = 0.5f;
+	float zSpace = 1.0f;
+	
+	//Spring stiffness + rest length
+	float k = 200;
+	float rLen = 0;
+	
+	//Initialize the masses
+	for(int i = 0; i < numMass; i++)
+	{	
+		//Initialize fixed points
+		if(i % 2 == 0 && i < numCloth)
+			mCloth = initMass(mCloth, 1.f, true, vec3(x,y,z));
+		//Initialize loose points
+		else
+			mCloth = initMass(mCloth, 1.f, false, vec3(x,y,z));
+		
+		masses.push_back(mCloth);
+		masses[i] = mCloth;	
+		x += xSpace;
+		
+		//Move to a new row (Z axis)
+		if(i == (count*numCloth - 1))
+		{
+			x = originalX;
+			z = z - zSpace;
+			count++;
+		}
+}
+	
+	//Initialize the springs
+	int m = 0;
+	for(int i = 0; i < numMass; i++)
+	{
+		for(int j = 0; j < numMass; j++)
+		{
+			rLen = getLength(&masses[i], &masses[j]);
+			
+			//Vertical lines
+			if(masses[i].position.x == masses[j].position.x && masses[i].position.z - masses[j].position.z == zSpace)
+			{
+					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCloth);	
+					springs[m] = sCloth;
+					m++;
+			}
+			
+			//Horizontal lines
+			if(masses[i].position.z == masses[j].position.z && masses[i].position.x - masses[j].position.x == xSpace)
+			{
+					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);									
+					springs.push_back(sCloth);	
+					springs[m] = sCloth;
+					m++;
+			}
+			
+			//Crossed lines
+			if(masses[i].position.z - masses[j].position.z == zSpace && masses[i].position.x - masses[j].position.x == xSpace)
+			{
+					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCloth);	
+					springs[m] = sCloth;
+					m++;
+			}			
+			
+			if(masses[i].position.z - masses[j].position.z == zSpace && masses[i].position.x - masses[j].position.x == -xSpace)
+			{
+					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);
+					springs.push_back(sCloth);	
+					springs[m] = sCloth;
+					m++;
+			}		
+		}
+	}
+	
+	numSpring = springs.size();
+	sim3 = false;
+	massGrid = ivec3(numCloth, 1, numRows);
+}
+
+//Long rope
+void initSim5()
+{
+	initChain(40);
+}
+
+//Hair: a square patch of short independent strands
+void initSim6()
+{
+	clearScene();
+	
+	numMass = 0;
+	numSpring = 0;
+	
+	//Size of patch (320 x 320 = 102400 strands)
+	int numSide = 320;
+	float space = 0.025f;
+	
+	//Strands start out horizontal and swing down
+	vector<vec3> roots;
+	roots.reserve(numSide*numSide);
+	for(int i = 0; i < numSide*numSide; i++)
+		roots.push_back(vec3(-4.f + (i % numSide)*space, 3.5f, -(i / numSide)*space));
+	
+	strands.init(roots, vec3(1,0,0), 8, 0.1f, 0.01f, 20.f);
+	sim3 = false;
+}
+
+//Jello cube on the stencil kernel: same masses, no spring array
+void initLatticeSim3()
+{
+	initLatticeCube(5);
+}
+
+//Hanging cloth on the stencil kernel
+void initLatticeSim4()
+{
+	initLatticeCloth(11, 7);
+}
+
+//Axis springs, then side, horizontal and front/back crosses (sim3)
+static const vector<LatticeKernel::Offset> cubeStencil = {
+	{1,0,0}, {0,1,0}, {0,0,1},
+	{0,1,1}, {0,1,-1},
+	{1,0,1}, {1,0,-1},
+	{1,1,0}, {1,-1,0}};
+
+//Horizontal, vertical and crossed lines (sim4)
+static const vector<LatticeKernel::Offset> clothStencil = {
+	{1,0,0}, {0,0,1}, {1,0,1}, {1,0,-1}};
+
+//Springs between the grid masses x + nx*(y + ny*z) along every stencil
+//offset, in O(n)
+static void connectGrid(ivec3 n, vector<LatticeKernel::Offset> const &stencil, float k)
+{
+	for(int z = 0; z < n.z; z++)
+		for(int y = 0; y < n.y; y++)
+			for(int x = 0; x < n.x; x++)
+				for(LatticeKernel::Offset const &o : stencil)
+				{
+					int x2 = x + o.dx, y2 = y + o.dy, z2 = z + o.dz;
+					if(x2 < 0 || x2 >= n.x || y2 < 0 || y2 >= n.y || z2 < 0 || z2 >= n.z)
+						continue;
+					
+					Mass *a = &masses[x + n.x*(y + n.y*z)];
+					Mass *b = &masses[x2 + n.x*(y2 + n.y*z2)];
+					springs.push_back(initSpring(Spring(), a, b, k, getLength(a, b)));
+				}
+}
+
+//Rope of n masses, fixed at the left end
+void initChain(int n)
+{
+	clearScene();
+	
+	numMass = n;
+	
+	//Gap between masses
+	float space = 0.15f;
+	
+	//Spring stiffness
+	float k = 2000;
+	
+	//Reserve up front so the spring pointers stay valid
+	masses.reserve(numMass);
+	springs.reserve(numMass - 1);
+	
+	//Initialize the masses, fixed at the left end
+	for(int i = 0; i < numMass; i++)
+	{
+		mRope = initMass(mRope, 0.5f, i == 0, vec3(-3.f + i*space, 3.5f, 0));
+		masses.push_back(mRope);
+	}
+	
+	//Initialize the springs
+	for(int i = 0; i < numMass - 1; i++)
+	{
+		sRope = initSpring(sRope, &masses[i], &masses[i+1], k, space);
+		springs.push_back(sRope);
+	}
+	
+	numSpring = springs.size();
+	sim3 = false;
+}
+
+//Jello cube of side^3 masses over the floor
+void initCube(int side)
+{
+	clearScene();
+	
+	ivec3 n(side);
+	masses.reserve(n.x*n.y*n.z);
+	springs.reserve(cubeStencil.size()*n.x*n.y*n.z);
+	
+	//Rows go +x, columns go down, layers go back
+	for(int z = 0; z < n.z; z++)
+		for(int y = 0; y < n.y; y++)
+			for(int x = 0; x < n.x; x++)
+				masses.push_back(initMass(Mass(), 1.f, false, vec3(-2.f + x, 5.5f - y, -z)));
+	
+	connectGrid(n, cubeStencil, 1000.f);
+	
+	numMass = masses.size();
+	numSpring = springs.size();
+	sim3 = true;
+	massGrid = n;
+}
+
+//Cloth of width x rows masses hanging from every other mass of the
+//first row
+void initCloth(int width, int rows)
+{
+	clearScene();
+	
+	ivec3 n(width, 1, rows);
+	masses.reserve(width*rows);
+	springs.reserve(clothStencil.size()*width*rows);
+	
+	for(int z = 0; z < rows; z++)
+		for(int x = 0; x < width; x++)
+			masses.push_back(initMass(Mass(), 1.f, z == 0 && x % 2 == 0,
+									  vec3(-2.5f + 0.5f*x, 3.5f, -1.f*z)));
+	
+	connectGrid(n, clothStencil, 200.f);
+	
+	numMass = masses.size();
+	numSpring = springs.size();
+	sim3 = false;
+	massGrid = n;
+}
+
+//Jello cube on the stencil kernel
+void initLatticeCube(int side)
+{
+	clearScene();
+	
+	//Rows go +x, columns go down, layers go back like initSim3
+	lattice.init(side, side, side, vec3(-2.f,5.5f,0), vec3(1,0,0),
+				 vec3(0,-1,0), vec3(0,0,-1), cubeStencil, 1.f, 1000.f);
+	lattice.setFloor(true, -2.f);
+	
+	numMass = lattice.size();
+	numSpring = 0;
+	sim3 = true;
+	massGrid = ivec3(side, side, side);
+}
+
+//Hanging cloth on the stencil kernel
+void initLatticeCloth(int width, int rows)
+{
+	clearScene();
+	
+	lattice.init(width, 1, rows, vec3(-2.5f,3.5f,0), vec3(0.5f,0,0),
+				 vec3(0,1,0), vec3(0,0,-1), clothStencil, 1.f, 200.f);
+	
+	//Every other mass on the first row is fixed
+	for(int i = 0; i < width; i += 2)
+		lattice.setFixed(i, 0, 0, true);
+	
+	numMass = lattice.size();
+	numSpring = 0;
+	sim3 = false;
+	massGrid = ivec3(width, 1, rows);
+}
+
+void applyForces(Spring s, Mass *a, Mass *b)
+{
+	//Get current length of spring
+	float springLength = getLength(s.a, s.b);
+	vec3 unitAB = (s.b->position - s.a->position)/springLength;
+	
+	//hooke = -k(x-x0)AB
+	vec3 hooke = (-s.stiffness)*(springLength - s.restLength)*unitAB;
+	
+	vec3 bAcc = hooke/(s.b->mass);
+	vec3 aAcc = -bAcc;
+
+	//Update acceleration for mass *a and *b
+	s.b->acc += bAcc;
+	s.a->acc += aAcc;
+}	
+	
+bool onFloor(Mass const *m)
+{
+	return sim3 && m->position.y < -2.f;
+}
+
+void floorContacts(Mass const *masses, int count, char *contact)
+{
+	SimdKernels::get().floorContacts(masses, count,
+		sim3 ? -2.f : -numeric_limits<float>::infinity(), contact);
+}
+
+void integrateMasses(Mass *masses, char const *contact, int count)
+{
+	SimdKernels::get().integrateMasses(masses, contact, count, damping,
+		-9.81f, -2.f, timestep);
+}
+
+void resolveForces(Mass *m)
+{
+	resolveForces(m, onFloor(m));
+}
+
+void resolveForces(Mass *m, bool contact)
+{	
+	//apply gravity and damping
+	vec3 gravity = vec3(0.f,-9.81f,0.f);
+	
+	vec3 vDamping = ((-damping)*(m->velocity))/m->mass;
+	
+	//apply all accelerations
+	m->acc = m->acc + gravity + vDamping;
+		
+		
+	if(m->fixedPoint == false)
+	{
+		if(contact)
+		{
+			m->velocity = m->velocity + m->acc*timestep;
+			m->velocity.y = 0.f;
+			m->position = m->position + m->velocity*timestep;
+			m->position.y = -2.f;
+		}
+		else
+		{
+			m->velocity = m->velocity + m->acc*timestep;
+			m->position = m->position + m->velocity*timestep;
+		}
+	}
+	
+	m->acc = vec3(0,0,0);
+}
@@ -54,8 +54,12 @@ Mat4f::~Mat4f() {}
 
 Mat4f &Mat4f::operator=(const Mat4f &copied) {
   if (this != &copied) {
-    Mat4f tmp(copied);
-    *this = std::move(tmp);
+    if (m_ptr) {
+      *m_ptr = *copied.m_ptr; // reuse the storage, no allocation
+    } else {
+      Mat4f tmp(copied);
+      *this = std::move(tmp);
+    }
   }
   return *this;
 }
@@ -105,19 +109,23 @@ Mat4f Mat4f::operator+(Mat4f other) const {
 
 Mat4f Mat4f::operator*(const Mat4f &other) const {
   Mat4f result;
+  multiply(*this, other, result);
+  return result;
+}
+
+void Mat4f::multiply(const Mat4f &a, const Mat4f &b, Mat4f &out) {
+  assert(&out != &a && &out != &b);
 
   float element;
   for (int i = 0; i < DIM; ++i) {
     for (int j = 0; j < DIM; ++j) {
       element = 0;
       for (int k = 0; k < DIM; ++k) {
-        element += (*this)(i, k) * other(k, j);
+        element += a(i, k) * b(k, j);
       }
-      result(i, j) = element;
+      out(i, j) = element;
     }
   }
-
-  return result;
 }
 
 Mat4f Mat4f::operator*(float scalar) const {
@@ -0,0 +1,180 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	NumaPlacement.cpp
+ */
+
+#include "NumaPlacement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef __linux__
+const int MAX_NODES = 64;
+
+// Bytes each thread moves at a time (one huge page)
+const size_t CHUNK = 2 << 20;
+
+// "0-3,8-11" -> 0 1 2 3 8 9 10 11
+void parseCpuList(char const *text, std::vector<int> &out) {
+  while (*text) {
+    int first = 0, last = 0, used = 0;
+    if (std::sscanf(text, "%d-%d%n", &first, &last, &used) < 2) {
+      if (std::sscanf(text, "%d%n", &first, &used) < 1)
+        return;
+      last = first;
+    }
+    for (int cpu = first; cpu <= last; ++cpu)
+      out.push_back(cpu);
+    text += used;
+    if (*text == ',')
+      ++text;
+    else
+      return;
+  }
+}
+
+struct Topology {
+  int nodes;
+  std::vector<int> cpus; // allowed CPUs, node by node
+};
+
+// Read once, before any thread is pinned, since pinning the main thread
+// would also narrow the process's affinity mask
+Topology const &topology() {
+  static Topology const topo = [] {
+    Topology t;
+    t.nodes = 0;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        CPU_SET(cpu, &allowed);
+
+    std::vector<char> listed(CPU_SETSIZE, 0);
+    for (int node = 0; node < MAX_NODES; ++node) {
+      char path[64], line[1024];
+      std::snprintf(path, sizeof(path),
+                    "/sys/devices/system/node/node%d/cpulist", node);
+      FILE *file = std::fopen(path, "r");
+      if (!file)
+        continue;
+      std::vector<int> cpus;
+      if (std::fgets(line, sizeof(line), file))
+        parseCpuList(line, cpus);
+      std::fclose(file);
+
+      if (!cpus.empty())
+        ++t.nodes;
+      for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) && !listed[cpu]) {
+          t.cpus.push_back(cpu);
+          listed[cpu] = 1;
+        }
+    }
+
+    // No node information: the allowed CPUs in order
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      if (CPU_ISSET(cpu, &allowed) && !listed[cpu])
+        t.cpus.push_back(cpu);
+    t.nodes = std::max(t.nodes, 1);
+    return t;
+  }();
+  return topo;
+}
+#endif // __linux__
+} // namespace
+
+int NumaPlacement::numNodes() {
+#ifdef __linux__
+  return topology().nodes;
+#else
+  return 1;
+#endif
+}
+
+bool NumaPlacement::pinThreads(ThreadPool &pool) {
+#ifdef __linux__
+  std::vector<int> const &cpus = topology().cpus;
+  if (cpus.empty())
+    return false;
+
+  // Spread over all CPUs in node order, so neighbouring threads (and the
+  // neighbouring domains they run) share a node
+  size_t threads = pool.size();
+  std::atomic<int> failed(0);
+  pool.forEachThread([&](int t) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[t * cpus.size() / threads], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      ++failed;
+  });
+
+  if (failed > 0) {
+    std::cerr << "Cannot pin " << failed << " of " << threads << " threads"
+              << std::endl;
+    return false;
+  }
+  return true;
+#else
+  std::cerr << "Thread pinning needs Linux" << std::endl;
+  return false;
+#endif
+}
+
+void NumaPlacement::firstTouch(void *data, size_t elemSize, int const *start,
+                               int numBlocks, ThreadPool &pool) {
+#ifdef __linux__
+  if (numBlocks < 1)
+    return;
+  char *base = static_cast<char *>(data);
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+
+  // Each thread saves, drops and rewrites its blocks a chunk at a time,
+  // so the copy costs CHUNK bytes per thread, not a second array
+  int threads = pool.size();
+  std::unique_ptr<char[]> buffers(new char[threads * CHUNK]);
+  std::atomic<int> failed(0);
+  pool.forEachThread([&](int t) {
+    char *saved = buffers.get() + t * CHUNK;
+    for (int b = t; b < numBlocks; b += threads) {
+      uintptr_t lo =
+          (uintptr_t(base + start[b] * elemSize) + page - 1) & ~(page - 1);
+      uintptr_t hi = uintptr_t(base + start[b + 1] * elemSize) & ~(page - 1);
+
+      for (uintptr_t p = lo; p < hi; p += CHUNK) {
+        void *chunk = reinterpret_cast<void *>(p);
+        size_t bytes = std::min<uintptr_t>(CHUNK, hi - p);
+        std::memcpy(saved, chunk, bytes);
+        // The next write to a dropped page maps a new one on the
+        // writer's node
+        if (madvise(chunk, bytes, MADV_DONTNEED) != 0) {
+          ++failed;
+          continue;
+        }
+        std::memcpy(chunk, saved, bytes);
+      }
+    }
+  });
+  if (failed > 0)
+    std::cerr << "NUMA placement: madvise failed" << std::endl;
+#else
+  (void)data, (void)elemSize, (void)start, (void)numBlocks, (void)pool;
+#endif
+}
@@ -0,0 +1,301 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	PerfCounters.cpp
+ */
+
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+struct Totals {
+  char const *name;
+  int64_t calls;
+  int64_t ns;
+  double value[PerfCounters::NUM_COUNTERS];
+};
+
+char const *const COUNTER_NAMES[PerfCounters::NUM_COUNTERS] = {
+    "cycles", "instr", "L1D miss", "LLC miss", "br miss", "cpu us", "faults"};
+
+// Phases in order of first use
+std::mutex s_mutex;
+std::vector<Totals> s_phases;
+bool s_available[PerfCounters::NUM_COUNTERS];
+
+int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// 1234567 -> "1.23M"
+std::string formatCount(double x) {
+  char text[32];
+  if (x < 1e4)
+    std::snprintf(text, sizeof(text), "%.0f", x);
+  else if (x < 1e6)
+    std::snprintf(text, sizeof(text), "%.1fk", x / 1e3);
+  else if (x < 1e9)
+    std::snprintf(text, sizeof(text), "%.2fM", x / 1e6);
+  else
+    std::snprintf(text, sizeof(text), "%.2fG", x / 1e9);
+  return text;
+}
+
+#ifdef __linux__
+// One counting group: the leader's read returns every member
+struct Group {
+  int leader;
+  std::vector<int> fds;
+  std::vector<int> counters; // counter of each member, in group order
+};
+
+std::vector<Group> s_groups;
+
+void describe(int counter, perf_event_attr &attr) {
+  auto cache = [](uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  };
+
+  switch (counter) {
+  case PerfCounters::CYCLES:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PerfCounters::INSTRUCTIONS:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PerfCounters::L1D_MISSES:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = cache(PERF_COUNT_HW_CACHE_L1D);
+    break;
+  case PerfCounters::LLC_MISSES:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = cache(PERF_COUNT_HW_CACHE_LL);
+    break;
+  case PerfCounters::BRANCH_MISSES:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  case PerfCounters::TASK_CLOCK:
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    break;
+  case PerfCounters::PAGE_FAULTS:
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+    break;
+  }
+}
+
+int openCounter(int counter, int tid, int groupFd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  describe(counter, attr);
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_kernel = 1; // allowed at perf_event_paranoid 2
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, tid, -1, groupFd,
+                 PERF_FLAG_FD_CLOEXEC);
+}
+
+// Hardware and software events cannot share a group reliably, so each
+// thread gets one group of each kind
+void openGroups(int tid, int &firstError) {
+  int const kinds[2][2] = {{PerfCounters::CYCLES, PerfCounters::TASK_CLOCK},
+                           {PerfCounters::TASK_CLOCK,
+                            PerfCounters::NUM_COUNTERS}};
+  for (auto const &range : kinds) {
+    Group group;
+    group.leader = -1;
+    for (int c = range[0]; c < range[1]; ++c) {
+      int fd = openCounter(c, tid, group.leader);
+      if (fd < 0) {
+        if (!firstError)
+          firstError = errno;
+        continue;
+      }
+      if (group.leader < 0)
+        group.leader = fd;
+      group.fds.push_back(fd);
+      group.counters.push_back(c);
+      s_available[c] = true;
+    }
+    if (group.leader >= 0)
+      s_groups.push_back(group);
+  }
+}
+#endif // __linux__
+} // namespace
+
+std::atomic<bool> PerfCounters::s_enabled(false);
+
+bool PerfCounters::enable() {
+  disable();
+
+#ifdef __linux__
+  DIR *tasks = opendir("/proc/self/task");
+  if (!tasks) {
+    std::cerr << "Perf counters: cannot list /proc/self/task" << std::endl;
+    return false;
+  }
+
+  int firstError = 0;
+  int threads = 0;
+  while (dirent *entry = readdir(tasks)) {
+    if (entry->d_name[0] == '.')
+      continue;
+    openGroups(std::atoi(entry->d_name), firstError);
+    ++threads;
+  }
+  closedir(tasks);
+
+  if (s_groups.empty()) {
+    std::cerr << "Perf counters unavailable: " << std::strerror(firstError)
+              << " (check /proc/sys/kernel/perf_event_paranoid)"
+              << std::endl;
+    return false;
+  }
+
+  std::cout << "Perf counters on " << threads << " threads:";
+  for (int c = 0; c < NUM_COUNTERS; ++c)
+    if (s_available[c])
+      std::cout << " " << COUNTER_NAMES[c];
+  std::cout << std::endl;
+
+  s_enabled = true;
+  return true;
+#else
+  std::cerr << "Perf counters need Linux (perf_event_open)" << std::endl;
+  return false;
+#endif
+}
+
+void PerfCounters::disable() {
+  s_enabled = false;
+#ifdef __linux__
+  for (Group const &group : s_groups)
+    for (int fd : group.fds)
+      close(fd);
+  s_groups.clear();
+#endif
+}
+
+void PerfCounters::read(Snapshot &s) {
+  for (int c = 0; c < NUM_COUNTERS; ++c)
+    s.value[c] = 0;
+
+#ifdef __linux__
+  uint64_t data[3 + NUM_COUNTERS];
+  for (Group const &group : s_groups) {
+    if (::read(group.leader, data, sizeof(data)) < 24)
+      continue;
+
+    // nr, time enabled, time running, values
+    uint64_t n = std::min<uint64_t>(data[0], group.counters.size());
+    double scale = data[2] > 0 ? double(data[1]) / data[2] : 0.0;
+    for (uint64_t i = 0; i < n; ++i)
+      s.value[group.counters[i]] += data[3 + i] * scale;
+  }
+#endif
+}
+
+void PerfCounters::add(char const *name, int64_t ns, Snapshot const &begin,
+                       Snapshot const &end) {
+  std::lock_guard<std::mutex> lock(s_mutex);
+
+  Totals *totals = nullptr;
+  for (Totals &t : s_phases)
+    if (std::strcmp(t.name, name) == 0)
+      totals = &t;
+  if (!totals) {
+    Totals t = {name, 0, 0, {0}};
+    s_phases.push_back(t);
+    totals = &s_phases.back();
+  }
+
+  ++totals->calls;
+  totals->ns += ns;
+  for (int c = 0; c < NUM_COUNTERS; ++c)
+    totals->value[c] += end.value[c] - begin.value[c];
+}
+
+PerfCounters::Phase::Phase(char const *name)
+    : m_name(enabled() ? name : nullptr), m_start(0) {
+  if (m_name) {
+    read(m_begin);
+    m_start = nowNs();
+  }
+}
+
+PerfCounters::Phase::~Phase() {
+  if (!m_name)
+    return;
+  int64_t ns = nowNs() - m_start;
+  Snapshot end;
+  read(end);
+  add(m_name, ns, m_begin, end);
+}
+
+void PerfCounters::report(std::ostream &out) {
+  std::lock_guard<std::mutex> lock(s_mutex);
+  if (s_phases.empty())
+    return;
+
+  out << "Perf counters per call (wall ms is the total)" << std::endl;
+  char line[256];
+  std::snprintf(line, sizeof(line), "%-16s %7s %10s %10s", "phase", "calls",
+                "wall us", "wall ms");
+  out << line;
+  for (int c = 0; c < NUM_COUNTERS; ++c) {
+    std::snprintf(line, sizeof(line), " %9s", COUNTER_NAMES[c]);
+    out << line;
+  }
+  out << "       IPC" << std::endl;
+
+  for (Totals const &t : s_phases) {
+    double calls = double(t.calls);
+    std::snprintf(line, sizeof(line), "%-16s %7lld %10.1f %10.2f", t.name,
+                  (long long)t.calls, t.ns / 1e3 / calls, t.ns / 1e6);
+    out << line;
+
+    for (int c = 0; c < NUM_COUNTERS; ++c) {
+      double perCall = t.value[c] / calls;
+      if (c == TASK_CLOCK)
+        perCall /= 1e3;
+      std::snprintf(line, sizeof(line), " %9s",
+                    s_available[c] ? formatCount(perCall).c_str() : "-");
+      out << line;
+    }
+
+    if (s_available[CYCLES] && s_available[INSTRUCTIONS] &&
+        t.value[CYCLES] > 0)
+      std::snprintf(line, sizeof(line), " %9.2f",
+                    t.value[INSTRUCTIONS] / t.value[CYCLES]);
+    else
+      std::snprintf(line, sizeof(line), " %9s", "-");
+    out << line << std::endl;
+  }
+}
@@ -0,0 +1,261 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	Profiler.cpp
+ */
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace {
+const int BLOCK_EVENTS = 4096;
+const int MAX_BLOCKS = 1024; // per thread, about 100 MB
+
+struct Event {
+  char const *name;
+  int64_t start, end;
+  int frame;
+};
+
+struct Block {
+  Block() : count(0), next(nullptr) {}
+  Event events[BLOCK_EVENTS];
+  std::atomic<int> count;
+  std::atomic<Block *> next;
+};
+
+struct ThreadBuffer {
+  ThreadBuffer() : tail(&head), blocks(1), dropped(0), id(0) {}
+  ~ThreadBuffer() {
+    Block *b = head.next.load();
+    while (b) {
+      Block *next = b->next.load();
+      delete b;
+      b = next;
+    }
+  }
+
+  Block head;
+  Block *tail; // owner only
+  int blocks;  // owner only
+  std::atomic<int64_t> dropped;
+  std::string name; // under s_mutex
+  int id;
+};
+
+std::atomic<int> s_frame(0);
+
+// Buffers of every thread that recorded, kept after the thread exits
+std::mutex s_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+
+// Created on the first event, so threads that never record cost nothing
+thread_local ThreadBuffer *t_buffer = nullptr;
+thread_local char const *t_name = nullptr;
+thread_local int t_nameIndex = -1;
+
+std::string threadName(int id) {
+  if (!t_name)
+    return "thread " + std::to_string(id);
+  if (t_nameIndex < 0)
+    return t_name;
+  return t_name + (" " + std::to_string(t_nameIndex));
+}
+
+// The profiler's own storage is left out of the allocation counts, so
+// --profile can run with --alloc-check
+ThreadBuffer &threadBuffer() {
+  if (!t_buffer) {
+    ALLOC_IGNORE();
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_buffers.emplace_back(new ThreadBuffer);
+    t_buffer = s_buffers.back().get();
+    t_buffer->id = s_buffers.size();
+    t_buffer->name = threadName(t_buffer->id);
+  }
+  return *t_buffer;
+}
+
+// Everything published so far by one thread
+void collect(ThreadBuffer const &buffer, std::vector<Event> &out) {
+  for (Block const *b = &buffer.head; b; b = b->next.load()) {
+    int n = b->count.load(std::memory_order_acquire);
+    out.insert(out.end(), b->events, b->events + n);
+  }
+}
+
+std::string formatTime(double ns) {
+  char text[32];
+  if (ns < 1e3)
+    std::snprintf(text, sizeof(text), "%.0fns", ns);
+  else if (ns < 1e6)
+    std::snprintf(text, sizeof(text), "%.1fus", ns / 1e3);
+  else if (ns < 1e9)
+    std::snprintf(text, sizeof(text), "%.2fms", ns / 1e6);
+  else
+    std::snprintf(text, sizeof(text), "%.2fs", ns / 1e9);
+  return text;
+}
+
+// Names in JSON strings
+std::string escape(char const *s) {
+  std::string out;
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\')
+      out += '\\';
+    out += *s;
+  }
+  return out;
+}
+} // namespace
+
+std::atomic<bool> Profiler::s_enabled(false);
+
+void Profiler::enable(bool on) { s_enabled.store(on); }
+
+void Profiler::record(char const *name, int64_t start, int64_t end) {
+  ThreadBuffer &buffer = threadBuffer();
+  Block *b = buffer.tail;
+  int n = b->count.load(std::memory_order_relaxed);
+
+  if (n == BLOCK_EVENTS) {
+    if (buffer.blocks == MAX_BLOCKS) {
+      buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ALLOC_IGNORE();
+    Block *next = new Block;
+    b->next.store(next, std::memory_order_release);
+    buffer.tail = b = next;
+    ++buffer.blocks;
+    n = 0;
+  }
+
+  Event &e = b->events[n];
+  e.name = name;
+  e.start = start;
+  e.end = end;
+  e.frame = s_frame.load(std::memory_order_relaxed);
+  b->count.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::nextFrame() {
+  s_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(char const *name, int index) {
+  t_name = name;
+  t_nameIndex = index;
+  if (t_buffer) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    t_buffer->name = threadName(t_buffer->id);
+  }
+}
+
+void Profiler::writeReport(std::ostream &out) {
+  // Durations per name; names are grouped by text since equal literals
+  // in different files need not share an address
+  std::map<std::string, std::vector<int64_t>> phases;
+  int64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::vector<Event> events;
+    for (auto const &buffer : s_buffers) {
+      events.clear();
+      collect(*buffer, events);
+      for (Event const &e : events)
+        phases[e.name].push_back(e.end - e.start);
+      dropped += buffer->dropped.load();
+    }
+  }
+
+  out << "Profile (" << s_frame.load() << " frames)" << std::endl;
+  for (auto &phase : phases) {
+    std::vector<int64_t> &d = phase.second;
+    std::sort(d.begin(), d.end());
+    double total = 0;
+    for (int64_t x : d)
+      total += x;
+    auto percentile = [&](double p) {
+      return double(d[std::min(size_t(p * d.size()), d.size() - 1)]);
+    };
+
+    out << phase.first << ": " << d.size() << " calls, total "
+        << formatTime(total) << ", mean " << formatTime(total / d.size())
+        << ", min " << formatTime(d.front()) << ", p50 "
+        << formatTime(percentile(0.5)) << ", p90 "
+        << formatTime(percentile(0.9)) << ", p99 "
+        << formatTime(percentile(0.99)) << ", max " << formatTime(d.back())
+        << std::endl;
+
+    // Bucket k holds [2^k, 2^(k+1)) ns
+    int counts[64] = {0};
+    int lo = 63, hi = 0;
+    for (int64_t x : d) {
+      int k = 0;
+      while (k < 62 && (int64_t(1) << (k + 1)) <= x)
+        ++k;
+      ++counts[k];
+      lo = std::min(lo, k);
+      hi = std::max(hi, k);
+    }
+    int most = *std::max_element(counts, counts + 64);
+    for (int k = lo; k <= hi; ++k) {
+      char line[64];
+      std::snprintf(line, sizeof(line), "  %9s - %-9s %8d ",
+                    formatTime(double(int64_t(1) << k)).c_str(),
+                    formatTime(double(int64_t(1) << (k + 1))).c_str(),
+                    counts[k]);
+      out << line << std::string((40 * counts[k] + most - 1) / most, '#')
+          << std::endl;
+    }
+  }
+  if (dropped > 0)
+    out << dropped << " events dropped (buffers full)" << std::endl;
+}
+
+bool Profiler::writeChromeTrace(char const *path) {
+  FILE *out = std::fopen(path, "w");
+  if (!out)
+    return false;
+
+  std::lock_guard<std::mutex> lock(s_mutex);
+  std::vector<std::vector<Event>> events(s_buffers.size());
+  int64_t origin = INT64_MAX;
+  for (size_t i = 0; i < s_buffers.size(); ++i) {
+    collect(*s_buffers[i], events[i]);
+    for (Event const &e : events[i])
+      origin = std::min(origin, e.start);
+  }
+
+  // Complete ("X") events in microseconds from the first event
+  std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for (size_t i = 0; i < s_buffers.size(); ++i) {
+    ThreadBuffer const &buffer = *s_buffers[i];
+    std::fprintf(out,
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", buffer.id,
+                 escape(buffer.name.c_str()).c_str());
+    first = false;
+
+    for (Event const &e : events[i])
+      std::fprintf(out,
+                   ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                   "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+                   escape(e.name).c_str(), buffer.id,
+                   (e.start - origin) / 1e3, (e.end - e.start) / 1e3,
+                   e.frame);
+  }
+  std::fprintf(out, "\n]}\n");
+  return std::fclose(out) == 0;
+}
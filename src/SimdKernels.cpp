@@ -0,0 +1,121 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SimdKernels.cpp
+ */
+
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "StrandBatch.h"
+
+#if defined(__GNUC__) && !defined(__clang__) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define SIMD_KERNELS_DISPATCH
+#endif
+
+// Baseline: whatever the Makefile targets (SSE2 on x86-64)
+namespace simd_sse2 {
+#include "SimdKernels.inl"
+} // namespace simd_sse2
+
+#ifdef SIMD_KERNELS_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+namespace simd_sse42 {
+#include "SimdKernels.inl"
+} // namespace simd_sse42
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace simd_avx2 {
+#include "SimdKernels.inl"
+} // namespace simd_avx2
+#pragma GCC pop_options
+
+// avx512f implies FMA; 512-bit vectors are used only where a loop is
+// long enough, as GCC prefers 256 bits otherwise
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512vl,avx512bw,avx512dq")
+namespace simd_avx512 {
+#include "SimdKernels.inl"
+} // namespace simd_avx512
+#pragma GCC pop_options
+#endif // SIMD_KERNELS_DISPATCH
+
+namespace {
+SimdKernels::Table const *tables[SimdKernels::NUM_ISAS] = {
+    &simd_sse2::table,
+#ifdef SIMD_KERNELS_DISPATCH
+    &simd_sse42::table, &simd_avx2::table, &simd_avx512::table,
+#else
+    nullptr, nullptr, nullptr,
+#endif
+};
+
+char const *names[SimdKernels::NUM_ISAS] = {"sse2", "sse4.2", "avx2",
+                                            "avx512"};
+} // namespace
+
+SimdKernels::Isa SimdKernels::s_selected = SimdKernels::best();
+SimdKernels::Table const *SimdKernels::s_table =
+    tables[SimdKernels::s_selected];
+
+// __builtin_cpu_supports also checks that the OS saves the AVX state
+bool SimdKernels::supported(Isa isa) {
+  if (isa < 0 || isa >= NUM_ISAS || !tables[isa])
+    return false;
+#ifdef SIMD_KERNELS_DISPATCH
+  __builtin_cpu_init();
+  switch (isa) {
+  case SSE4_2:
+    return __builtin_cpu_supports("sse4.2") &&
+           __builtin_cpu_supports("popcnt");
+  case AVX2:
+    return __builtin_cpu_supports("avx2");
+  case AVX512:
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vl") &&
+           __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512dq");
+  default:
+    break;
+  }
+#endif
+  return true;
+}
+
+SimdKernels::Isa SimdKernels::best() {
+  for (int isa = NUM_ISAS - 1; isa > SSE2; --isa)
+    if (supported(Isa(isa)))
+      return Isa(isa);
+  return SSE2;
+}
+
+bool SimdKernels::select(Isa isa) {
+  if (!supported(isa))
+    return false;
+  s_selected = isa;
+  s_table = tables[isa];
+  return true;
+}
+
+SimdKernels::Isa SimdKernels::selected() { return s_selected; }
+
+char const *SimdKernels::name(Isa isa) {
+  return isa >= 0 && isa < NUM_ISAS ? names[isa] : "unknown";
+}
+
+bool SimdKernels::parse(char const *name, Isa &isa) {
+  for (int i = 0; i < NUM_ISAS; ++i) {
+    if (std::strcmp(name, names[i]) == 0) {
+      isa = Isa(i);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,223 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SimdKernels.inl
+ *
+ * Kernel bodies, included by SimdKernels.cpp once per instruction set
+ * inside a namespace of its own. No include guard on purpose.
+ *
+ * The kernels take restrict pointers: with three force arrays and six
+ * position streams there are too many pairs for the compiler to version
+ * the loops on aliasing checks, and they would stay scalar.
+ */
+
+const int L = StrandBatch::LANES;
+
+// hooke = -k(x-x0)AB pulls each particle in [x0, x1) of a row towards
+// the particle `off` entries further on
+void gatherRow(float const *__restrict__ ax, float const *__restrict__ ay,
+               float const *__restrict__ az, int off, float *__restrict__ fx,
+               float *__restrict__ fy, float *__restrict__ fz, int x0, int x1,
+               float k, float rest) {
+  float const *bx = ax + off, *by = ay + off, *bz = az + off;
+
+  for (int x = x0; x < x1; ++x) {
+    float dx = bx[x] - ax[x];
+    float dy = by[x] - ay[x];
+    float dz = bz[x] - az[x];
+    float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+    float f = k * (len - rest) / std::max(len, 1e-6f);
+
+    fx[x] += f * dx;
+    fy[x] += f * dy;
+    fz[x] += f * dz;
+  }
+}
+
+// Symplectic Euler with the floor clamp written as selects (this needs
+// -fno-trapping-math to vectorise)
+void integrateRange(float *__restrict__ px, float *__restrict__ py,
+                    float *__restrict__ pz, float *__restrict__ vx,
+                    float *__restrict__ vy, float *__restrict__ vz,
+                    float const *__restrict__ fx, float const *__restrict__ fy,
+                    float const *__restrict__ fz,
+                    float const *__restrict__ invMass, int begin, int end,
+                    float mass, float g, float d, float floorY, float dt) {
+  for (int i = begin; i < end; ++i) {
+    float y = py[i];
+    float nvx = vx[i] + (fx[i] - d * vx[i]) * invMass[i] * dt;
+    float nvy = vy[i] + (fy[i] + mass * g - d * vy[i]) * invMass[i] * dt;
+    float nvz = vz[i] + (fz[i] - d * vz[i]) * invMass[i] * dt;
+    nvy = y < floorY ? 0.f : nvy;
+    float npy = y < floorY ? floorY : y + nvy * dt;
+
+    vx[i] = nvx;
+    vy[i] = nvy;
+    vz[i] = nvz;
+    px[i] += nvx * dt;
+    py[i] = npy;
+    pz[i] += nvz * dt;
+  }
+}
+
+// Spring forces between particle j and j+1, LANES strands at a time
+void strandForces(float const *__restrict__ pos, float *__restrict__ acc,
+                  float const *__restrict__ rest, int particles, float k) {
+  for (int j = 0; j + 1 < particles; ++j) {
+    float const *p0 = pos + j * 3 * L;
+    float const *p1 = p0 + 3 * L;
+    float *a0 = acc + j * 3 * L;
+    float *a1 = a0 + 3 * L;
+
+    for (int l = 0; l < L; ++l) {
+      float dx = p1[l] - p0[l];
+      float dy = p1[L + l] - p0[L + l];
+      float dz = p1[2 * L + l] - p0[2 * L + l];
+      float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+      // hooke = -k(x-x0)AB, acting on particle j+1
+      float s = -k * (len - rest[l]) / std::max(len, 1e-6f);
+      a1[l] += s * dx;
+      a1[L + l] += s * dy;
+      a1[2 * L + l] += s * dz;
+      a0[l] -= s * dx;
+      a0[L + l] -= s * dy;
+      a0[2 * L + l] -= s * dz;
+    }
+  }
+}
+
+// Integrate every particle except the anchored root
+void strandIntegrate(float *__restrict__ pos, float *__restrict__ vel,
+                     float const *__restrict__ acc,
+                     float const *__restrict__ mass,
+                     float const *__restrict__ invMass, int particles, float g,
+                     float d, float dt) {
+  for (int j = 1; j < particles; ++j) {
+    float *p = pos + j * 3 * L;
+    float *v = vel + j * 3 * L;
+    float const *a = acc + j * 3 * L;
+
+    for (int l = 0; l < L; ++l) {
+      float ax = (a[l] - d * v[l]) * invMass[l];
+      float ay = (a[L + l] + mass[l] * g - d * v[L + l]) * invMass[l];
+      float az = (a[2 * L + l] - d * v[2 * L + l]) * invMass[l];
+
+      v[l] += ax * dt;
+      v[L + l] += ay * dt;
+      v[2 * L + l] += az * dt;
+      p[l] += v[l] * dt;
+      p[L + l] += v[L + l] * dt;
+      p[2 * L + l] += v[2 * L + l] * dt;
+    }
+  }
+}
+
+void floorContacts(Mass const *__restrict__ masses, int count, float floorY,
+                   char *__restrict__ contact) {
+  for (int i = 0; i < count; ++i)
+    contact[i] = masses[i].position.y < floorY;
+}
+
+// Within a colour every mass is written by at most one spring, but the
+// writes go through pointers, so the compiler still has to assume they
+// may alias the positions it reads
+void springForceRange(Spring const *__restrict__ springs,
+                      int const *__restrict__ order, int begin, int end) {
+  for (int k = begin; k < end; ++k) {
+    Spring const &s = springs[order[k]];
+    Mass *a = s.a, *b = s.b;
+    float dx = b->position.x - a->position.x;
+    float dy = b->position.y - a->position.y;
+    float dz = b->position.z - a->position.z;
+    float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+    // hooke = -k(x-x0)AB, divided by b's mass as in applyForces
+    float h = (-s.stiffness) * (len - s.restLength);
+    float bx = h * (dx / len) / b->mass;
+    float by = h * (dy / len) / b->mass;
+    float bz = h * (dz / len) / b->mass;
+
+    b->acc.x += bx;
+    b->acc.y += by;
+    b->acc.z += bz;
+    a->acc.x += -bx;
+    a->acc.y += -by;
+    a->acc.z += -bz;
+  }
+}
+
+// Same arithmetic as resolveForces, with the contact branch as selects
+void integrateMasses(Mass *__restrict__ masses,
+                     char const *__restrict__ contact, int count,
+                     float damping, float g, float floorY, float dt) {
+  for (int i = 0; i < count; ++i) {
+    Mass &m = masses[i];
+    float ax = m.acc.x + (-damping * m.velocity.x) / m.mass;
+    float ay = (m.acc.y + g) + (-damping * m.velocity.y) / m.mass;
+    float az = m.acc.z + (-damping * m.velocity.z) / m.mass;
+
+    if (!m.fixedPoint) {
+      float vx = m.velocity.x + ax * dt;
+      float vy = m.velocity.y + ay * dt;
+      float vz = m.velocity.z + az * dt;
+      vy = contact[i] ? 0.f : vy;
+
+      m.velocity.x = vx;
+      m.velocity.y = vy;
+      m.velocity.z = vz;
+      m.position.x += vx * dt;
+      m.position.y = contact[i] ? floorY : m.position.y + vy * dt;
+      m.position.z += vz * dt;
+    }
+    m.acc.x = m.acc.y = m.acc.z = 0.f;
+  }
+}
+
+void packQuads(Mass const *__restrict__ masses, int count, float half,
+               float *__restrict__ out) {
+  for (int i = 0; i < count; ++i) {
+    float x = masses[i].position.x;
+    float y = masses[i].position.y;
+    float z = masses[i].position.z;
+    float *q = out + 18 * i;
+    q[0] = x - half, q[1] = y - half, q[2] = z;
+    q[3] = x - half, q[4] = y + half, q[5] = z;
+    q[6] = x + half, q[7] = y - half, q[8] = z;
+    q[9] = x + half, q[10] = y + half, q[11] = z;
+    q[12] = x - half, q[13] = y + half, q[14] = z;
+    q[15] = x + half, q[16] = y - half, q[17] = z;
+  }
+}
+
+void packSpringLines(Spring const *__restrict__ springs, int count,
+                     float *__restrict__ out) {
+  for (int i = 0; i < count; ++i) {
+    glm::vec3 const &a = springs[i].a->position;
+    glm::vec3 const &b = springs[i].b->position;
+    float *v = out + 6 * i;
+    v[0] = a.x, v[1] = a.y, v[2] = a.z;
+    v[3] = b.x, v[4] = b.y, v[5] = b.z;
+  }
+}
+
+// Interleave the SoA rows into line vertices a, b, a, b, ...
+void packLatticeRow(float const *__restrict__ px, float const *__restrict__ py,
+                    float const *__restrict__ pz, int off, int x0, int x1,
+                    float *__restrict__ out) {
+  for (int x = x0; x < x1; ++x) {
+    float *v = out + 6 * (x - x0);
+    v[0] = px[x];
+    v[1] = py[x];
+    v[2] = pz[x];
+    v[3] = px[x + off];
+    v[4] = py[x + off];
+    v[5] = pz[x + off];
+  }
+}
+
+SimdKernels::Table const table = {
+    gatherRow,        integrateRange,  strandForces,
+    strandIntegrate,  floorContacts,   springForceRange,
+    integrateMasses,  packQuads,       packSpringLines,
+    packLatticeRow};
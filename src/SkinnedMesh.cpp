@@ -0,0 +1,72 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SkinnedMesh.cpp
+ */
+
+#include "SkinnedMesh.h"
+
+using namespace glm;
+
+SkinnedMesh::SkinnedMesh() : m_grid(0) {}
+
+glm::ivec3 SkinnedMesh::grid() const { return m_grid; }
+int SkinnedMesh::numVertices() const {
+  return m_vertices.size() / VERTEX_FLOATS;
+}
+
+std::vector<float> const &SkinnedMesh::vertices() const { return m_vertices; }
+std::vector<uint32_t> const &SkinnedMesh::indices() const {
+  return m_indices;
+}
+
+void SkinnedMesh::clear() {
+  m_grid = ivec3(0);
+  m_vertices.clear();
+  m_indices.clear();
+}
+
+void SkinnedMesh::build(ivec3 grid, int subdivisions) {
+  clear();
+  m_grid = grid;
+
+  for (int normal = 0; normal < 3; ++normal) {
+    int a = (normal + 1) % 3;
+    int b = (normal + 2) % 3;
+    if (grid[a] < 2 || grid[b] < 2)
+      continue;
+
+    addFace(normal, 0, subdivisions);
+    if (grid[normal] > 1)
+      addFace(normal, grid[normal] - 1, subdivisions);
+  }
+}
+
+// Fine grid over the face at grid coordinate `layer` along normalAxis
+void SkinnedMesh::addFace(int normalAxis, int layer, int subdivisions) {
+  int a = (normalAxis + 1) % 3;
+  int b = (normalAxis + 2) % 3;
+  int nu = (m_grid[a] - 1) * subdivisions + 1;
+  int nv = (m_grid[b] - 1) * subdivisions + 1;
+  uint32_t first = numVertices();
+
+  for (int j = 0; j < nv; ++j) {
+    for (int i = 0; i < nu; ++i) {
+      vec3 coord(0.f);
+      coord[normalAxis] = layer;
+      coord[a] = float(i) / subdivisions;
+      coord[b] = float(j) / subdivisions;
+
+      m_vertices.insert(m_vertices.end(), {coord.x, coord.y, coord.z,
+                                           float(a), float(b)});
+    }
+  }
+
+  for (int j = 0; j + 1 < nv; ++j) {
+    for (int i = 0; i + 1 < nu; ++i) {
+      uint32_t v = first + j * nu + i;
+      m_indices.insert(m_indices.end(),
+                       {v, v + 1, v + nu, v + 1, v + nu + 1, v + nu});
+    }
+  }
+}
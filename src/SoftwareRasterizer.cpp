@@ -0,0 +1,427 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SoftwareRasterizer.cpp
+ */
+
+#include "SoftwareRasterizer.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+namespace {
+// Primitives per binning task
+const int CHUNK_PRIMS = 4096;
+
+// Vertices per transform task
+const int VERTEX_GRAIN = 8192;
+
+uint8_t toByte(float c) {
+  return uint8_t(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+uint32_t crc32(uint8_t const *data, size_t n, uint32_t crc = 0) {
+  static uint32_t const *table = [] {
+    static uint32_t t[256];
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+
+  crc = ~crc;
+  for (size_t i = 0; i < n; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+void putBE32(std::vector<uint8_t> &out, uint32_t x) {
+  out.push_back(x >> 24);
+  out.push_back(x >> 16);
+  out.push_back(x >> 8);
+  out.push_back(x);
+}
+
+// Length, type, data and CRC, assembled in `chunk` (reused between calls)
+bool writeChunk(FILE *out, char const *type, uint8_t const *data, size_t n,
+                std::vector<uint8_t> &chunk) {
+  chunk.clear();
+  putBE32(chunk, n);
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data, data + n);
+  putBE32(chunk, crc32(&chunk[4], n + 4));
+  return std::fwrite(chunk.data(), 1, chunk.size(), out) == chunk.size();
+}
+} // namespace
+
+SoftwareRasterizer::SoftwareRasterizer()
+    : m_width(0), m_height(0), m_tilesX(0), m_tilesY(0), m_numVerts(0),
+      m_numChunks(0) {
+  for (int i = 0; i < 16; ++i)
+    m_clip[i] = (i % 5 == 0) ? 1.f : 0.f;
+  m_clear[0] = m_clear[1] = m_clear[2] = 0;
+}
+
+void SoftwareRasterizer::resize(int width, int height) {
+  m_width = std::max(width, 1);
+  m_height = std::max(height, 1);
+  m_tilesX = (m_width + TILE - 1) / TILE;
+  m_tilesY = (m_height + TILE - 1) / TILE;
+  m_rgb.assign(3 * m_width * m_height, 0);
+  m_depth.assign(m_width * m_height, 1.f);
+}
+
+int SoftwareRasterizer::width() const { return m_width; }
+int SoftwareRasterizer::height() const { return m_height; }
+uint8_t const *SoftwareRasterizer::pixels() const { return m_rgb.data(); }
+
+void SoftwareRasterizer::begin(vec3 clearColor) {
+  for (int i = 0; i < 3; ++i)
+    m_clear[i] = toByte(clearColor[i]);
+
+  m_batches.clear();
+  m_prims.clear();
+  m_numVerts = 0;
+}
+
+void SoftwareRasterizer::setTransform(Mat4f const &mvp) {
+  for (int r = 0; r < 4; ++r)
+    for (int c = 0; c < 4; ++c)
+      m_clip[4 * r + c] = mvp(r, c);
+}
+
+void SoftwareRasterizer::drawTriangles(Vec3f const *v, int n, vec3 color) {
+  add(v, n, 3, color);
+}
+
+void SoftwareRasterizer::drawLines(Vec3f const *v, int n, vec3 color) {
+  add(v, n, 2, color);
+}
+
+void SoftwareRasterizer::add(Vec3f const *v, int n, int vertsPerPrim,
+                             vec3 color) {
+  Batch b = {v, m_numVerts, n - n % vertsPerPrim, vertsPerPrim, {0, 0, 0}};
+  for (int i = 0; i < 3; ++i)
+    b.color[i] = toByte(color[i]);
+  std::copy(m_clip, m_clip + 16, b.clip);
+
+  for (int i = 0; i < b.count; i += vertsPerPrim) {
+    Prim p = {int(m_batches.size()), b.first + i};
+    m_prims.push_back(p);
+  }
+  m_batches.push_back(b);
+  m_numVerts += b.count;
+}
+
+void SoftwareRasterizer::finish(ThreadPool &pool) {
+  PROFILE_SCOPE("rasterize");
+
+  // Window coordinates: x right and y down in pixels, depth in [0, 1]
+  m_screen.resize(m_numVerts);
+
+  for (Batch const &b : m_batches) {
+    pool.parallelFor(0, b.count, VERTEX_GRAIN, [&](int begin, int end) {
+      float const *m = b.clip;
+      for (int i = begin; i < end; ++i) {
+        Vec3f const &p = b.v[i];
+        float x = m[0] * p.x() + m[1] * p.y() + m[2] * p.z() + m[3];
+        float y = m[4] * p.x() + m[5] * p.y() + m[6] * p.z() + m[7];
+        float z = m[8] * p.x() + m[9] * p.y() + m[10] * p.z() + m[11];
+        float w = m[12] * p.x() + m[13] * p.y() + m[14] * p.z() + m[15];
+
+        float inv = w > 1e-6f ? 1.f / w : 0.f;
+        m_screen[b.first + i] =
+            vec4((x * inv * 0.5f + 0.5f) * m_width,
+                 (0.5f - y * inv * 0.5f) * m_height, z * inv * 0.5f + 0.5f, w);
+      }
+    });
+  }
+
+  int numPrims = m_prims.size();
+  int tiles = m_tilesX * m_tilesY;
+  m_numChunks = (numPrims + CHUNK_PRIMS - 1) / CHUNK_PRIMS;
+  if (m_binStart.size() < size_t(m_numChunks) * (tiles + 1))
+    m_binStart.resize(size_t(m_numChunks) * (tiles + 1));
+  if (m_widePrims.size() < size_t(m_numChunks) * CHUNK_PRIMS) {
+    m_binPrims.resize(size_t(m_numChunks) * CHUNK_PRIMS * MAX_PRIM_TILES);
+    m_widePrims.resize(size_t(m_numChunks) * CHUNK_PRIMS);
+    m_numWide.resize(m_numChunks);
+  }
+
+  pool.parallelFor(0, m_numChunks, 1, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c)
+      binChunk(c, c * CHUNK_PRIMS, std::min((c + 1) * CHUNK_PRIMS, numPrims));
+  });
+
+  pool.parallelFor(0, tiles, 1, [&](int begin, int end) {
+    for (int t = begin; t < end; ++t)
+      rasterTile(t);
+  });
+}
+
+// Tiles touched by the bounds of primitive `prim`: bounds = {tx0, ty0,
+// tx1, ty1}, inclusive. Primitives with a vertex behind the eye (w <= 0)
+// are dropped; parts in front of the near or behind the far plane fail
+// the per-pixel depth range.
+bool SoftwareRasterizer::tileBounds(int prim, int *bounds) const {
+  Prim const &p = m_prims[prim];
+  int n = m_batches[p.batch].vertsPerPrim;
+
+  vec2 lo(1e30f), hi(-1e30f);
+  bool behind = false;
+  for (int k = 0; k < n; ++k) {
+    vec4 const &s = m_screen[p.vertex + k];
+    behind = behind || s.w <= 1e-6f;
+    lo = min(lo, vec2(s));
+    hi = max(hi, vec2(s));
+  }
+  if (behind || hi.x < 0.f || hi.y < 0.f || lo.x >= m_width ||
+      lo.y >= m_height)
+    return false;
+
+  bounds[0] = std::max(int(lo.x) / TILE, 0);
+  bounds[1] = std::max(int(lo.y) / TILE, 0);
+  bounds[2] = std::min(int(hi.x) / TILE, m_tilesX - 1);
+  bounds[3] = std::min(int(hi.y) / TILE, m_tilesY - 1);
+  return true;
+}
+
+// Counting sort by tile: count the entries of every bin, turn the counts
+// into bin ends, then fill the bins back to front so each keeps the
+// primitive order
+void SoftwareRasterizer::binChunk(int chunk, int first, int last) {
+  int tiles = m_tilesX * m_tilesY;
+  int *start = &m_binStart[size_t(chunk) * (tiles + 1)];
+  int *prims = &m_binPrims[size_t(chunk) * CHUNK_PRIMS * MAX_PRIM_TILES];
+  int *wide = &m_widePrims[size_t(chunk) * CHUNK_PRIMS];
+  int numWide = 0;
+  std::fill(start, start + tiles + 1, 0);
+
+  int b[4];
+  for (int i = first; i < last; ++i) {
+    if (!tileBounds(i, b))
+      continue;
+    if ((b[2] - b[0] + 1) * (b[3] - b[1] + 1) > MAX_PRIM_TILES) {
+      wide[numWide++] = i;
+      continue;
+    }
+    for (int ty = b[1]; ty <= b[3]; ++ty)
+      for (int tx = b[0]; tx <= b[2]; ++tx)
+        ++start[ty * m_tilesX + tx];
+  }
+
+  for (int t = 1; t <= tiles; ++t)
+    start[t] += start[t - 1];
+
+  for (int i = last - 1; i >= first; --i) {
+    if (!tileBounds(i, b) ||
+        (b[2] - b[0] + 1) * (b[3] - b[1] + 1) > MAX_PRIM_TILES)
+      continue;
+    for (int ty = b[1]; ty <= b[3]; ++ty)
+      for (int tx = b[0]; tx <= b[2]; ++tx)
+        prims[--start[ty * m_tilesX + tx]] = i;
+  }
+  m_numWide[chunk] = numWide;
+}
+
+void SoftwareRasterizer::rasterTile(int tile) {
+  int x0 = (tile % m_tilesX) * TILE;
+  int y0 = (tile / m_tilesX) * TILE;
+  int x1 = std::min(x0 + TILE, m_width);
+  int y1 = std::min(y0 + TILE, m_height);
+
+  for (int y = y0; y < y1; ++y) {
+    for (int x = x0; x < x1; ++x) {
+      uint8_t *c = &m_rgb[3 * (y * m_width + x)];
+      c[0] = m_clear[0];
+      c[1] = m_clear[1];
+      c[2] = m_clear[2];
+      m_depth[y * m_width + x] = 1.f;
+    }
+  }
+
+  // Merge the tile's bin with the chunk's wide primitives, both sorted
+  int tiles = m_tilesX * m_tilesY;
+  for (int chunk = 0; chunk < m_numChunks; ++chunk) {
+    int const *start = &m_binStart[size_t(chunk) * (tiles + 1)];
+    int const *prims =
+        &m_binPrims[size_t(chunk) * CHUNK_PRIMS * MAX_PRIM_TILES];
+    int const *wide = &m_widePrims[size_t(chunk) * CHUNK_PRIMS];
+    int i = start[tile], iEnd = start[tile + 1];
+    int w = 0, wEnd = m_numWide[chunk];
+    while (i < iEnd || w < wEnd) {
+      if (w == wEnd || (i < iEnd && prims[i] < wide[w]))
+        drawPrim(prims[i++], x0, y0, x1, y1);
+      else
+        drawPrim(wide[w++], x0, y0, x1, y1);
+    }
+  }
+}
+
+void SoftwareRasterizer::drawPrim(int prim, int x0, int y0, int x1, int y1) {
+  Prim const &p = m_prims[prim];
+  Batch const &b = m_batches[p.batch];
+  vec4 const *s = &m_screen[p.vertex];
+
+  if (b.vertsPerPrim == 3) {
+    vec3 tri[3] = {vec3(s[0]), vec3(s[1]), vec3(s[2])};
+    triangle(tri, b.color, x0, y0, x1, y1);
+  } else {
+    line(vec3(s[0]), vec3(s[1]), b.color, x0, y0, x1, y1);
+  }
+}
+
+inline void SoftwareRasterizer::plot(int x, int y, float z,
+                                     uint8_t const *color) {
+  int i = y * m_width + x;
+  if (z < 0.f || z >= m_depth[i]) // GL_LESS, and the near/far range
+    return;
+  m_depth[i] = z;
+  uint8_t *c = &m_rgb[3 * i];
+  c[0] = color[0];
+  c[1] = color[1];
+  c[2] = color[2];
+}
+
+// Pixel centres inside the triangle, within [x0, x1) x [y0, y1)
+void SoftwareRasterizer::triangle(vec3 const *p, uint8_t const *color,
+                                  int x0, int y0, int x1, int y1) {
+  float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) -
+               (p[2].x - p[0].x) * (p[1].y - p[0].y);
+  if (std::fabs(area) < 1e-12f)
+    return;
+  float invArea = 1.f / area;
+
+  int bx0 = std::max(x0, int(std::floor(std::min({p[0].x, p[1].x, p[2].x}))));
+  int by0 = std::max(y0, int(std::floor(std::min({p[0].y, p[1].y, p[2].y}))));
+  int bx1 = std::min(x1, int(std::ceil(std::max({p[0].x, p[1].x, p[2].x}))));
+  int by1 = std::min(y1, int(std::ceil(std::max({p[0].y, p[1].y, p[2].y}))));
+
+  for (int y = by0; y < by1; ++y) {
+    float py = y + 0.5f;
+    for (int x = bx0; x < bx1; ++x) {
+      float px = x + 0.5f;
+      // Barycentric weights, positive inside for either winding
+      float w0 = ((p[1].x - px) * (p[2].y - py) -
+                  (p[2].x - px) * (p[1].y - py)) * invArea;
+      float w1 = ((p[2].x - px) * (p[0].y - py) -
+                  (p[0].x - px) * (p[2].y - py)) * invArea;
+      float w2 = 1.f - w0 - w1;
+      if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+        continue;
+      plot(x, y, w0 * p[0].z + w1 * p[1].z + w2 * p[2].z, color);
+    }
+  }
+}
+
+// One pixel per step along the major axis (DDA), only for the part of
+// the segment that lies in [x0, x1) x [y0, y1)
+void SoftwareRasterizer::line(vec3 a, vec3 b, uint8_t const *color, int x0,
+                              int y0, int x1, int y1) {
+  vec3 d = b - a;
+  int steps = int(std::ceil(std::max(std::fabs(d.x), std::fabs(d.y))));
+  if (steps == 0) {
+    if (a.x >= x0 && a.x < x1 && a.y >= y0 && a.y < y1)
+      plot(int(a.x), int(a.y), a.z, color);
+    return;
+  }
+
+  // Clip the parameter range to the tile (slab test)
+  float t0 = 0.f, t1 = 1.f;
+  float lo[2] = {float(x0), float(y0)}, hi[2] = {float(x1), float(y1)};
+  float start[2] = {a.x, a.y}, delta[2] = {d.x, d.y};
+  for (int axis = 0; axis < 2; ++axis) {
+    if (std::fabs(delta[axis]) < 1e-12f) {
+      if (start[axis] < lo[axis] || start[axis] >= hi[axis])
+        return;
+      continue;
+    }
+    float ta = (lo[axis] - start[axis]) / delta[axis];
+    float tb = (hi[axis] - start[axis]) / delta[axis];
+    t0 = std::max(t0, std::min(ta, tb));
+    t1 = std::min(t1, std::max(ta, tb));
+  }
+  if (t0 > t1)
+    return;
+
+  int i0 = std::max(int(std::floor(t0 * steps)), 0);
+  int i1 = std::min(int(std::ceil(t1 * steps)), steps);
+  float invSteps = 1.f / steps;
+  for (int i = i0; i <= i1; ++i) {
+    vec3 p = a + d * (i * invSteps);
+    int x = int(std::floor(p.x)), y = int(std::floor(p.y));
+    if (x >= x0 && x < x1 && y >= y0 && y < y1)
+      plot(x, y, p.z, color);
+  }
+}
+
+bool SoftwareRasterizer::writePPM(FILE *out) const {
+  return std::fprintf(out, "P6\n%d %d\n255\n", m_width, m_height) > 0 &&
+         std::fwrite(m_rgb.data(), 1, m_rgb.size(), out) == m_rgb.size();
+}
+
+bool SoftwareRasterizer::writePNG(FILE *out) const {
+  static uint8_t const signature[8] = {0x89, 'P', 'N', 'G',
+                                       '\r', '\n', 0x1a, '\n'};
+  if (std::fwrite(signature, 1, 8, out) != 8)
+    return false;
+
+  // 8-bit RGB, no interlace
+  uint8_t const header[13] = {uint8_t(m_width >> 24),  uint8_t(m_width >> 16),
+                              uint8_t(m_width >> 8),   uint8_t(m_width),
+                              uint8_t(m_height >> 24), uint8_t(m_height >> 16),
+                              uint8_t(m_height >> 8),  uint8_t(m_height),
+                              8, 2, 0, 0, 0};
+
+  // zlib stream of stored deflate blocks over the filtered rows
+  // (filter type 0 in front of every row)
+  size_t row = 3 * m_width;
+  size_t rawSize = (row + 1) * m_height;
+  std::vector<uint8_t> &raw = m_pngRaw;
+  raw.clear();
+  raw.reserve(rawSize);
+  for (int y = 0; y < m_height; ++y) {
+    raw.push_back(0);
+    raw.insert(raw.end(), &m_rgb[y * row], &m_rgb[y * row] + row);
+  }
+
+  // Stored blocks hold at most 65535 bytes and cost 5 bytes each
+  std::vector<uint8_t> &data = m_pngData;
+  data.clear();
+  data.reserve(rawSize + 5 * (rawSize / 65535 + 1) + 6);
+  data.push_back(0x78);
+  data.push_back(0x01);
+  for (size_t pos = 0; pos < rawSize || pos == 0;) {
+    size_t len = std::min(rawSize - pos, size_t(65535));
+    bool last = pos + len == rawSize;
+    data.push_back(last ? 1 : 0);
+    data.push_back(len & 0xff);
+    data.push_back(len >> 8);
+    data.push_back(~len & 0xff);
+    data.push_back((~len >> 8) & 0xff);
+    data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + len);
+    pos += len;
+    if (last)
+      break;
+  }
+
+  uint32_t s1 = 1, s2 = 0;
+  for (uint8_t byte : raw) {
+    s1 = (s1 + byte) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  putBE32(data, (s2 << 16) | s1);
+
+  std::vector<uint8_t> &chunk = m_pngChunk;
+  chunk.reserve(data.size() + 12);
+  return writeChunk(out, "IHDR", header, sizeof(header), chunk) &&
+         writeChunk(out, "IDAT", data.data(), data.size(), chunk) &&
+         writeChunk(out, "IEND", nullptr, 0, chunk);
+}
@@ -0,0 +1,214 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SpatialReorder.cpp
+ *
+ * Reference: Skilling, "Programming the Hilbert curve", 2004.
+ */
+
+#include "SpatialReorder.h"
+
+#include <algorithm>
+
+using namespace glm;
+
+namespace {
+// Bits per axis of the curve grid (1024^3 cells)
+const int BITS = 10;
+
+// Spread the low 10 bits of v so there are two zero bits between each
+uint32_t spreadBits(uint32_t v) {
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+} // namespace
+
+SpatialReorder::SpatialReorder() : m_interval(0), m_frame(0) {}
+
+uint32_t SpatialReorder::mortonCode(uint32_t x, uint32_t y, uint32_t z) {
+  return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+}
+
+uint32_t SpatialReorder::hilbertCode(uint32_t x, uint32_t y, uint32_t z) {
+  // Skilling's AxesToTranspose, then read the transposed bits out
+  // most significant axis first
+  uint32_t X[3] = {x, y, z};
+  uint32_t M = 1u << (BITS - 1);
+
+  for (uint32_t Q = M; Q > 1; Q >>= 1) {
+    uint32_t P = Q - 1;
+    for (int i = 0; i < 3; ++i) {
+      if (X[i] & Q) {
+        X[0] ^= P;
+      } else {
+        uint32_t t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+
+  uint32_t t = 0;
+  for (uint32_t Q = M; Q > 1; Q >>= 1) {
+    if (X[2] & Q)
+      t ^= Q - 1;
+  }
+  for (int i = 0; i < 3; ++i)
+    X[i] ^= t;
+
+  return (spreadBits(X[0]) << 2) | (spreadBits(X[1]) << 1) | spreadBits(X[2]);
+}
+
+void SpatialReorder::reset(int numMasses) {
+  m_toCurrent.resize(numMasses);
+  m_toOriginal.resize(numMasses);
+  for (int i = 0; i < numMasses; ++i)
+    m_toCurrent[i] = m_toOriginal[i] = i;
+  m_frame = 0;
+}
+
+void SpatialReorder::setInterval(int frames) {
+  m_interval = std::max(frames, 0);
+}
+
+bool SpatialReorder::tick() {
+  if (m_interval == 0)
+    return false;
+  if (++m_frame < m_interval)
+    return false;
+
+  m_frame = 0;
+  return true;
+}
+
+int SpatialReorder::currentIndex(int originalId) const {
+  return m_toCurrent[originalId];
+}
+
+int SpatialReorder::originalId(int currentIndex) const {
+  return m_toOriginal[currentIndex];
+}
+
+PoolVector<int> const &SpatialReorder::massIndex() const {
+  return m_massIndex;
+}
+
+PoolVector<int> const &SpatialReorder::springIndex() const {
+  return m_springIndex;
+}
+
+void SpatialReorder::apply(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                           Curve curve, PoolVector<int> const *blocks) {
+  int nm = ms.size();
+  if (nm == 0)
+    return;
+  if (int(m_toCurrent.size()) != nm)
+    reset(nm);
+
+  // Quantise positions to the curve grid over the bounding box
+  vec3 lo = ms[0].position, hi = ms[0].position;
+  for (Mass const &m : ms) {
+    lo = min(lo, m.position);
+    hi = max(hi, m.position);
+  }
+  vec3 extent = max(hi - lo, vec3(1e-6f));
+  vec3 scale = vec3(float((1 << BITS) - 1)) / extent;
+
+  m_keys.resize(nm);
+  for (int i = 0; i < nm; ++i) {
+    vec3 q = (ms[i].position - lo) * scale;
+    uint32_t x = uint32_t(q.x), y = uint32_t(q.y), z = uint32_t(q.z);
+    m_keys[i].first = (curve == HILBERT) ? hilbertCode(x, y, z)
+                                         : mortonCode(x, y, z);
+    m_keys[i].second = i;
+  }
+  if (blocks) {
+    for (int k = 0; k + 1 < int(blocks->size()); ++k)
+      std::sort(m_keys.begin() + (*blocks)[k],
+                m_keys.begin() + (*blocks)[k + 1]);
+  } else {
+    std::sort(m_keys.begin(), m_keys.end());
+  }
+
+  // Position along the curve
+  m_massIndex.resize(nm);
+  for (int i = 0; i < nm; ++i)
+    m_massIndex[m_keys[i].second] = i;
+
+  permute(ms, ss);
+}
+
+void SpatialReorder::group(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                           std::vector<int> &ids) {
+  int nm = ms.size();
+  if (nm == 0)
+    return;
+  if (int(m_toCurrent.size()) != nm)
+    reset(nm);
+
+  // Stable, so a curve order inside each group survives
+  std::vector<int> order(nm);
+  for (int i = 0; i < nm; ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return ids[a] < ids[b]; });
+
+  std::vector<int> sortedGroup(nm);
+  m_massIndex.resize(nm);
+  for (int i = 0; i < nm; ++i) {
+    m_massIndex[order[i]] = i;
+    sortedGroup[i] = ids[order[i]];
+  }
+  ids.swap(sortedGroup);
+
+  permute(ms, ss);
+}
+
+void SpatialReorder::permute(PoolVector<Mass> &ms, PoolVector<Spring> &ss) {
+  int nm = ms.size();
+  int ns = ss.size();
+
+  // Springs as index pairs in the new order, sorted by first endpoint
+  m_springOrder.resize(ns);
+  m_indexA.resize(ns);
+  m_indexB.resize(ns);
+  for (int i = 0; i < ns; ++i) {
+    m_indexA[i] = m_massIndex[ss[i].a - ms.data()];
+    m_indexB[i] = m_massIndex[ss[i].b - ms.data()];
+    m_springOrder[i].first = std::make_pair(m_indexA[i], m_indexB[i]);
+    m_springOrder[i].second = i;
+  }
+  std::sort(m_springOrder.begin(), m_springOrder.end());
+
+  // Through the scratch arrays and back, so ms and ss keep their buffers
+  // and the spring pointers stay in ms
+  m_massScratch.resize(nm);
+  for (int i = 0; i < nm; ++i)
+    m_massScratch[m_massIndex[i]] = ms[i];
+  std::copy(m_massScratch.begin(), m_massScratch.end(), ms.begin());
+
+  m_springScratch.resize(ns);
+  m_springIndex.resize(ns);
+  for (int i = 0; i < ns; ++i) {
+    int s = m_springOrder[i].second;
+    m_springIndex[s] = i;
+    m_springScratch[i] = ss[s];
+    m_springScratch[i].a = &ms[m_indexA[s]];
+    m_springScratch[i].b = &ms[m_indexB[s]];
+  }
+  std::copy(m_springScratch.begin(), m_springScratch.end(), ss.begin());
+
+  // Compose with the previous mapping so original ids survive re-sorts
+  for (int orig = 0; orig < nm; ++orig) {
+    int cur = m_massIndex[m_toCurrent[orig]];
+    m_toCurrent[orig] = cur;
+    m_toOriginal[cur] = orig;
+  }
+}
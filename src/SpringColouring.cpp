@@ -0,0 +1,80 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	SpringColouring.cpp
+ */
+
+#include "SpringColouring.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "SimdKernels.h"
+
+namespace {
+// Springs per parallel chunk; smaller colours run inline
+const int FORCE_GRAIN = 1024;
+} // namespace
+
+int SpringColouring::numColours() const {
+  return std::max(int(m_colourStart.size()) - 1, 0);
+}
+
+int SpringColouring::numSprings() const { return m_order.size(); }
+
+void SpringColouring::rebuild(PoolVector<Mass> const &ms,
+                              PoolVector<Spring> const &ss) {
+  int nm = ms.size();
+  int ns = ss.size();
+
+  // Greedy colouring: give each spring the lowest colour neither endpoint
+  // has used yet. Degrees are small (<= 18 in the jello cube), so a short
+  // per-mass list is cheaper than a bitset.
+  std::vector<std::vector<int>> used(nm);
+  std::vector<int> colour(ns);
+  int numColours = 0;
+
+  for (int i = 0; i < ns; ++i) {
+    std::vector<int> &ua = used[ss[i].a - ms.data()];
+    std::vector<int> &ub = used[ss[i].b - ms.data()];
+
+    int c = 0;
+    while (std::find(ua.begin(), ua.end(), c) != ua.end() ||
+           std::find(ub.begin(), ub.end(), c) != ub.end())
+      ++c;
+
+    colour[i] = c;
+    ua.push_back(c);
+    ub.push_back(c);
+    numColours = std::max(numColours, c + 1);
+  }
+
+  // Counting sort of springs by colour
+  m_colourStart.assign(numColours + 1, 0);
+  for (int i = 0; i < ns; ++i)
+    ++m_colourStart[colour[i] + 1];
+  for (int c = 0; c < numColours; ++c)
+    m_colourStart[c + 1] += m_colourStart[c];
+
+  std::vector<int> fill(m_colourStart.begin(), m_colourStart.end() - 1);
+  m_order.resize(ns);
+  for (int i = 0; i < ns; ++i)
+    m_order[fill[colour[i]]++] = i;
+}
+
+void SpringColouring::remap(PoolVector<int> const &springIndex) {
+  for (int &i : m_order)
+    i = springIndex[i];
+}
+
+void SpringColouring::applyForces(PoolVector<Spring> &ss,
+                                  ThreadPool &pool) const {
+  SimdKernels::Table const &simd = SimdKernels::get();
+  for (int c = 0; c < numColours(); ++c) {
+    pool.parallelFor(m_colourStart[c], m_colourStart[c + 1], FORCE_GRAIN,
+                     [&](int begin, int end) {
+                       simd.springForceRange(ss.data(), m_order.data(),
+                                             begin, end);
+                     });
+  }
+}
@@ -0,0 +1,137 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	StrandBatch.cpp
+ */
+
+#include "StrandBatch.h"
+
+#include <algorithm>
+
+#include "MassSpringSystem.h"
+#include "SimdKernels.h"
+
+using namespace glm;
+
+namespace {
+const int L = StrandBatch::LANES;
+
+// Empty the array and hand its storage back to the buffer pool
+void release(PoolVector<float> &a) { PoolVector<float>().swap(a); }
+} // namespace
+
+StrandBatch::StrandBatch()
+    : m_numStrands(0), m_numBlocks(0), m_particles(0), m_stiffness(0.f) {}
+
+int StrandBatch::numStrands() const { return m_numStrands; }
+int StrandBatch::particlesPerStrand() const { return m_particles; }
+int StrandBatch::numSegments() const {
+  return m_numStrands * std::max(m_particles - 1, 0);
+}
+
+// First float of (block, particle); x, y and z follow LANES apart
+inline int StrandBatch::offset(int block, int particle) const {
+  return (block * m_particles + particle) * 3 * L;
+}
+
+void StrandBatch::clear() {
+  m_numStrands = m_numBlocks = m_particles = 0;
+  release(m_pos);
+  release(m_vel);
+  release(m_acc);
+  release(m_mass);
+  release(m_invMass);
+  release(m_restLength);
+}
+
+void StrandBatch::init(std::vector<vec3> const &roots, vec3 direction,
+                       int particles, float segmentLength, float mass,
+                       float stiffness) {
+  m_numStrands = roots.size();
+  m_numBlocks = (m_numStrands + L - 1) / L;
+  m_particles = std::max(particles, 2);
+  m_stiffness = stiffness;
+
+  int floats = m_numBlocks * m_particles * 3 * L;
+  m_pos.assign(floats, 0.f);
+  m_vel.assign(floats, 0.f);
+  m_acc.assign(floats, 0.f);
+  m_mass.assign(m_numBlocks * L, 0.f);
+  m_invMass.assign(m_numBlocks * L, 0.f);
+  m_restLength.assign(m_numBlocks * L, segmentLength);
+
+  vec3 dir = normalize(direction);
+  for (int s = 0; s < m_numStrands; ++s) {
+    int block = s / L;
+    int lane = s % L;
+
+    m_mass[s] = mass;
+    m_invMass[s] = 1.f / mass;
+
+    for (int j = 0; j < m_particles; ++j) {
+      vec3 p = roots[s] + dir * (segmentLength * j);
+      float *dst = &m_pos[offset(block, j)] + lane;
+      dst[0] = p.x;
+      dst[L] = p.y;
+      dst[2 * L] = p.z;
+    }
+  }
+}
+
+vec3 StrandBatch::position(int strand, int particle) const {
+  float const *src = &m_pos[offset(strand / L, particle)] + strand % L;
+  return vec3(src[0], src[L], src[2 * L]);
+}
+
+void StrandBatch::step(float dt, ThreadPool &pool) {
+  pool.parallelFor(0, m_numBlocks, 16, [&](int begin, int end) {
+    for (int b = begin; b < end; ++b)
+      stepBlock(b, dt);
+  });
+}
+
+void StrandBatch::stepBlock(int block, float dt) {
+  float *pos = &m_pos[offset(block, 0)];
+  float *vel = &m_vel[offset(block, 0)];
+  float *acc = &m_acc[offset(block, 0)];
+  float const *mass = &m_mass[block * L];
+  float const *invMass = &m_invMass[block * L];
+  float const *rest = &m_restLength[block * L];
+  float k = m_stiffness;
+  float g = -9.81f;
+  float d = damping;
+
+  std::fill(acc, acc + m_particles * 3 * L, 0.f);
+
+  SimdKernels::Table const &simd = SimdKernels::get();
+  simd.strandForces(pos, acc, rest, m_particles, k);
+  simd.strandIntegrate(pos, vel, acc, mass, invMass, m_particles, g, d, dt);
+}
+
+void StrandBatch::packLines(std::vector<Vec3f> &out, ThreadPool &pool) const {
+  int segments = m_particles - 1;
+  out.resize(2 * numSegments());
+
+  pool.parallelFor(0, m_numStrands, 1024, [&](int begin, int end) {
+    for (int s = begin; s < end; ++s) {
+      Vec3f *dst = &out[2 * s * segments];
+      float const *src = &m_pos[offset(s / L, 0)] + s % L;
+
+      for (int j = 0; j < segments; ++j) {
+        float const *p0 = src + j * 3 * L;
+        float const *p1 = p0 + 3 * L;
+        dst[2 * j].set(p0[0], p0[L], p0[2 * L]);
+        dst[2 * j + 1].set(p1[0], p1[L], p1[2 * L]);
+      }
+    }
+  });
+}
+
+void StrandBatch::packRestLengths(std::vector<float> &out) const {
+  int segments = std::max(m_particles - 1, 0);
+  out.clear();
+  out.reserve(2 * numSegments());
+
+  for (int s = 0; s < m_numStrands; ++s)
+    out.insert(out.end(), 2 * segments, m_restLength[s]);
+}
@@ -0,0 +1,79 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TaskGraph.cpp
+ */
+
+#include "TaskGraph.h"
+
+#include "Profiler.h"
+
+TaskGraph::TaskGraph()
+    : m_remainingSize(0), m_pool(nullptr), m_group(nullptr) {}
+
+int TaskGraph::add(Work const &work, int thread) {
+  Node node;
+  node.work = work;
+  node.thread = thread;
+  node.numPredecessors = 0;
+  m_nodes.push_back(node);
+  return m_nodes.size() - 1;
+}
+
+void TaskGraph::precede(int before, int after) {
+  m_nodes[before].successors.push_back(after);
+  ++m_nodes[after].numPredecessors;
+}
+
+void TaskGraph::clear() { m_nodes.clear(); }
+
+int TaskGraph::size() const { return m_nodes.size(); }
+
+void TaskGraph::run(ThreadPool &pool) {
+  int n = m_nodes.size();
+  if (n == 0)
+    return;
+
+  if (m_remainingSize < n) {
+    m_remaining.reset(new std::atomic<int>[n]);
+    m_remainingSize = n;
+  }
+  for (int i = 0; i < n; ++i)
+    m_remaining[i] = m_nodes[i].numPredecessors;
+
+  ThreadPool::TaskGroup group;
+  m_pool = &pool;
+  m_group = &group;
+
+  for (int i = 0; i < n; ++i) {
+    if (m_nodes[i].numPredecessors == 0)
+      launch(i);
+  }
+  pool.wait(group);
+
+  m_pool = nullptr;
+  m_group = nullptr;
+}
+
+void TaskGraph::launch(int node) {
+  if (m_nodes[node].thread >= 0)
+    m_pool->spawnOn(m_nodes[node].thread, *m_group, runNode, this, node);
+  else
+    m_pool->spawn(*m_group, runNode, this, node);
+}
+
+void TaskGraph::runNode(void *graph, int node, int) {
+  TaskGraph *g = static_cast<TaskGraph *>(graph);
+  Node const &n = g->m_nodes[node];
+
+  {
+    PROFILE_SCOPE("task");
+    n.work();
+  }
+
+  // The last predecessor to finish releases each successor
+  for (int s : n.successors) {
+    if (--g->m_remaining[s] == 0)
+      g->launch(s);
+  }
+}
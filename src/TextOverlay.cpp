@@ -0,0 +1,199 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TextOverlay.cpp
+ */
+
+#include "TextOverlay.h"
+
+#include <cstdint>
+
+#include "ShaderTools.h"
+
+namespace {
+const int FIRST_CHAR = 32;
+const int NUM_CHARS = 64;
+
+// One row per byte, top row first, bit 4 = leftmost column
+const uint8_t FONT[NUM_CHARS][TextOverlay::GLYPH_H] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+    {0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00}, // '"'
+    {0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a}, // '#'
+    {0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04}, // '$'
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+    {0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d}, // '&'
+    {0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, // '\''
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+    {0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00}, // '*'
+    {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08}, // ','
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}, // '.'
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, // '0'
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, // '1'
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, // '2'
+    {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}, // '3'
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, // '4'
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, // '5'
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, // '6'
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, // '8'
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}, // '9'
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}, // ':'
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08}, // ';'
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // '<'
+    {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}, // '='
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // '>'
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // '?'
+    {0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e}, // '@'
+    {0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, // 'A'
+    {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}, // 'B'
+    {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}, // 'C'
+    {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}, // 'D'
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}, // 'E'
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}, // 'F'
+    {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}, // 'G'
+    {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, // 'H'
+    {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, // 'I'
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}, // 'J'
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}, // 'L'
+    {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}, // 'M'
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+    {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // 'O'
+    {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}, // 'P'
+    {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}, // 'Q'
+    {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}, // 'R'
+    {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}, // 'S'
+    {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // 'U'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}, // 'V'
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}, // 'W'
+    {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}, // 'X'
+    {0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04}, // 'Y'
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f}, // 'Z'
+    {0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e}, // '['
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // '\\'
+    {0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e}, // ']'
+    {0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00}, // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f}, // '_'
+};
+
+// Texture unit of the font, clear of the units the scene shaders use
+const int FONT_UNIT = 2;
+} // namespace
+
+TextOverlay::TextOverlay()
+    : m_program(0), m_vao(0), m_buffer(0), m_font(0), m_scale(2) {}
+
+void TextOverlay::create(std::string const &vsSource,
+                         std::string const &fsSource) {
+  m_program = CreateShaderProgram(vsSource, fsSource);
+
+  // All glyphs side by side in one row of CELL_W x CELL_H cells
+  int width = NUM_CHARS * CELL_W;
+  std::vector<uint8_t> texels(width * CELL_H, 0);
+  for (int c = 0; c < NUM_CHARS; ++c)
+    for (int y = 0; y < GLYPH_H; ++y)
+      for (int x = 0; x < GLYPH_W; ++x)
+        if (FONT[c][y] & (0x10 >> x))
+          texels[y * width + c * CELL_W + x] = 255;
+
+  glGenTextures(1, &m_font);
+  glActiveTexture(GL_TEXTURE0 + FONT_UNIT);
+  glBindTexture(GL_TEXTURE_2D, m_font);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, CELL_H, 0, GL_RED,
+               GL_UNSIGNED_BYTE, texels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glActiveTexture(GL_TEXTURE0);
+
+  glGenVertexArrays(1, &m_vao);
+  glGenBuffers(1, &m_buffer);
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  glBindVertexArray(0);
+}
+
+void TextOverlay::destroy() {
+  glDeleteProgram(m_program);
+  glDeleteVertexArrays(1, &m_vao);
+  glDeleteBuffers(1, &m_buffer);
+  glDeleteTextures(1, &m_font);
+  m_program = m_vao = m_buffer = m_font = 0;
+}
+
+void TextOverlay::setScale(int scale) { m_scale = scale > 0 ? scale : 1; }
+
+int TextOverlay::lineHeight() const { return CELL_H * m_scale; }
+
+void TextOverlay::clear() { m_vertices.clear(); }
+
+void TextOverlay::print(int x, int y, char const *text) {
+  float w = GLYPH_W * m_scale, h = GLYPH_H * m_scale;
+
+  for (; *text; ++text) {
+    char ch = *text;
+    int c = (ch >= 'a' && ch <= 'z') ? ch - 'a' + 'A' : ch;
+    c -= FIRST_CHAR;
+    if (c < 0 || c >= NUM_CHARS)
+      c = '?' - FIRST_CHAR;
+
+    if (c != 0) {
+      float u = c * CELL_W;
+      float const quad[6][4] = {{0, 0, 0, 0}, {0, h, 0, GLYPH_H},
+                                {w, 0, GLYPH_W, 0}, {w, h, GLYPH_W, GLYPH_H},
+                                {w, 0, GLYPH_W, 0}, {0, h, 0, GLYPH_H}};
+      for (auto const &v : quad) {
+        m_vertices.push_back(x + v[0]);
+        m_vertices.push_back(y + v[1]);
+        m_vertices.push_back(u + v[2]);
+        m_vertices.push_back(v[3]);
+      }
+    }
+    x += CELL_W * m_scale;
+  }
+}
+
+void TextOverlay::draw(int width, int height) {
+  if (m_vertices.empty())
+    return;
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+  glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float),
+               m_vertices.data(), GL_STREAM_DRAW);
+
+  glUseProgram(m_program);
+  glUniform2f(glGetUniformLocation(m_program, "screenSize"), width, height);
+  glUniform1i(glGetUniformLocation(m_program, "font"), FONT_UNIT);
+  glActiveTexture(GL_TEXTURE0 + FONT_UNIT);
+  glBindTexture(GL_TEXTURE_2D, m_font);
+  glActiveTexture(GL_TEXTURE0);
+
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_vao);
+
+  GLint offset = glGetUniformLocation(m_program, "offset");
+  GLint color = glGetUniformLocation(m_program, "textColor");
+  GLsizei count = m_vertices.size() / 4;
+
+  glUniform2f(offset, m_scale, m_scale);
+  glUniform3f(color, 0.f, 0.f, 0.f);
+  glDrawArrays(GL_TRIANGLES, 0, count);
+  glUniform2f(offset, 0.f, 0.f);
+  glUniform3f(color, 1.f, 1.f, 0.6f);
+  glDrawArrays(GL_TRIANGLES, 0, count);
+
+  glBindVertexArray(0);
+  if (depthTest)
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,254 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	ThreadPool.cpp
+ */
+
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+namespace {
+// Pool and worker index of the current thread
+thread_local ThreadPool const *t_pool = nullptr;
+thread_local int t_index = 0;
+
+// Yields before a worker with nothing to do parks
+const int SPIN_YIELDS = 64;
+} // namespace
+
+//==================== TaskDeque ====================//
+
+ThreadPool::TaskDeque::TaskDeque() : m_ring(256), m_head(0), m_count(0) {}
+
+void ThreadPool::TaskDeque::push(Task const &t) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (m_count == m_ring.size()) {
+    std::vector<Task> grown(2 * m_ring.size());
+    for (unsigned i = 0; i < m_count; ++i)
+      grown[i] = m_ring[(m_head + i) % m_ring.size()];
+    m_ring.swap(grown);
+    m_head = 0;
+  }
+
+  m_ring[(m_head + m_count) % m_ring.size()] = t;
+  ++m_count;
+}
+
+bool ThreadPool::TaskDeque::popBack(Task &t) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_count == 0)
+    return false;
+
+  --m_count;
+  t = m_ring[(m_head + m_count) % m_ring.size()];
+  return true;
+}
+
+bool ThreadPool::TaskDeque::popFront(Task &t) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_count == 0)
+    return false;
+
+  t = m_ring[m_head];
+  m_head = (m_head + 1) % m_ring.size();
+  --m_count;
+  return true;
+}
+
+//==================== ThreadPool ====================//
+
+ThreadPool::ThreadPool(unsigned numThreads)
+    : m_numThreads(numThreads), m_queued(0), m_sleeping(0), m_quit(false) {
+  if (m_numThreads == 0)
+    m_numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  m_queues.reset(new Queue[m_numThreads]);
+  for (unsigned i = 0; i < m_numThreads; ++i)
+    m_queues[i].numPinned = 0;
+
+  for (unsigned i = 1; i < m_numThreads; ++i)
+    m_workers.emplace_back(&ThreadPool::workerLoop, this, int(i));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_parkMutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+
+  for (auto &t : m_workers)
+    t.join();
+}
+
+unsigned ThreadPool::size() const { return m_numThreads; }
+
+int ThreadPool::threadIndex() const { return t_pool == this ? t_index : 0; }
+
+// A few chunks per thread so uneven chunks still balance out
+int ThreadPool::chunkSize(int count, int grain) const {
+  grain = std::max(grain, 1);
+  if (m_workers.empty())
+    return std::max(count, 1);
+  return std::max(grain, count / int(4 * size()));
+}
+
+struct ThreadPool::RangeJob {
+  ThreadPool *pool;
+  TaskGroup *group;
+  RangeFunc const *body;
+  int begin, end, chunk;
+};
+
+// Run chunks [firstChunk, lastChunk): hand the upper half to the deque
+// until one chunk is left, then run it
+void ThreadPool::runRange(void *context, int firstChunk, int lastChunk) {
+  RangeJob *job = static_cast<RangeJob *>(context);
+
+  while (lastChunk - firstChunk > 1) {
+    int mid = (firstChunk + lastChunk) / 2;
+    job->pool->spawn(*job->group, runRange, job, mid, lastChunk);
+    lastChunk = mid;
+  }
+
+  PROFILE_SCOPE("parallelFor");
+  int lo = job->begin + firstChunk * job->chunk;
+  (*job->body)(lo, std::min(lo + job->chunk, job->end));
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain,
+                             RangeFunc const &body) {
+  int count = end - begin;
+  if (count <= 0)
+    return;
+
+  if (m_workers.empty() || count <= std::max(grain, 1)) {
+    body(begin, end);
+    return;
+  }
+
+  TaskGroup group;
+  RangeJob job = {this, &group, &body, begin, end, chunkSize(count, grain)};
+  int numChunks = (count + job.chunk - 1) / job.chunk;
+
+  runRange(&job, 0, numChunks);
+  wait(group);
+}
+
+void ThreadPool::runThreadBody(void *body, int thread, int) {
+  PROFILE_SCOPE("forEachThread");
+  (*static_cast<ThreadFunc const *>(body))(thread);
+}
+
+void ThreadPool::forEachThread(ThreadFunc const &body) {
+  if (m_workers.empty()) {
+    body(0);
+    return;
+  }
+
+  TaskGroup group;
+  for (unsigned i = 1; i < m_numThreads; ++i)
+    spawnOn(i, group, runThreadBody, (void *)&body, int(i));
+
+  body(0);
+  wait(group);
+}
+
+void ThreadPool::spawn(TaskGroup &group, TaskFunc fn, void *context, int a,
+                       int b) {
+  Task t = {fn, context, a, b, &group};
+  ++group.m_pending;
+  ++m_queued;
+  m_queues[threadIndex()].tasks.push(t);
+  wakeWorkers(false);
+}
+
+void ThreadPool::spawnOn(int thread, TaskGroup &group, TaskFunc fn,
+                         void *context, int a, int b) {
+  int target = thread % int(m_numThreads);
+  if (target == 0)
+    target = threadIndex();
+
+  Task t = {fn, context, a, b, &group};
+  ++group.m_pending;
+  m_queues[target].pinned.push(t);
+  ++m_queues[target].numPinned;
+  wakeWorkers(true);
+}
+
+void ThreadPool::wait(TaskGroup &group) {
+  int self = threadIndex();
+  while (group.m_pending.load() > 0) {
+    if (!runOne(self))
+      std::this_thread::yield();
+  }
+}
+
+void ThreadPool::wakeWorkers(bool all) {
+  if (m_sleeping.load() == 0)
+    return;
+
+  // Taking the lock orders this with a worker between checking for work
+  // and going to sleep
+  { std::lock_guard<std::mutex> lock(m_parkMutex); }
+  if (all)
+    m_wake.notify_all();
+  else
+    m_wake.notify_one();
+}
+
+// Own pinned tasks, then own deque (newest first), then steal the oldest
+// task of another thread
+bool ThreadPool::runOne(int self) {
+  Task t;
+  bool pinned = false;
+
+  if (m_queues[self].numPinned.load() > 0 &&
+      m_queues[self].pinned.popBack(t)) {
+    --m_queues[self].numPinned;
+    pinned = true;
+  } else if (!m_queues[self].tasks.popBack(t)) {
+    bool stolen = false;
+    for (unsigned k = 1; k < m_numThreads && !stolen; ++k)
+      stolen = m_queues[(self + k) % m_numThreads].tasks.popFront(t);
+    if (!stolen)
+      return false;
+  }
+
+  if (!pinned)
+    --m_queued;
+
+  t.fn(t.context, t.a, t.b);
+  --t.group->m_pending;
+  return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+  t_pool = this;
+  t_index = index;
+  Profiler::setThreadName("worker", index);
+  Queue &own = m_queues[index];
+
+  while (!m_quit.load()) {
+    if (runOne(index))
+      continue;
+
+    bool found = false;
+    for (int i = 0; i < SPIN_YIELDS && !found; ++i) {
+      std::this_thread::yield();
+      found = m_queued.load() > 0 || own.numPinned.load() > 0;
+    }
+    if (found)
+      continue;
+
+    std::unique_lock<std::mutex> lock(m_parkMutex);
+    ++m_sleeping;
+    m_wake.wait(lock, [&] {
+      return m_quit.load() || m_queued.load() > 0 ||
+             own.numPinned.load() > 0;
+    });
+    --m_sleeping;
+  }
+}
@@ -0,0 +1,252 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	TreeSolver.cpp
+ *
+ * Reference: Baraff, "Linear-Time Dynamics using Lagrange Multipliers",
+ * 1996 (tree-ordered block elimination); Baraff and Witkin, "Large Steps
+ * in Cloth Simulation", 1998 (spring force Jacobians).
+ */
+
+#include "TreeSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+TreeSolver::TreeSolver() : m_isTree(false) {}
+
+bool TreeSolver::isTree() const { return m_isTree; }
+int TreeSolver::numStrands() const { return int(m_strandStart.size()) - 1; }
+
+bool TreeSolver::rebuild(PoolVector<Mass> const &ms,
+                         PoolVector<Spring> const &ss) {
+  int nm = ms.size();
+  int ns = ss.size();
+
+  m_indexA.resize(ns);
+  m_indexB.resize(ns);
+  for (int i = 0; i < ns; ++i) {
+    m_indexA[i] = ss[i].a - ms.data();
+    m_indexB[i] = ss[i].b - ms.data();
+  }
+
+  // Adjacency between free masses (CSR)
+  std::vector<int> adjStart(nm + 1, 0);
+  for (int i = 0; i < ns; ++i) {
+    int a = m_indexA[i], b = m_indexB[i];
+    if (!ms[a].fixedPoint && !ms[b].fixedPoint) {
+      ++adjStart[a + 1];
+      ++adjStart[b + 1];
+    }
+  }
+  for (int i = 0; i < nm; ++i)
+    adjStart[i + 1] += adjStart[i];
+
+  std::vector<int> adj(adjStart[nm]);
+  std::vector<int> fill(adjStart.begin(), adjStart.end() - 1);
+  for (int i = 0; i < ns; ++i) {
+    int a = m_indexA[i], b = m_indexB[i];
+    if (!ms[a].fixedPoint && !ms[b].fixedPoint) {
+      adj[fill[a]++] = b;
+      adj[fill[b]++] = a;
+    }
+  }
+
+  // Breadth-first search per component; a component is a tree exactly
+  // when it has one edge fewer than it has masses
+  std::vector<int> strandOf(nm, -1);
+  m_parent.assign(nm, -1);
+  m_order.clear();
+  m_strandStart.assign(1, 0);
+  m_isTree = true;
+
+  for (int root = 0; root < nm; ++root) {
+    if (ms[root].fixedPoint || strandOf[root] != -1)
+      continue;
+
+    int strand = numStrands();
+    int first = m_order.size();
+    long degreeSum = 0;
+
+    strandOf[root] = strand;
+    m_order.push_back(root);
+    for (int k = first; k < int(m_order.size()); ++k) {
+      int i = m_order[k];
+      degreeSum += adjStart[i + 1] - adjStart[i];
+
+      for (int e = adjStart[i]; e < adjStart[i + 1]; ++e) {
+        int j = adj[e];
+        if (strandOf[j] == -1) {
+          strandOf[j] = strand;
+          m_parent[j] = i;
+          m_order.push_back(j);
+        }
+      }
+    }
+
+    int count = int(m_order.size()) - first;
+    if (degreeSum / 2 != count - 1)
+      m_isTree = false;
+
+    m_strandStart.push_back(m_order.size());
+  }
+
+  // Springs per strand (those touching at least one free mass)
+  int numS = numStrands();
+  m_strandSpringStart.assign(numS + 1, 0);
+  for (int i = 0; i < ns; ++i) {
+    int a = m_indexA[i], b = m_indexB[i];
+    int s = strandOf[ms[a].fixedPoint ? b : a];
+    if (s != -1)
+      ++m_strandSpringStart[s + 1];
+  }
+  for (int s = 0; s < numS; ++s)
+    m_strandSpringStart[s + 1] += m_strandSpringStart[s];
+
+  m_strandSprings.resize(m_strandSpringStart[numS]);
+  fill.assign(m_strandSpringStart.begin(), m_strandSpringStart.end() - 1);
+  for (int i = 0; i < ns; ++i) {
+    int a = m_indexA[i], b = m_indexB[i];
+    int s = strandOf[ms[a].fixedPoint ? b : a];
+    if (s != -1)
+      m_strandSprings[fill[s]++] = i;
+  }
+
+  m_diag.resize(nm);
+  m_offDiag.resize(nm);
+  m_rhs.resize(nm);
+  m_parentScratch.resize(nm);
+
+  return m_isTree;
+}
+
+void TreeSolver::remap(PoolVector<Mass> const &ms,
+                       PoolVector<Spring> const &ss,
+                       PoolVector<int> const &massIndex,
+                       PoolVector<int> const &springIndex) {
+  int nm = ms.size();
+  int ns = ss.size();
+  if (int(m_indexA.size()) != ns || int(m_parent.size()) != nm) {
+    rebuild(ms, ss);
+    return;
+  }
+
+  for (int i = 0; i < ns; ++i) {
+    m_indexA[i] = ss[i].a - ms.data();
+    m_indexB[i] = ss[i].b - ms.data();
+  }
+  for (int &i : m_order)
+    i = massIndex[i];
+  for (int &s : m_strandSprings)
+    s = springIndex[s];
+
+  for (int i = 0; i < nm; ++i)
+    m_parentScratch[massIndex[i]] =
+        m_parent[i] < 0 ? -1 : massIndex[m_parent[i]];
+  m_parent.swap(m_parentScratch);
+}
+
+void TreeSolver::step(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                      float dt, ThreadPool &pool) {
+  if (!m_isTree)
+    return;
+
+  pool.parallelFor(0, numStrands(), 1, [&](int begin, int end) {
+    for (int s = begin; s < end; ++s)
+      solveStrand(s, ms, ss, dt);
+  });
+}
+
+void TreeSolver::solveStrand(int strand, PoolVector<Mass> &ms,
+                             PoolVector<Spring> const &ss, float dt) {
+  int first = m_strandStart[strand];
+  int last = m_strandStart[strand + 1];
+  vec3 gravity = vec3(0.f, -9.81f, 0.f);
+  float h = dt;
+  float h2 = dt * dt;
+
+  // External forces and the mass/damping diagonal
+  for (int k = first; k < last; ++k) {
+    int i = m_order[k];
+    Mass const &m = ms[i];
+
+    m_diag[i] = mat3(m.mass + h * damping);
+    m_offDiag[i] = mat3(0.f);
+    m_rhs[i] = h * (m.mass * gravity - damping * m.velocity);
+  }
+
+  // Spring forces and their Jacobians. For a spring a->b with unit
+  // direction n, df_b/dx_b = Kb = -k (n n^T + max(0, 1 - L/l) (I - n n^T)).
+  // The transverse term is clamped so compressed springs stay definite.
+  for (int k = m_strandSpringStart[strand];
+       k < m_strandSpringStart[strand + 1]; ++k) {
+    int sIdx = m_strandSprings[k];
+    Spring const &s = ss[sIdx];
+    int a = m_indexA[sIdx];
+    int b = m_indexB[sIdx];
+
+    vec3 d = ms[b].position - ms[a].position;
+    float len = length(d);
+    if (len < 1e-6f)
+      continue;
+
+    vec3 n = d / len;
+    vec3 fb = (-s.stiffness) * (len - s.restLength) * n;
+
+    mat3 nn = outerProduct(n, n);
+    float transverse = std::max(0.f, 1.f - s.restLength / len);
+    mat3 Kb = (-s.stiffness) * (nn + transverse * (mat3(1.f) - nn));
+
+    vec3 dv = ms[b].velocity - ms[a].velocity;
+    bool freeA = !ms[a].fixedPoint;
+    bool freeB = !ms[b].fixedPoint;
+
+    if (freeA) {
+      m_diag[a] -= h2 * Kb;
+      m_rhs[a] += h * (-fb) - h2 * (Kb * dv);
+    }
+    if (freeB) {
+      m_diag[b] -= h2 * Kb;
+      m_rhs[b] += h * fb + h2 * (Kb * dv);
+    }
+    if (freeA && freeB) {
+      // A_ab = A_ba = h^2 Kb, stored on whichever end is the child
+      int child = (m_parent[a] == b) ? a : b;
+      m_offDiag[child] += h2 * Kb;
+    }
+  }
+
+  // Eliminate from the leaves towards the root
+  for (int k = last - 1; k > first; --k) {
+    int i = m_order[k];
+    int p = m_parent[i];
+
+    m_diag[i] = inverse(m_diag[i]);
+    mat3 T = m_offDiag[i] * m_diag[i];
+    m_diag[p] -= T * m_offDiag[i];
+    m_rhs[p] -= T * m_rhs[i];
+  }
+
+  // Back substitute from the root; m_rhs becomes dv
+  int root = m_order[first];
+  m_rhs[root] = inverse(m_diag[root]) * m_rhs[root];
+  for (int k = first + 1; k < last; ++k) {
+    int i = m_order[k];
+    m_rhs[i] = m_diag[i] * (m_rhs[i] - m_offDiag[i] * m_rhs[m_parent[i]]);
+  }
+
+  for (int k = first; k < last; ++k) {
+    int i = m_order[k];
+    Mass &m = ms[i];
+
+    m.velocity += m_rhs[i];
+    if (sim3 && m.position.y < -2.f)
+      m.velocity.y = 0.f;
+    m.position += m.velocity * dt;
+    if (sim3 && m.position.y < -2.f)
+      m.position.y = -2.f;
+    m.acc = vec3(0, 0, 0);
+  }
+}
@@ -0,0 +1,154 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	VertexQuantizer.cpp
+ */
+
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "glad/glad.h"
+
+using namespace glm;
+
+namespace {
+const int VERTEX_GRAIN = 8192;
+
+struct Box {
+  vec3 lo, hi;
+};
+} // namespace
+
+void VertexQuantizer::bounds(Vec3f const *v, int n, vec3 &lo, vec3 &hi,
+                             ThreadPool &pool) {
+  Box empty = {vec3(1e30f), vec3(-1e30f)};
+  Box box = pool.parallelReduce(
+      0, n, VERTEX_GRAIN, empty,
+      [&](int begin, int end) {
+        Box b = empty;
+        for (int i = begin; i < end; ++i) {
+          vec3 p(v[i].x(), v[i].y(), v[i].z());
+          b.lo = min(b.lo, p);
+          b.hi = max(b.hi, p);
+        }
+        return b;
+      },
+      [](Box a, Box b) {
+        Box c = {min(a.lo, b.lo), max(a.hi, b.hi)};
+        return c;
+      });
+
+  lo = box.lo;
+  hi = box.hi;
+}
+
+void VertexQuantizer::decodeParams(Format format, vec3 lo, vec3 hi,
+                                   vec3 &offset, vec3 &scale) {
+  switch (format) {
+  case UNORM16:
+    offset = lo;
+    scale = max(hi - lo, vec3(1e-6f));
+    break;
+  case HALF16:
+    offset = 0.5f * (lo + hi);
+    scale = vec3(1.f);
+    break;
+  default:
+    offset = vec3(0.f);
+    scale = vec3(1.f);
+    break;
+  }
+}
+
+void VertexQuantizer::encode(Format format, Vec3f const *v, int n,
+                             vec3 offset, vec3 scale, uint16_t *dst,
+                             ThreadPool &pool) {
+  if (format == UNORM16) {
+    vec3 toUnit = vec3(65535.f) / scale;
+
+    pool.parallelFor(0, n, VERTEX_GRAIN, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        for (int c = 0; c < 3; ++c) {
+          float q = (v[i][c] - offset[c]) * toUnit[c] + 0.5f;
+          dst[3 * i + c] = uint16_t(std::min(std::max(q, 0.f), 65535.f));
+        }
+      }
+    });
+  } else if (format == HALF16) {
+    pool.parallelFor(0, n, VERTEX_GRAIN, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        for (int c = 0; c < 3; ++c)
+          dst[3 * i + c] = toHalf(v[i][c] - offset[c]);
+      }
+    });
+  }
+}
+
+// IEEE 754 binary32 -> binary16, round to nearest even
+uint16_t VertexQuantizer::toHalf(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t mantissa = x & 0x7fffff;
+  int biased = (x >> 23) & 0xff;
+  int exponent = biased - 127 + 15;
+
+  if (biased == 0xff) // inf, nan
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  if (exponent >= 31) // overflow
+    return sign | 0x7c00;
+
+  if (exponent <= 0) {
+    // Subnormal half (or zero)
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    uint32_t h = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (h & 1)))
+      ++h;
+    return sign | h;
+  }
+
+  // A carry out of the mantissa correctly bumps the exponent
+  uint32_t h = (uint32_t(exponent) << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+    ++h;
+  return sign | h;
+}
+
+unsigned VertexQuantizer::glType(Format format) {
+  switch (format) {
+  case UNORM16:
+    return GL_UNSIGNED_SHORT;
+  case HALF16:
+    return GL_HALF_FLOAT;
+  default:
+    return GL_FLOAT;
+  }
+}
+
+bool VertexQuantizer::glNormalized(Format format) {
+  return format == UNORM16;
+}
+
+int VertexQuantizer::bytesPerVertex(Format format) {
+  return format == FLOAT32 ? 3 * sizeof(float) : 3 * sizeof(uint16_t);
+}
+
+unsigned VertexQuantizer::glTexelFormat(Format format) {
+  switch (format) {
+  case UNORM16:
+    return GL_R16;
+  case HALF16:
+    return GL_R16F;
+  default:
+    return GL_R32F;
+  }
+}
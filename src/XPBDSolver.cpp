@@ -0,0 +1,301 @@
+/**
+ * Course:	CPSC 587 Computer Animation
+ *
+ * File:	XPBDSolver.cpp
+ *
+ * Reference: Macklin, Mueller, Chentanez, "XPBD: Position-Based Simulation
+ * of Compliant Constrained Dynamics", 2016.
+ */
+
+#include "XPBDSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+namespace {
+// Springs per parallel chunk; smaller colours are projected inline
+const int PROJECT_GRAIN = 256;
+const int MASS_GRAIN = 1024;
+} // namespace
+
+XPBDSolver::XPBDSolver(int iterations)
+    : m_iterations(iterations), m_mode(GAUSS_SEIDEL), m_chebyshev(true),
+      m_tolerance(0.f), m_lastIterations(0), m_lastResidual(0.f) {}
+
+int XPBDSolver::iterations() const { return m_iterations; }
+void XPBDSolver::setIterations(int n) { m_iterations = std::max(n, 1); }
+int XPBDSolver::numColours() const { return m_colouring.numColours(); }
+
+XPBDSolver::Mode XPBDSolver::mode() const { return m_mode; }
+void XPBDSolver::setMode(Mode mode) { m_mode = mode; }
+
+bool XPBDSolver::chebyshev() const { return m_chebyshev; }
+void XPBDSolver::setChebyshev(bool on) {
+  m_chebyshev = on;
+  m_accelerator.setSpectralRadius(on ? -1.f : 0.f);
+}
+
+void XPBDSolver::setTolerance(float tol) { m_tolerance = std::max(tol, 0.f); }
+int XPBDSolver::lastIterations() const { return m_lastIterations; }
+float XPBDSolver::lastResidual() const { return m_lastResidual; }
+
+void XPBDSolver::rebuild(PoolVector<Mass> const &ms,
+                         PoolVector<Spring> const &ss) {
+  int nm = ms.size();
+  int ns = ss.size();
+
+  m_lambda.assign(ns, 0.f);
+  m_prevPosition.resize(nm);
+  buildIndices(ms, ss);
+
+  m_colouring.rebuild(ms, ss);
+
+  m_state.resize(3 * nm + ns);
+  m_correction.resize(ns);
+  m_accelerator.reset();
+}
+
+void XPBDSolver::remap(PoolVector<Mass> const &ms,
+                       PoolVector<Spring> const &ss,
+                       PoolVector<int> const &springIndex) {
+  if (m_indexA.size() != ss.size() || m_invMass.size() != ms.size()) {
+    rebuild(ms, ss);
+    return;
+  }
+
+  m_colouring.remap(springIndex);
+  buildIndices(ms, ss);
+}
+
+void XPBDSolver::buildIndices(PoolVector<Mass> const &ms,
+                              PoolVector<Spring> const &ss) {
+  int nm = ms.size();
+  int ns = ss.size();
+
+  m_indexA.resize(ns);
+  m_indexB.resize(ns);
+  m_invMass.resize(nm);
+
+  for (int i = 0; i < nm; ++i)
+    m_invMass[i] = ms[i].fixedPoint ? 0.f : 1.f / ms[i].mass;
+
+  for (int i = 0; i < ns; ++i) {
+    m_indexA[i] = ss[i].a - ms.data();
+    m_indexB[i] = ss[i].b - ms.data();
+  }
+
+  // Mass -> spring incidence for the Jacobi gather
+  m_incidentStart.assign(nm + 1, 0);
+  for (int i = 0; i < ns; ++i) {
+    ++m_incidentStart[m_indexA[i] + 1];
+    ++m_incidentStart[m_indexB[i] + 1];
+  }
+  for (int i = 0; i < nm; ++i)
+    m_incidentStart[i + 1] += m_incidentStart[i];
+
+  m_fill.assign(m_incidentStart.begin(), m_incidentStart.end() - 1);
+  m_incident.resize(2 * ns);
+  for (int i = 0; i < ns; ++i) {
+    m_incident[m_fill[m_indexA[i]]++] = 2 * i;
+    m_incident[m_fill[m_indexB[i]]++] = 2 * i + 1;
+  }
+}
+
+void XPBDSolver::step(PoolVector<Mass> &ms, PoolVector<Spring> &ss,
+                      float dt, ThreadPool &pool) {
+  if (m_indexA.size() != ss.size() || m_invMass.size() != ms.size())
+    rebuild(ms, ss);
+
+  int nm = ms.size();
+  vec3 gravity = vec3(0.f, -9.81f, 0.f);
+
+  // Predict positions from external forces (gravity and damping)
+  pool.parallelFor(0, nm, MASS_GRAIN, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      Mass &m = ms[i];
+      m_prevPosition[i] = m.position;
+      m.acc = vec3(0, 0, 0);
+
+      if (m.fixedPoint)
+        continue;
+
+      vec3 vDamping = ((-damping) * m.velocity) / m.mass;
+      m.velocity = m.velocity + (gravity + vDamping) * dt;
+      m.position = m.position + m.velocity * dt;
+    }
+  });
+
+  std::fill(m_lambda.begin(), m_lambda.end(), 0.f);
+
+  // Compliance alpha = 1/k, scaled by the time step
+  float invDt2 = 1.f / (dt * dt);
+
+  if (m_mode == JACOBI)
+    solveJacobi(ms, ss, invDt2, pool);
+  else
+    solveGaussSeidel(ms, ss, invDt2, pool);
+
+  // Velocities from the corrected positions
+  float invDt = 1.f / dt;
+  pool.parallelFor(0, nm, MASS_GRAIN, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      Mass &m = ms[i];
+      if (m.fixedPoint)
+        continue;
+
+      m.velocity = (m.position - m_prevPosition[i]) * invDt;
+      if (sim3 && m.position.y <= -2.f)
+        m.velocity.y = 0.f;
+    }
+  });
+}
+
+void XPBDSolver::solveGaussSeidel(PoolVector<Mass> &ms,
+                                  PoolVector<Spring> const &ss, float invDt2,
+                                  ThreadPool &pool) {
+  int nm = ms.size();
+
+  for (int it = 0; it < m_iterations; ++it) {
+    for (int c = 0; c < numColours(); ++c)
+      projectColour(c, ms, ss, invDt2, pool);
+
+    if (sim3) {
+      for (int i = 0; i < nm; ++i) {
+        if (ms[i].position.y < -2.f)
+          ms[i].position.y = -2.f;
+      }
+    }
+  }
+
+  m_lastIterations = m_iterations;
+  m_lastResidual = 0.f;
+}
+
+void XPBDSolver::solveJacobi(PoolVector<Mass> &ms,
+                             PoolVector<Spring> const &ss, float invDt2,
+                             ThreadPool &pool) {
+  int nm = ms.size();
+  int ns = ss.size();
+  int n = m_state.size();
+  float *x = m_state.data();
+  float *lambda = x + 3 * nm;
+
+  for (int i = 0; i < nm; ++i) {
+    x[3 * i + 0] = ms[i].position.x;
+    x[3 * i + 1] = ms[i].position.y;
+    x[3 * i + 2] = ms[i].position.z;
+  }
+  std::fill(lambda, lambda + ns, 0.f);
+
+  m_accelerator.begin(x, n);
+
+  int it = 0;
+  float residual = 0.f;
+  while (it < m_iterations) {
+    // Every spring projects against the same positions
+    pool.parallelFor(0, ns, PROJECT_GRAIN, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        int ia = m_indexA[i];
+        int ib = m_indexB[i];
+        float wa = m_invMass[ia];
+        float wb = m_invMass[ib];
+        float alphaTilde = invDt2 / ss[i].stiffness;
+
+        m_correction[i] = vec3(0, 0, 0);
+
+        float w = wa + wb + alphaTilde;
+        if (w <= 0.f)
+          continue;
+
+        vec3 pa(x[3 * ia], x[3 * ia + 1], x[3 * ia + 2]);
+        vec3 pb(x[3 * ib], x[3 * ib + 1], x[3 * ib + 2]);
+        vec3 d = pb - pa;
+        float len = length(d);
+        if (len < 1e-6f)
+          continue;
+
+        float C = len - ss[i].restLength;
+        float dLambda = (-C - alphaTilde * lambda[i]) / w;
+        lambda[i] += dLambda;
+        m_correction[i] = (dLambda / len) * d;
+      }
+    });
+
+    // Gather and average the corrections touching each mass
+    pool.parallelFor(0, nm, MASS_GRAIN, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        int first = m_incidentStart[i];
+        int last = m_incidentStart[i + 1];
+        if (m_invMass[i] == 0.f || first == last)
+          continue;
+
+        vec3 delta(0, 0, 0);
+        for (int k = first; k < last; ++k) {
+          int e = m_incident[k];
+          if (e & 1)
+            delta += m_correction[e >> 1];
+          else
+            delta -= m_correction[e >> 1];
+        }
+        delta *= m_invMass[i] / float(last - first);
+
+        x[3 * i + 0] += delta.x;
+        x[3 * i + 1] += delta.y;
+        x[3 * i + 2] += delta.z;
+        if (sim3 && x[3 * i + 1] < -2.f)
+          x[3 * i + 1] = -2.f;
+      }
+    });
+
+    residual = m_accelerator.update(x, n, pool);
+    ++it;
+
+    if (residual < m_tolerance)
+      break;
+  }
+
+  for (int i = 0; i < nm; ++i) {
+    ms[i].position = vec3(x[3 * i], x[3 * i + 1], x[3 * i + 2]);
+    if (sim3 && ms[i].position.y < -2.f)
+      ms[i].position.y = -2.f;
+  }
+
+  m_lastIterations = it;
+  m_lastResidual = residual;
+}
+
+void XPBDSolver::projectColour(int colour, PoolVector<Mass> &ms,
+                               PoolVector<Spring> const &ss, float invDt2,
+                               ThreadPool &pool) {
+  pool.parallelFor(
+      m_colouring.colourStart(colour), m_colouring.colourStart(colour + 1),
+      PROJECT_GRAIN, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+          int i = m_colouring.spring(k);
+          int ia = m_indexA[i];
+          int ib = m_indexB[i];
+          float wa = m_invMass[ia];
+          float wb = m_invMass[ib];
+          float alphaTilde = invDt2 / ss[i].stiffness;
+
+          float w = wa + wb + alphaTilde;
+          if (w <= 0.f)
+            continue;
+
+          vec3 d = ms[ib].position - ms[ia].position;
+          float len = length(d);
+          if (len < 1e-6f)
+            continue;
+
+          vec3 n = d / len;
+          float C = len - ss[i].restLength;
+          float dLambda = (-C - alphaTilde * m_lambda[i]) / w;
+          m_lambda[i] += dLambda;
+
+          ms[ia].position -= (wa * dLambda) * n;
+          ms[ib].position += (wb * dLambda) * n;
+        }
+      });
+}
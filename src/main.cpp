@@ -12,6 +12,8 @@
  * 2. Chain pendulum
  * 3. Jello cube
  * 4. Hanging cloth
+ * 5. Long rope
+ * 6. Hair (batched strands)
  * 
  */
 
@@ -22,16 +24,48 @@
 #include <vector>
 #include <array>
 #include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "glm/glm.hpp"
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 
+#include "AllocCounter.h"
+#include "BufferPool.h"
+#include "NumaPlacement.h"
 #include "ShaderTools.h"
+#include "SkinnedMesh.h"
 #include "Vec3f.h"
 #include "Mat4f.h"
 #include "OpenGLMatrixTools.h"
 #include "Camera.h"
+#include "ChunkCuller.h"
+#include "DomainSolver.h"
+#include "FrameRecorder.h"
+#include "FusedForceSolver.h"
+#include "GpuTimer.h"
+#include "GraphPartitioner.h"
+#include "HeadlessContext.h"
+#include "MassSpringSystem.h"
+#include "PerfCounters.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include "SimdKernels.h"
+#include "SpatialReorder.h"
+#include "SpringColouring.h"
+#include "TaskGraph.h"
+#include "TextOverlay.h"
+#include "ThreadPool.h"
+#include "TreeSolver.h"
+#include "TripleBuffer.h"
+#include "VertexQuantizer.h"
+#include "XPBDSolver.h"
 
 #define PI 3.14159265359
 
@@ -45,17 +79,30 @@ using namespace glm;
 
 // Drawing Program
 GLuint basicProgramID;
+GLuint strainProgramID;
+GLuint skinProgramID;
 
 // Data needed for Quad
 GLuint vaoID;
 GLuint vertBufferID;
+GLuint indexBufferID; // LOD order of one chunk (ChunkCuller)
 Mat4f M;
 
 // Data needed for Line 
 GLuint line_vaoID;
 GLuint line_vertBufferID;
+GLuint line_restBufferID;   // rest length per line vertex (attribute 1)
+GLuint line_positionTexID;  // line_vertBufferID as a texture buffer
+GLuint line_indexBufferID;
 Mat4f line_M;
 
+// Data needed for the skinned mesh
+GLuint skin_vaoID;
+GLuint skin_vertBufferID;  // static SkinnedMesh vertices
+GLuint skin_indexBufferID;
+GLuint skin_gridBufferID;  // coarse positions, every frame
+GLuint skin_gridTexID;     // skin_gridBufferID as a texture buffer
+
 // Only one camera so only one view and perspective matrix are needed.
 Mat4f V;
 Mat4f P;
@@ -63,6 +110,7 @@ Mat4f P;
 // Only one thing is rendered at a time, so only need one MVP
 // When drawing different objects, update M and MVP = M * V * P
 Mat4f MVP;
+Mat4f PV; // P * V, reused every frame so drawing does not allocate
 
 // Camera and viewing Stuff
 Camera camera;
@@ -79,27 +127,190 @@ float g_cursorX, g_cursorY;
 
 bool g_play = false;
 
+// Solver selection: force-based (applyForces/resolveForces), XPBD, or the
+// implicit tree solver (only for scenes without spring loops)
+enum Solver { FORCE_SOLVER, XPBD_SOLVER, TREE_SOLVER };
+Solver g_solver = FORCE_SOLVER;
+ThreadPool threadPool;
+// Spring colours of the force-based paths, so their force pass runs on
+// every thread without atomics
+SpringColouring forceColouring;
+// Masses per task in the collision and integration passes
+const int MASS_GRAIN = 1024;
+XPBDSolver xpbd;
+TreeSolver treeSolver;
+
+// Current simulation, and whether sims 3 and 4 use the stencil lattice
+int g_sim = 1;
+bool g_lattice = false;
+
+// Space-filling-curve order of the masses: off, Morton or Hilbert.
+// While on, the scene is re-sorted every g_reorderInterval frames. The
+// re-sort only remaps the solver in use; the XPBD and tree solvers are
+// marked stale instead and rebuilt when they are switched to.
+enum Reorder { REORDER_OFF, REORDER_MORTON, REORDER_HILBERT };
+Reorder g_reorder = REORDER_OFF;
+int g_reorderInterval = 300;
+SpatialReorder reorder;
+bool g_xpbdStale = false;
+bool g_treeStale = false;
+
+// Force solver split into per-thread domains of a graph partition
+bool g_partition = false;
+GraphPartitioner partitioner;
+DomainSolver domains;
+
+// --numa: partitioned solver with pinned threads, and each domain's masses
+// and springs moved to its thread's node after every rebuild. Placement
+// runs on the stepping thread, so sceneChanged only requests it.
+bool g_numa = false;
+bool g_placeDomains = false;
+
+// Force solver with integration and packing fused into one pass that
+// writes the render format directly (into the mapped GL buffers when
+// running --serial). g_packLines/g_packQuads are its destination.
+bool g_fused = false;
+FusedForceSolver fused;
+float *g_packLines = nullptr;
+float *g_packQuads = nullptr;
+
 int WIN_WIDTH = 800, WIN_HEIGHT = 800;
 int FB_WIDTH = 800, FB_HEIGHT = 600;
 float WIN_FOV = 60;
 float WIN_NEAR = 0.01;
 float WIN_FAR = 1000;
 
-int numMass = 2;
-int numSpring = 1;
+// Render-format snapshot of one simulated frame: the spring lines and
+// the quads drawn at the masses. In a compact vertex format the packed
+// arrays are uploaded and decoded with offset + scale * attribute.
+struct Frame {
+  vector<Vec3f> lines;
+  vector<Vec3f> quads;
+
+  VertexQuantizer::Format format;
+  vec3 offset, scale;
+  vector<uint16_t> packedLines;
+  vector<uint16_t> packedQuads;
 
-float damping = 0.8f;
-float timestep = 0.01f;
+  // Rest lengths of the scene the frame belongs to (shared, not copied)
+  std::shared_ptr<vector<float> const> restLengths;
+  int restVersion;
 
-bool sim3;
+  // Chunk bounds for culling (empty when culling is off)
+  vector<ChunkCuller::Box> lineChunks;
+  vector<ChunkCuller::Box> quadChunks;
+
+  // Coarse positions in grid order for the skinned mesh (empty when off)
+  ivec3 grid;
+  vector<Vec3f> gridPositions;
+
+  // CPU time of simulateFrame, for the overlay
+  float simMs;
+};
 
-vector<Vec3f> verts;
-vector<Vec3f> verts2;
+// Physics runs on its own thread (unless started with --serial) and hands
+// finished frames to the render thread through a triple buffer, so frame
+// N+1 is simulated while frame N is drawn. Key commands that change the
+// scene are queued and run by the physics thread between steps.
+TripleBuffer<Frame> g_frames;
+bool g_pipeline = true;
+std::thread g_physicsThread;
+std::mutex g_physicsMutex;
+std::condition_variable g_physicsWake;
+bool g_running = true;
+bool g_frameTaken = true; // the display has picked up the last frame
+vector<std::function<void()>> g_commands;
+
+// Vertex counts of the uploaded frame
+int g_lineVerts = 0;
+int g_quadVerts = 0;
+
+// Upload format chosen with U (physics side), and the format the VAOs
+// are set up for plus its decode parameters (render side)
+VertexQuantizer::Format g_format = VertexQuantizer::FLOAT32;
+VertexQuantizer::Format g_vertexFormat = VertexQuantizer::FLOAT32;
+vec3 g_positionOffset(0.f);
+vec3 g_positionScale(1.f);
+
+// Lines coloured by strain (V). The rest length of every line vertex is
+// rebuilt with the scene (physics side) and uploaded to a static buffer
+// only when its version changes (render side); strain_vs.glsl computes
+// the strain from the same position buffer the plain lines use.
+bool g_strain = false;
+float g_strainRange = 0.05f;
+std::shared_ptr<vector<float> const> g_restLengths;
+int g_restVersion = 0;
+// Two buffers, so a re-sort refills the one no frame holds any more
+// instead of allocating a new one
+std::shared_ptr<vector<float>> g_restBuffers[2];
+int g_uploadedRestVersion = -1;
+
+// Chunked frustum culling and distance LOD (C). The physics side adds
+// chunk bounds to each frame while g_cull is on; the render side culls
+// whenever the uploaded frame has them.
+bool g_cull = false;
+// Mass order to go back to when culling is turned off
+Reorder g_reorderBeforeCull = REORDER_OFF;
+ChunkCuller culler;
+vector<ChunkCuller::Box> g_lineChunks;
+vector<ChunkCuller::Box> g_quadChunks;
+ChunkCuller::DrawList g_lineDraws;
+ChunkCuller::DrawList g_quadDraws;
+
+// Fine surface skinned to the mass grid of sims 3 and 4, drawn instead of
+// the quads (M). Only the grid positions are sent each frame.
+const int SKIN_SUBDIVISIONS = 16;
+bool g_skin = false;
+SkinnedMesh skinMesh;
+int g_skinIndices = 0;
+vector<Vec3f> g_mappedGrid; // gridPositions for simulateMapped
+
+// Offscreen recording of every simulated frame (--record), optionally
+// without a window (--headless) and for a fixed number of frames
+FrameRecorder recorder;
+bool g_headless = false;
+string g_recordTarget;
+int g_maxFrames = 0; // 0: until the window is closed
+const int RECORD_SAMPLES = 4;
+
+// Recording without any GL (--software): frames are drawn by the CPU
+// rasterizer instead, for machines with neither a GPU nor EGL
+bool g_software = false;
+
+// Frame-time overlay (H, or --overlay at start): CPU time of the step and
+// of the upload, GPU time of the two passes from timer queries, FPS and
+// counts. Drawn into the frame, so recordings include it.
+enum { GPU_MASSES, GPU_SPRINGS, GPU_PASSES };
+bool g_overlay = false;
+GpuTimer gpuTimer;
+TextOverlay overlay;
+float g_simMs = 0.f;
+float g_uploadMs = 0.f;
+
+// Scoped timers (--profile trace.json): a per-phase summary is printed and
+// a Chrome trace written on exit
+string g_profileTarget;
+
+// Hardware counters per step phase (--perf), reported on exit. The plain
+// force path tests floor contacts in a pass of its own so collision shows
+// up as a phase, with the results in the step arena.
+bool g_perf = false;
+
+// Heap allocations per frame and phase, printed on exit (--allocs), and
+// the steady-state check (--alloc-check): after the warm-up frames have
+// sized every buffer, any allocation aborts. Both need make ALLOCS=1.
+bool g_allocReport = false;
+bool g_allocCheck = false;
+const int ALLOC_WARMUP_FRAMES = 10;
+// Pooled buffers bypass operator new; the check compares the pool's
+// system allocations against the count after the warm-up instead
+int64_t g_poolAllocations = 0;
 
 //==================== FUNCTION DECLARATIONS ====================//
 void displayFunc();
 void resizeFunc();
 void init();
+void initView();
 void generateIDs();
 void deleteIDs();
 void setupVAO();
@@ -119,530 +330,381 @@ void windowMouseMotionFunc(GLFWwindow *window, double x, double y);
 void windowKeyFunc(GLFWwindow *window, int key, int scancode, int action,
                    int mods);
 void moveCamera();
+void loadSim(int n);
+void stepSimulation();
+bool fusedActive();
+void simulateFrame(Frame &f);
+void simulateMapped();
+void packFrame(Frame &f);
+void encodeFrame(Frame &f);
+void useVertexFormat(VertexQuantizer::Format format);
+void uploadFrame(Frame const &f);
+void uploadRestLengths(std::shared_ptr<vector<float> const> const &rest,
+                       int version);
+void packRestLengths();
+void packGrid(ivec3 &grid, vector<Vec3f> &positions);
+void uploadGrid(ivec3 grid, vector<Vec3f> const &positions);
+void pinThreads();
+void physicsLoop();
+void runCommand(std::function<void()> const &command);
+void reorderMasses();
+void resortMasses();
+std::shared_ptr<vector<float>> &spareRestBuffer();
+void partitionMasses();
+void sceneChanged();
 void reloadMVPUniform();
 void reloadColorUniform(float r, float g, float b);
+void reloadPositionUniforms();
+void reloadStrainUniforms();
+void reloadSkinUniforms();
+void drawChunks(GLenum mode, vector<ChunkCuller::Box> const &chunks,
+                int numElements, int vertsPerElement,
+                ChunkCuller::DrawList &draws);
 string GL_ERROR();
+void drawOverlay();
+float millisecondsSince(std::chrono::steady_clock::time_point start);
+void startAllocCount();
+bool finishProfile();
+int softwareMain(int sim);
+bool writeSoftwareFrame(SoftwareRasterizer const &image, FILE *pipe,
+                        string const &pattern, int index);
 int main(int, char **);
 
 //==================== FUNCTION DEFINITIONS ====================//
-struct Mass
-{
-	float mass;
-	bool fixedPoint;
-	
-	vec3 position;
-	vec3 velocity;
-	vec3 acc;
-};
 
-struct Spring
-{
-	Mass *a, *b;
-	float stiffness;
-	float restLength;
-};
+void displayFunc() {
+  PROFILE_SCOPE("display");
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-vector<Mass> masses;
-vector<Spring> springs;
+  if (g_overlay) {
+    gpuTimer.beginFrame();
+    gpuTimer.begin(GPU_MASSES);
+  }
 
-//Masses and Spring for sim1
-Mass m;
-Spring s;
+  // Use our shader
+  glUseProgram(basicProgramID);
+  reloadPositionUniforms();
 
-//Masses and Springs for sim2
-Mass mChain;
-Spring sChain;
+  Vec3f eye = camera.position();
+  Mat4f::multiply(P, V, PV);
+  culler.setView(PV, vec3(eye.x(), eye.y(), eye.z()));
 
-//Masses and springs for sim3
-Mass mCube;
-Spring sCube;
+  // ===== DRAW QUAD ====== //
+  Mat4f::multiply(PV, M, MVP);
+  if (g_skinIndices > 0) {
+    // Skinned surface in place of the quads
+    reloadSkinUniforms();
+    glBindVertexArray(skin_vaoID);
+    glDrawElements(GL_TRIANGLES, g_skinIndices, GL_UNSIGNED_INT, (void *)0);
+  } else {
+    reloadMVPUniform();
+    reloadColorUniform(0, 0, 1);
 
-//Masses and springs for sim4
-Mass mCloth;
-Spring sCloth;
+    // Use VAO that holds buffer bindings
+    // and attribute config of buffers
+    glBindVertexArray(vaoID);
+    // Draw Quads, 6 vertices per mass
+    drawChunks(GL_TRIANGLES, g_quadChunks, g_quadVerts / 6, 6, g_quadDraws);
+  }
 
-//Get length between masses
-float getLength(Mass *a, Mass *b)
-{
-	float length1 = ((b->position.x)-(a->position.x))*((b->position.x)-(a->position.x));
-	float length2 = ((b->position.y)-(a->position.y))*((b->position.y)-(a->position.y));
-	float length3 = ((b->position.z)-(a->position.z))*((b->position.z)-(a->position.z));	
-	float springLength = sqrt(length1 + length2 + length3);
-	
-	return springLength;
+  if (g_overlay) {
+    gpuTimer.end();
+    gpuTimer.begin(GPU_SPRINGS);
+  }
+
+  // ==== DRAW LINE ===== //
+  Mat4f::multiply(PV, line_M, MVP);
+  reloadMVPUniform();
+
+  reloadColorUniform(0, 1, 1);
+
+  if (g_strain)
+    reloadStrainUniforms();
+
+  // Use VAO that holds buffer bindings
+  // and attribute config of buffers
+  glBindVertexArray(line_vaoID);
+  // Draw lines
+  drawChunks(GL_LINES, g_lineChunks, g_lineVerts / 2, 2, g_lineDraws);
+
+  if (g_overlay)
+    gpuTimer.end();
 }
 
-//Initialize masses
-Mass initMass(Mass ms, float weight, bool fix, vec3 pos)
-{
-	ms.mass = weight;
-	ms.fixedPoint = fix;
-	ms.position = pos;
-	ms.velocity = vec3(0,0,0);
-	ms.acc = vec3(0,0,0);
-	
-	return ms;
-} 
+// Timings and counts in the top left corner
+void drawOverlay() {
+  static auto fpsStart = std::chrono::steady_clock::now();
+  static int fpsFrames = 0;
+  static float fps = 0.f;
+
+  ++fpsFrames;
+  float elapsed = millisecondsSince(fpsStart);
+  if (elapsed >= 500.f) {
+    fps = 1000.f * fpsFrames / elapsed;
+    fpsFrames = 0;
+    fpsStart = std::chrono::steady_clock::now();
+  }
 
-//Initialize springs
-Spring initSpring(Spring ss, Mass *a, Mass *b, float k, float rLen)
-{
-	ss.a = a;
-	ss.b = b;
-	ss.stiffness = k;
-	ss.restLength = rLen;
-	
-	return ss;
+  // -1 until the first query result is in
+  float gpuMasses = std::max(gpuTimer.milliseconds(GPU_MASSES), 0.f);
+  float gpuSprings = std::max(gpuTimer.milliseconds(GPU_SPRINGS), 0.f);
+
+  char lines[4][96];
+  std::snprintf(lines[0], sizeof(lines[0]), "%.1f fps  %.2f ms", fps,
+                fps > 0.f ? 1000.f / fps : 0.f);
+  std::snprintf(lines[1], sizeof(lines[1]), "cpu sim %.2f ms  upload %.2f ms",
+                g_simMs, g_uploadMs);
+  std::snprintf(lines[2], sizeof(lines[2]),
+                "gpu masses %.2f ms  springs %.2f ms", gpuMasses, gpuSprings);
+  std::snprintf(lines[3], sizeof(lines[3]), "%d masses  %d springs",
+                g_quadVerts / 6, g_lineVerts / 2);
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  overlay.clear();
+  for (int i = 0; i < 4; ++i)
+    overlay.print(8, 8 + i * overlay.lineHeight(), lines[i]);
+  overlay.draw(viewport[2], viewport[3]);
 }
 
-//Single spring
-void initSim1()
-{
-	masses.clear();
-	springs.clear();
-	
-	m = initMass(m, 1.f, true, vec3(0,3.5f,0));
-	masses.push_back(m);
-	masses[0] = m;
-	
-	m = initMass(m, 1.f, false, vec3(2.f,2.f,0));	
-	masses.push_back(m);
-	masses[1] = m;
-	
-	s = initSpring(s, &masses[0], &masses[1], 25.f, 1.f);	
-	springs.push_back(s);
-	springs[0] = s;
+float millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<float, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Draw the elements of the bound VAO, only the visible chunks at their
+// LOD if the frame has chunk bounds
+void drawChunks(GLenum mode, vector<ChunkCuller::Box> const &chunks,
+                int numElements, int vertsPerElement,
+                ChunkCuller::DrawList &draws) {
+  if (chunks.empty()) {
+    glDrawArrays(mode, 0, numElements * vertsPerElement);
+    return;
+  }
 
-	numMass = masses.size();
-	numSpring = springs.size();
-	sim3 = false;
+  culler.select(chunks, numElements, vertsPerElement, draws);
+  if (!draws.counts.empty())
+    glMultiDrawElementsBaseVertex(mode, draws.counts.data(), GL_UNSIGNED_SHORT,
+                                  draws.indices.data(), draws.counts.size(),
+                                  draws.baseVertex.data());
+  if (draws.tailCount > 0)
+    glDrawArrays(mode, draws.tailFirst, draws.tailCount);
 }
 
-//Chain pendulum
-void initSim2()
+void animateLattice(Frame &f)
 {
-	masses.clear();
-	springs.clear();
-	
-	mChain = initMass(mChain, 1.f, true, vec3(0,3.5f,0));	
-	masses.push_back(mChain);
-	masses[0] = mChain;
-	
-	mChain = initMass(mChain, 0.5f, false, vec3(0,3.f,0));		
-	masses.push_back(mChain);
-	masses[1] = mChain;
+	lattice.packLines(f.lines);
 	
-	mChain = initMass(mChain, 0.5f, false, vec3(0.5f,3.5f,0));	
-	masses.push_back(mChain);		
-	masses[2] = mChain;
-	
-	mChain = initMass(mChain, 1.5f, false, vec3(1.f,3.5f,0));	
-	masses.push_back(mChain);		
-	masses[3] = mChain;
+	f.quads.resize(6*lattice.size());
+	for(int i = 0; i < lattice.size(); i++)
+	{
+		vec3 p = lattice.position(i);
+		Vec3f *q = &f.quads[6*i];
+		
+		q[0].set(p.x-0.05f, p.y-0.05f, p.z);
+		q[1].set(p.x-0.05f, p.y+0.05f, p.z);
+		q[2].set(p.x+0.05f, p.y-0.05f, p.z);
+		q[3].set(p.x+0.05f, p.y+0.05f, p.z);
+		q[4].set(p.x-0.05f, p.y+0.05f, p.z);
+		q[5].set(p.x+0.05f, p.y-0.05f, p.z);
+	}
+}
 
-	sChain = initSpring(sChain, &masses[0], &masses[1], 25.f, 1.f);	
-	springs.push_back(sChain);	
-	springs[0] = sChain;
-	
-	sChain = initSpring(sChain, &masses[1], &masses[2], 25.f, 1.f);	
-	springs.push_back(sChain);		
-    springs[1] = sChain;
-	
-	sChain = initSpring(sChain, &masses[2], &masses[3], 25.f, 1.f);	
-	springs.push_back(sChain);		
-	springs[2] = sChain;
-	
-	numMass = masses.size();
-	numSpring = springs.size();
-	sim3 = false;
+void animateStrands(Frame &f)
+{
+	strands.packLines(f.lines, threadPool);
 }
 
-//Jello cube
-void initSim3()
+// Copy the current scene into a frame in the render format
+void packFrame(Frame &f)
 {
-	masses.clear();
-	springs.clear();
+	PROFILE_SCOPE("pack");
+	PERF_PHASE("packing");
+	f.lines.clear();
+	f.quads.clear();
 	
-	int count = 1;
-	int count2 = 1;
-	
-	//Size of cube
-	int numCube = 5;
-	numMass = numCube*numCube*numCube;
-	
-	//Mass coordinates
-	float originalX = -2.f;
-	float x = originalX;
-	float originalY = 5.5f;
-	float y = originalY;
-	float z = 0;
-	
-	//Size of gap between masses
-	float space = 1.f;
-	
-	//Spring stiffness + restlength
-	float k = 1000;
-	float rLen = 0;
-		
-	//Initialize the masses
-	for(int i = 0; i < numMass; i++)
-	{		
-		mCube = initMass(mCube, 1.f, false, vec3(x,y,z));
-		masses.push_back(mCube);
-		masses[i] = mCube;
-		x += space;
-		
-		//Initialize mass positions
-		if(i == (count*numCube - 1))
-		{
-			if(i/(numCube*numCube*count2 - 1) == 1)
-			{
-				//Move to a new row (Z axis)
-				x = originalX;
-				y = originalY;
-				z = z - space;
-				
-				count2++;
-				count++;					
-			}
-			//Move to a new row (Y axis)
-			else
-			{
-				x = originalX;
-				y = y - space;
-				
-				count++;
-			}
-		}
-	}	
-	
-	//Initialize the springs
-	int m = 0;
-	for(int i = 0; i < numMass; i++)
+	if(strands.numStrands() > 0)
+		animateStrands(f);
+	else if(lattice.size() > 0)
+		animateLattice(f);
+	else
 	{
-		for(int j = 0; j < numMass; j++)
-		{
-			rLen = getLength(&masses[i], &masses[j]);
-			
-			//X axis
-			if(masses[i].position.x - masses[j].position.x == space && masses[i].position.y == masses[j].position.y)
-			{
-				if(masses[i].position.z == masses[j].position.z)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;
-				}
-			}
-						
-			//Y axis
-			if(masses[i].position.y - masses[j].position.y == space && masses[i].position.z == masses[j].position.z)
-			{
-				if(masses[i].position.x == masses[j].position.x)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;
-				}
-			}	
-			
-			//Z axis
-			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.y == masses[j].position.y)
-			{
-				if(masses[i].position.x == masses[j].position.x)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;	
-				}
-			}
-			
-			//Side crosses
-			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.y - masses[j].position.y == space)
-			{
-				if(masses[i].position.x == masses[j].position.x)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;		
-				}
-			}			
-			
-			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.y - masses[j].position.y == -space)
-			{
-				if(masses[i].position.x == masses[j].position.x)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;	
-				}
-			}		
-		
-			//Horizontal crosses
-			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.x - masses[j].position.x == space)
-			{
-				if(masses[i].position.y == masses[j].position.y)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;	
-				}
-			}			
-			
-			if(masses[i].position.z - masses[j].position.z == space && masses[i].position.x - masses[j].position.x == -space)
-			{
-				if(masses[i].position.y == masses[j].position.y)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;	
-				}
-			}			
-			
-			//Front and back crosses
-			if(masses[i].position.x - masses[j].position.x == space && masses[i].position.y - masses[j].position.y == space)
-			{
-				if(masses[i].position.z == masses[j].position.z)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;	
-				}
-			}			
-			
-			if(masses[i].position.x - masses[j].position.x == space && masses[i].position.y - masses[j].position.y == -space)
-			{
-				if(masses[i].position.z == masses[j].position.z)
-				{
-					sCube = initSpring(sCube, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCube);	
-					springs[m] = sCube;
-					m++;		
-				}
-			} 				
-		}	
+		// Both endpoints of each spring, and two triangles per mass
+		SimdKernels::Table const &simd = SimdKernels::get();
+		f.lines.resize(2*numSpring);
+		f.quads.resize(6*numMass);
+		simd.packSpringLines(springs.data(), numSpring,
+							 reinterpret_cast<float *>(f.lines.data()));
+		simd.packQuads(masses.data(), numMass, 0.05f,
+					   reinterpret_cast<float *>(f.quads.data()));
 	}
-	
-	numSpring = springs.size();
-	sim3 = true;
 }
 
-//Hanging cloth
-void initSim4()
+// Quantise the frame for upload if a compact vertex format is selected
+void encodeFrame(Frame &f)
 {
-	masses.clear();
-	springs.clear(); 
-	
-	int count = 1;
-	
-	//Size of cloth
-	int numCloth = 11;
-	int numRows = 7;
-	numMass = numCloth*numRows;
-	
-	//Mass coordinates
-	float originalX = -2.5f;
-	float x = originalX;
-	float y = 3.5f;
-	float z = 0;
-	
-	//Size of gap between masses
-	float xSpace = 0.5f;
-	float zSpace = 1.0f;
+	PROFILE_SCOPE("encode");
+	f.format = g_format;
+	if(g_format == VertexQuantizer::FLOAT32)
+	{
+		f.offset = vec3(0.f);
+		f.scale = vec3(1.f);
+		return;
+	}
 	
-	//Spring stiffness + rest length
-	float k = 200;
-	float rLen = 0;
+	// One box around lines and quads so both draws share the decode
+	vec3 lo, hi, quadLo, quadHi;
+	VertexQuantizer::bounds(f.lines.data(), f.lines.size(), lo, hi, threadPool);
+	VertexQuantizer::bounds(f.quads.data(), f.quads.size(), quadLo, quadHi,
+							threadPool);
+	VertexQuantizer::decodeParams(g_format, min(lo, quadLo), max(hi, quadHi),
+								  f.offset, f.scale);
 	
-	//Initialize the masses
-	for(int i = 0; i < numMass; i++)
-	{	
-		//Initialize fixed points
-		if(i % 2 == 0 && i < numCloth)
-			mCloth = initMass(mCloth, 1.f, true, vec3(x,y,z));
-		//Initialize loose points
-		else
-			mCloth = initMass(mCloth, 1.f, false, vec3(x,y,z));
-		
-		masses.push_back(mCloth);
-		masses[i] = mCloth;	
-		x += xSpace;
-		
-		//Move to a new row (Z axis)
-		if(i == (count*numCloth - 1))
-		{
-			x = originalX;
-			z = z - zSpace;
-			count++;
-		}
+	f.packedLines.resize(3*f.lines.size());
+	f.packedQuads.resize(3*f.quads.size());
+	VertexQuantizer::encode(g_format, f.lines.data(), f.lines.size(), f.offset,
+							f.scale, f.packedLines.data(), threadPool);
+	VertexQuantizer::encode(g_format, f.quads.data(), f.quads.size(), f.offset,
+							f.scale, f.packedQuads.data(), threadPool);
 }
+
+void uploadFrame(Frame const &f)
+{
+	PROFILE_SCOPE("upload");
+	g_simMs = f.simMs;
+	uploadRestLengths(f.restLengths, f.restVersion);
+	useVertexFormat(f.format);
+	g_positionOffset = f.offset;
+	g_positionScale = f.scale;
+	g_lineVerts = f.lines.size();
+	g_quadVerts = f.quads.size();
+	g_lineChunks = f.lineChunks;
+	g_quadChunks = f.quadChunks;
+	uploadGrid(f.grid, f.gridPositions);
 	
-	//Initialize the springs
-	int m = 0;
-	for(int i = 0; i < numMass; i++)
+	if(f.format != VertexQuantizer::FLOAT32)
 	{
-		for(int j = 0; j < numMass; j++)
-		{
-			rLen = getLength(&masses[i], &masses[j]);
-			
-			//Vertical lines
-			if(masses[i].position.x == masses[j].position.x && masses[i].position.z - masses[j].position.z == zSpace)
-			{
-					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCloth);	
-					springs[m] = sCloth;
-					m++;
-			}
-			
-			//Horizontal lines
-			if(masses[i].position.z == masses[j].position.z && masses[i].position.x - masses[j].position.x == xSpace)
-			{
-					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);									
-					springs.push_back(sCloth);	
-					springs[m] = sCloth;
-					m++;
-			}
-			
-			//Crossed lines
-			if(masses[i].position.z - masses[j].position.z == zSpace && masses[i].position.x - masses[j].position.x == xSpace)
-			{
-					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCloth);	
-					springs[m] = sCloth;
-					m++;
-			}			
-			
-			if(masses[i].position.z - masses[j].position.z == zSpace && masses[i].position.x - masses[j].position.x == -xSpace)
-			{
-					sCloth = initSpring(sCloth, &masses[i], &masses[j], k, rLen);
-					springs.push_back(sCloth);	
-					springs[m] = sCloth;
-					m++;
-			}		
-		}
+		glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
+		glBufferData(GL_ARRAY_BUFFER,
+					   sizeof(uint16_t) * f.packedLines.size(),
+					   f.packedLines.data(),
+					   GL_STREAM_DRAW);
+		
+		glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
+		glBufferData(GL_ARRAY_BUFFER,
+					   sizeof(uint16_t) * f.packedQuads.size(),
+					   f.packedQuads.data(),
+					   GL_STREAM_DRAW);
+		return;
 	}
 	
-	numSpring = springs.size();
-	sim3 = false;
+	glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
+	glBufferData(GL_ARRAY_BUFFER,
+				   sizeof(Vec3f) * f.lines.size(),
+				   f.lines.data(),
+				   GL_STREAM_DRAW);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
+	glBufferData(GL_ARRAY_BUFFER,
+				   sizeof(Vec3f) * f.quads.size(),
+				   f.quads.data(),
+				   GL_STREAM_DRAW);
 }
 
-void applyForces(Spring s, Mass *a, Mass *b)
+// Upload the rest lengths if the frame belongs to a new scene
+void uploadRestLengths(std::shared_ptr<vector<float> const> const &rest,
+					   int version)
 {
-	//Get current length of spring
-	float springLength = getLength(s.a, s.b);
-	vec3 unitAB = (s.b->position - s.a->position)/springLength;
-	
-	//hooke = -k(x-x0)AB
-	vec3 hooke = (-s.stiffness)*(springLength - s.restLength)*unitAB;
+	if(!rest || version == g_uploadedRestVersion)
+		return;
+	g_uploadedRestVersion = version;
 	
-	vec3 bAcc = hooke/(s.b->mass);
-	vec3 aAcc = -bAcc;
+	glBindBuffer(GL_ARRAY_BUFFER, line_restBufferID);
+	glBufferData(GL_ARRAY_BUFFER,
+				   sizeof(float) * rest->size(),
+				   rest->data(),
+				   GL_STATIC_DRAW);
+}
 
-	//Update acceleration for mass *a and *b
-	s.b->acc += bAcc;
-	s.a->acc += aAcc;
-}	
-	
-void resolveForces(Mass *m)
-{	
-	//apply gravity and damping
-	vec3 gravity = vec3(0.f,-9.81f,0.f);
-	
-	vec3 vDamping = ((-damping)*(m->velocity))/m->mass;
+// Upload the coarse grid positions, rebuilding the fine mesh if the grid
+// changed
+void uploadGrid(ivec3 grid, vector<Vec3f> const &positions)
+{
+	if(positions.empty())
+	{
+		g_skinIndices = 0;
+		return;
+	}
 	
-	//apply all accelerations
-	m->acc = m->acc + gravity + vDamping;
+	if(grid != skinMesh.grid())
+	{
+		skinMesh.build(grid, SKIN_SUBDIVISIONS);
 		
+		glBindBuffer(GL_ARRAY_BUFFER, skin_vertBufferID);
+		glBufferData(GL_ARRAY_BUFFER,
+					   sizeof(float) * skinMesh.vertices().size(),
+					   skinMesh.vertices().data(),
+					   GL_STATIC_DRAW);
 		
-	if(m->fixedPoint == false)
-	{
-		if(sim3 && m->position.y < -2.f)
-		{
-			m->velocity = m->velocity + m->acc*timestep;
-			m->velocity.y = 0.f;
-			m->position = m->position + m->velocity*timestep;
-			m->position.y = -2.f;
-		}
-		else
-		{
-			m->velocity = m->velocity + m->acc*timestep;
-			m->position = m->position + m->velocity*timestep;
-		}
+		// The element buffer binding belongs to the bound VAO
+		glBindVertexArray(skin_vaoID);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skin_indexBufferID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+					   sizeof(uint32_t) * skinMesh.indices().size(),
+					   skinMesh.indices().data(),
+					   GL_STATIC_DRAW);
+		glBindVertexArray(0);
 	}
 	
-	m->acc = vec3(0,0,0);
-}
-
-void displayFunc() {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  // Use our shader
-  glUseProgram(basicProgramID);
-
-  // ===== DRAW QUAD ====== //
-  MVP = P * V * M;
-  reloadMVPUniform();
-  reloadColorUniform(0, 0, 1);
-
-  // Use VAO that holds buffer bindings
-  // and attribute config of buffers
-  glBindVertexArray(vaoID);
-  // Draw Quads, start at vertex 0, draw 4 of them (for a quad)
-  glDrawArrays(GL_TRIANGLES, 0, 6*numMass);
-
-  // ==== DRAW LINE ===== //
-  MVP = P * V * line_M;
-  reloadMVPUniform();
-
-  reloadColorUniform(0, 1, 1);
-
-  // Use VAO that holds buffer bindings
-  // and attribute config of buffers
-  glBindVertexArray(line_vaoID);
-  // Draw lines
-  glDrawArrays(GL_LINES, 0, 2*numSpring);
+	glBindBuffer(GL_ARRAY_BUFFER, skin_gridBufferID);
+	glBufferData(GL_ARRAY_BUFFER,
+				   sizeof(Vec3f) * positions.size(),
+				   positions.data(),
+				   GL_STREAM_DRAW);
+	
+	g_skinIndices = skinMesh.indices().size();
 }
 
-void animateQuad(Mass m) 
-{
-	 verts2.push_back(Vec3f(m.position.x-0.05f, m.position.y-0.05f, m.position.z));
-	 verts2.push_back(Vec3f(m.position.x-0.05f, m.position.y+0.05f, m.position.z));
-     verts2.push_back(Vec3f(m.position.x+0.05f, m.position.y-0.05f, m.position.z));
-			  
-	 verts2.push_back(Vec3f(m.position.x+0.05f, m.position.y+0.05f, m.position.z));
-	 verts2.push_back(Vec3f(m.position.x-0.05f, m.position.y+0.05f, m.position.z));  
-	 verts2.push_back(Vec3f(m.position.x+0.05f, m.position.y-0.05f, m.position.z));
-
-	  glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
-	  glBufferData(GL_ARRAY_BUFFER,
-				   sizeof(Vec3f) * (6*numMass), // byte size of Vec3f, 4 of them
-				   verts2.data(),      // pointer (Vec3f*) to contents of verts
-				   GL_STATIC_DRAW);   // Usage pattern of GPU buffer*/
-}
-
-void animateSpring(Spring s)
+// Point the position attribute of both VAOs (and the line texture
+// buffer) at the given format
+void useVertexFormat(VertexQuantizer::Format format)
 {
-	verts.push_back(Vec3f(s.a->position.x, s.a->position.y, s.a->position.z));
-	verts.push_back(Vec3f(s.b->position.x, s.b->position.y, s.b->position.z));
-	  
-	 glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
-	 glBufferData(GL_ARRAY_BUFFER,
-				   sizeof(Vec3f) * (2*numSpring), // byte size of Vec3f, 4 of them
-				   verts.data(),      // pointer (Vec3f*) to contents of verts
-				   GL_STATIC_DRAW);   // Usage pattern of GPU buffer
+	if(format == g_vertexFormat)
+		return;
+	g_vertexFormat = format;
+	
+	GLuint vaos[2] = {vaoID, line_vaoID};
+	GLuint buffers[2] = {vertBufferID, line_vertBufferID};
+	for(int i = 0; i < 2; i++)
+	{
+		glBindVertexArray(vaos[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+		glVertexAttribPointer(0, 3,
+							  VertexQuantizer::glType(format),
+							  VertexQuantizer::glNormalized(format),
+							  0, (void *)0);
+	}
+	glBindVertexArray(0);
+	
+	glBindTexture(GL_TEXTURE_BUFFER, line_positionTexID);
+	glTexBuffer(GL_TEXTURE_BUFFER, VertexQuantizer::glTexelFormat(format),
+				line_vertBufferID);
 }
 
 void setupVAO() {
+  // One chunk's LOD order for quads (6 vertices) and lines (2 vertices)
+  vector<uint16_t> quadIndices, lineIndices;
+  ChunkCuller::lodIndices(6, quadIndices);
+  ChunkCuller::lodIndices(2, lineIndices);
+
   glBindVertexArray(vaoID);
 
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * quadIndices.size(),
+               quadIndices.data(), GL_STATIC_DRAW);
+
   glEnableVertexAttribArray(0); // match layout # in shader
   glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
   glVertexAttribPointer(0,        // attribute layout # above
@@ -655,6 +717,10 @@ void setupVAO() {
 
   glBindVertexArray(line_vaoID);
 
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, line_indexBufferID);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * lineIndices.size(),
+               lineIndices.data(), GL_STATIC_DRAW);
+
   glEnableVertexAttribArray(0); // match layout # in shader
   glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
   glVertexAttribPointer(0,        // attribute layout # above
@@ -665,7 +731,34 @@ void setupVAO() {
                         (void *)0 // array buffer offset
                         );
 
+  // Rest lengths for strain_vs.glsl
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, line_restBufferID);
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
   glBindVertexArray(0); // reset to default
+
+  // Texel i of the texture buffer is float i of the line vertices
+  glBindTexture(GL_TEXTURE_BUFFER, line_positionTexID);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, line_vertBufferID);
+
+  // Skinned mesh: grid coordinate and face axes, see SkinnedMesh.h. The
+  // element buffer is bound here so it is part of the VAO.
+  glBindVertexArray(skin_vaoID);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skin_indexBufferID);
+  glBindBuffer(GL_ARRAY_BUFFER, skin_vertBufferID);
+  GLsizei stride = SkinnedMesh::VERTEX_FLOATS * sizeof(float);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+                        (void *)(3 * sizeof(float)));
+  glBindVertexArray(0);
+
+  // A buffer name is only an object once it has been bound
+  glBindBuffer(GL_TEXTURE_BUFFER, skin_gridBufferID);
+  glBindTexture(GL_TEXTURE_BUFFER, skin_gridTexID);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, skin_gridBufferID);
 }
 
 void reloadProjectionMatrix() {
@@ -708,117 +801,561 @@ void reloadColorUniform(float r, float g, float b) {
               r, g, b);
 }
 
+void reloadPositionUniforms() {
+  glUseProgram(basicProgramID);
+  glUniform3f(glGetUniformLocation(basicProgramID, "positionOffset"),
+              g_positionOffset.x, g_positionOffset.y, g_positionOffset.z);
+  glUniform3f(glGetUniformLocation(basicProgramID, "positionScale"),
+              g_positionScale.x, g_positionScale.y, g_positionScale.z);
+}
+
+void reloadStrainUniforms() {
+  glUseProgram(strainProgramID);
+  glUniformMatrix4fv(glGetUniformLocation(strainProgramID, "MVP"), 1, GL_TRUE,
+                     MVP.data());
+  glUniform3f(glGetUniformLocation(strainProgramID, "positionOffset"),
+              g_positionOffset.x, g_positionOffset.y, g_positionOffset.z);
+  glUniform3f(glGetUniformLocation(strainProgramID, "positionScale"),
+              g_positionScale.x, g_positionScale.y, g_positionScale.z);
+  glUniform1f(glGetUniformLocation(strainProgramID, "strainRange"),
+              g_strainRange);
+
+  glUniform1i(glGetUniformLocation(strainProgramID, "linePositions"), 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, line_positionTexID);
+}
+
+void reloadSkinUniforms() {
+  ivec3 grid = skinMesh.grid();
+
+  glUseProgram(skinProgramID);
+  glUniformMatrix4fv(glGetUniformLocation(skinProgramID, "MVP"), 1, GL_TRUE,
+                     MVP.data());
+  glUniform3f(glGetUniformLocation(skinProgramID, "inputColor"), 0.9f, 0.6f,
+              0.3f);
+  glUniform3i(glGetUniformLocation(skinProgramID, "gridSize"), grid.x,
+              grid.y, grid.z);
+
+  glUniform1i(glGetUniformLocation(skinProgramID, "gridPositions"), 1);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, skin_gridTexID);
+  glActiveTexture(GL_TEXTURE0);
+}
+
 void generateIDs() {
+  // Read the shader files in parallel; only the GL calls need this thread
+  std::string vsSource, fsSource, strainSource, skinSource;
+  std::string textVsSource, textFsSource;
+  TaskGraph load;
+  load.add([&] {
+    vsSource = loadShaderStringfromFile("./shaders/basic_vs.glsl");
+  });
+  load.add([&] {
+    fsSource = loadShaderStringfromFile("./shaders/basic_fs.glsl");
+  });
+  load.add([&] {
+    strainSource = loadShaderStringfromFile("./shaders/strain_vs.glsl");
+  });
+  load.add([&] {
+    skinSource = loadShaderStringfromFile("./shaders/skin_vs.glsl");
+  });
+  load.add([&] {
+    textVsSource = loadShaderStringfromFile("./shaders/text_vs.glsl");
+  });
+  load.add([&] {
+    textFsSource = loadShaderStringfromFile("./shaders/text_fs.glsl");
+  });
+  load.run(threadPool);
+
   // shader ID from OpenGL
-  std::string vsSource = loadShaderStringfromFile("./shaders/basic_vs.glsl");
-  std::string fsSource = loadShaderStringfromFile("./shaders/basic_fs.glsl");
   basicProgramID = CreateShaderProgram(vsSource, fsSource);
+  strainProgramID = CreateShaderProgram(strainSource, fsSource);
+  skinProgramID = CreateShaderProgram(skinSource, fsSource);
+  overlay.create(textVsSource, textFsSource);
+  gpuTimer.create(GPU_PASSES);
 
   // VAO and buffer IDs given from OpenGL
   glGenVertexArrays(1, &vaoID);
   glGenBuffers(1, &vertBufferID);
+  glGenBuffers(1, &indexBufferID);
   glGenVertexArrays(1, &line_vaoID);
   glGenBuffers(1, &line_vertBufferID);
+  glGenBuffers(1, &line_restBufferID);
+  glGenBuffers(1, &line_indexBufferID);
+  glGenTextures(1, &line_positionTexID);
+
+  glGenVertexArrays(1, &skin_vaoID);
+  glGenBuffers(1, &skin_vertBufferID);
+  glGenBuffers(1, &skin_indexBufferID);
+  glGenBuffers(1, &skin_gridBufferID);
+  glGenTextures(1, &skin_gridTexID);
 }
 
 void deleteIDs() {
   glDeleteProgram(basicProgramID);
+  glDeleteProgram(strainProgramID);
+  glDeleteProgram(skinProgramID);
+  overlay.destroy();
+  gpuTimer.destroy();
 
   glDeleteVertexArrays(1, &vaoID);
   glDeleteBuffers(1, &vertBufferID);
+  glDeleteBuffers(1, &indexBufferID);
   glDeleteVertexArrays(1, &line_vaoID);
   glDeleteBuffers(1, &line_vertBufferID);
+  glDeleteBuffers(1, &line_restBufferID);
+  glDeleteBuffers(1, &line_indexBufferID);
+  glDeleteTextures(1, &line_positionTexID);
+
+  glDeleteVertexArrays(1, &skin_vaoID);
+  glDeleteBuffers(1, &skin_vertBufferID);
+  glDeleteBuffers(1, &skin_indexBufferID);
+  glDeleteBuffers(1, &skin_gridBufferID);
+  glDeleteTextures(1, &skin_gridTexID);
 }
 
 void init() {
   glEnable(GL_DEPTH_TEST);
   glPointSize(50);
 
-  camera = Camera(Vec3f{0, 0, 7}, Vec3f{0, 0, -1}, Vec3f{0, 1, 0});
-
   // SETUP SHADERS, BUFFERS, VAOs
 
   generateIDs();
   setupVAO();
 
+  initView();
+  reloadMVPUniform();
+}
+
+// Camera and matrices, shared with the software renderer (no GL)
+void initView() {
+  camera = Camera(Vec3f{0, 0, 7}, Vec3f{0, 0, -1}, Vec3f{0, 1, 0});
+
   loadModelViewMatrix();
   reloadProjectionMatrix();
   setupModelViewProjectionTransform();
-  reloadMVPUniform();
+}
+
+// Simulate and draw every frame with the CPU rasterizer into the
+// --record target; no window, context or GL call is involved
+int softwareMain(int sim) {
+  initView();
+  if (g_numa)
+    pinThreads();
+  loadSim(sim);
+  if (g_perf)
+    PerfCounters::enable();
+
+  FILE *pipe = NULL;
+  string pattern;
+  if (g_recordTarget[0] == '|') {
+    // A write to an encoder that has exited then fails with EPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+    pipe = popen(g_recordTarget.c_str() + 1, "w");
+    if (!pipe) {
+      std::cerr << "Cannot run " << g_recordTarget.c_str() + 1 << std::endl;
+      return -1;
+    }
+  } else {
+    // Built once so writing a frame does not allocate
+    pattern = g_recordTarget;
+    if (pattern.find('%') == string::npos)
+      pattern += "/frame_%05d.png";
+    if (!FrameRecorder::validPattern(pattern)) {
+      std::cerr << g_recordTarget << " needs exactly one integer conversion"
+                << " such as %05d" << std::endl;
+      return -1;
+    }
+  }
+
+  SoftwareRasterizer image;
+  image.resize(WIN_WIDTH, WIN_HEIGHT);
+  Frame frame;
+
+  int frames = 0;
+  bool written = true;
+  auto start = std::chrono::steady_clock::now();
+  while (g_maxFrames == 0 || frames < g_maxFrames) {
+    Profiler::nextFrame();
+    AllocCounter::nextFrame();
+    if (frames == ALLOC_WARMUP_FRAMES)
+      startAllocCount();
+    PROFILE_SCOPE("frame");
+    simulateFrame(frame);
+
+    // Same order and colours as displayFunc
+    image.begin(vec3(0.f));
+    Mat4f::multiply(P, V, PV);
+    Mat4f::multiply(PV, M, MVP);
+    image.setTransform(MVP);
+    image.drawTriangles(frame.quads.data(), frame.quads.size(),
+                        vec3(0, 0, 1));
+    Mat4f::multiply(PV, line_M, MVP);
+    image.setTransform(MVP);
+    image.drawLines(frame.lines.data(), frame.lines.size(), vec3(0, 1, 1));
+    image.finish(threadPool);
+
+    if (!writeSoftwareFrame(image, pipe, pattern, frames)) {
+      std::cerr << "Write failed at frame " << frames << std::endl;
+      written = false;
+      break;
+    }
+    ++frames;
+  }
+
+  if (pipe)
+    pclose(pipe);
+  bool ok = finishProfile();
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+  std::cout << "Rendered " << frames << " frames in software ("
+            << frames / std::max(seconds, 1e-9) << " fps)" << std::endl;
+  return ok && written ? 0 : 1;
+}
+
+// A pipe gets a PPM stream; files are PPM if the target ends in .ppm
+// and PNG otherwise (a directory gets frame_%05d.png)
+bool writeSoftwareFrame(SoftwareRasterizer const &image, FILE *pipe,
+                        string const &pattern, int index) {
+  PROFILE_SCOPE("write");
+  if (pipe)
+    return image.writePPM(pipe);
+
+  bool ppm = pattern.size() >= 4 &&
+             pattern.compare(pattern.size() - 4, 4, ".ppm") == 0;
+
+  char name[1024];
+  int n = std::snprintf(name, sizeof(name), pattern.c_str(), index);
+  if (n < 0 || n >= int(sizeof(name)))
+    return false;
+  FILE *out = std::fopen(name, "wb");
+  if (!out)
+    return false;
+  bool ok = ppm ? image.writePPM(out) : image.writePNG(out);
+  return std::fclose(out) == 0 && ok;
 }
 
 int main(int argc, char **argv) {
 		
-  GLFWwindow *window;
+  GLFWwindow *window = NULL;
+  int sim = 1;
+  SimdKernels::Isa isa = SimdKernels::best();
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--serial") == 0)
+      g_pipeline = false;
+    else if (strcmp(argv[i], "--headless") == 0)
+      g_headless = true;
+    else if (strcmp(argv[i], "--software") == 0)
+      g_software = true;
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      g_recordTarget = argv[++i];
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      g_maxFrames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--sim") == 0 && i + 1 < argc)
+      sim = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--perf") == 0)
+      g_perf = true;
+    else if (strcmp(argv[i], "--overlay") == 0)
+      g_overlay = true;
+    else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+      g_profileTarget = argv[++i];
+    else if (strcmp(argv[i], "--allocs") == 0)
+      g_allocReport = true;
+    else if (strcmp(argv[i], "--alloc-check") == 0)
+      g_allocCheck = true;
+    else if (strcmp(argv[i], "--numa") == 0)
+      g_numa = g_partition = true;
+    else if (strcmp(argv[i], "--huge-pages") == 0)
+      BufferPool::global().setHugePages(true);
+    else if (strcmp(argv[i], "--reorder") == 0 && i + 1 < argc) {
+      ++i;
+      if (strcmp(argv[i], "morton") == 0)
+        g_reorder = REORDER_MORTON;
+      else if (strcmp(argv[i], "hilbert") == 0)
+        g_reorder = REORDER_HILBERT;
+      else {
+        std::cerr << "Unknown mass order " << argv[i]
+                  << " (morton, hilbert)" << std::endl;
+        return -1;
+      }
+    }
+    else if (strcmp(argv[i], "--reorder-interval") == 0 && i + 1 < argc)
+      g_reorderInterval = std::max(atoi(argv[++i]), 1);
+    else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+      if (!SimdKernels::parse(argv[++i], isa)) {
+        std::cerr << "Unknown instruction set " << argv[i]
+                  << " (sse2, sse4.2, avx2, avx512)" << std::endl;
+        return -1;
+      }
+    }
+  }
 
-  if (!glfwInit()) {
-    exit(EXIT_FAILURE);
+  // The kernel variant is fixed before any thread runs a step
+  if (!SimdKernels::select(isa)) {
+    std::cerr << "This CPU does not support " << SimdKernels::name(isa)
+              << std::endl;
+    return -1;
   }
+  std::cout << "SIMD kernels: " << SimdKernels::name(isa) << std::endl;
 
-  glfwWindowHint(GLFW_SAMPLES, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  if (g_reorder != REORDER_OFF)
+    reorder.setInterval(g_reorderInterval);
 
-  window =
-      glfwCreateWindow(WIN_WIDTH, WIN_HEIGHT, "CPSC 587 A3", NULL, NULL);
-  if (!window) {
-    glfwTerminate();
-    exit(EXIT_FAILURE);
+  if ((g_allocReport || g_allocCheck) && !AllocCounter::compiled()) {
+    std::cerr << "Allocation counting needs make ALLOCS=1" << std::endl;
+    return -1;
   }
 
-  glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);
+  if (!g_profileTarget.empty()) {
+#ifdef A3_NO_PROFILE
+    std::cerr << "Profiling is compiled out (A3_NO_PROFILE)" << std::endl;
+#endif
+    Profiler::enable(true);
+    Profiler::setThreadName("main");
+  }
 
-  glfwSetWindowSizeCallback(window, windowSetSizeFunc);
-  glfwSetFramebufferSizeCallback(window, windowSetFramebufferSizeFunc);
-  glfwSetKeyCallback(window, windowKeyFunc);
-  glfwSetCursorPosCallback(window, windowMouseMotionFunc);
-  glfwSetMouseButtonCallback(window, windowMouseButtonFunc);
+  if ((g_headless || g_software) && g_recordTarget.empty()) {
+    std::cerr << (g_software ? "--software" : "--headless")
+              << " needs --record" << std::endl;
+    return -1;
+  }
+  // Nothing closes a run without a window
+  if ((g_headless || g_software) && g_maxFrames <= 0) {
+    std::cerr << (g_software ? "--software" : "--headless")
+              << " needs --frames N" << std::endl;
+    return -1;
+  }
+  if (sim < 1 || sim > 6)
+    sim = 1;
 
-  glfwGetFramebufferSize(window, &WIN_WIDTH, &WIN_HEIGHT);
+  if (g_software)
+    return softwareMain(sim);
 
-  // Initialize glad
-  if (!gladLoadGL()) {
-    std::cerr << "Failed to initialise GLAD" << std::endl;
-    return -1;
+  if (g_headless) {
+    if (!createHeadlessContext())
+      exit(EXIT_FAILURE);
+
+    if (!gladLoadGLLoader((GLADloadproc)headlessProcAddress)) {
+      std::cerr << "Failed to initialise GLAD" << std::endl;
+      return -1;
+    }
+  } else {
+    if (!glfwInit()) {
+      exit(EXIT_FAILURE);
+    }
+
+    // Recorded frames are blitted to the window, which needs a single
+    // sample default framebuffer (the recording has its own samples)
+    glfwWindowHint(GLFW_SAMPLES, g_recordTarget.empty() ? 4 : 0);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window =
+        glfwCreateWindow(WIN_WIDTH, WIN_HEIGHT, "CPSC 587 A3", NULL, NULL);
+    if (!window) {
+      glfwTerminate();
+      exit(EXIT_FAILURE);
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(1);
+
+    glfwSetWindowSizeCallback(window, windowSetSizeFunc);
+    glfwSetFramebufferSizeCallback(window, windowSetFramebufferSizeFunc);
+    glfwSetKeyCallback(window, windowKeyFunc);
+    glfwSetCursorPosCallback(window, windowMouseMotionFunc);
+    glfwSetMouseButtonCallback(window, windowMouseButtonFunc);
+
+    glfwGetFramebufferSize(window, &WIN_WIDTH, &WIN_HEIGHT);
+
+    // Initialize glad
+    if (!gladLoadGL()) {
+      std::cerr << "Failed to initialise GLAD" << std::endl;
+      return -1;
+    }
   }
 
   std::cout << "GL Version: :" << glGetString(GL_VERSION) << std::endl;
   std::cout << GL_ERROR() << std::endl;
 
   init(); 
-  initSim1();
+  if (g_numa && !g_pipeline)
+    pinThreads();
+  loadSim(sim);
+
+  if (!g_recordTarget.empty() &&
+      !recorder.start(WIN_WIDTH, WIN_HEIGHT, RECORD_SAMPLES, g_recordTarget))
+    exit(EXIT_FAILURE);
+
+  if (g_pipeline)
+    g_physicsThread = std::thread(physicsLoop);
+
+  // After every thread exists: counters are opened per thread
+  if (g_perf)
+    PerfCounters::enable();
   
   //Calculate spring/mass positions, display simulations
-  while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-         !glfwWindowShouldClose(window)) {
-
-    for(int i = 0; i < numSpring; i++)
-    {
-			applyForces(springs[i], springs[i].a, springs[i].b);
-			animateSpring(springs[i]);
+  int frames = 0;
+  bool recordFailed = false;
+  while (!window || (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
+                     !glfwWindowShouldClose(window))) {
+	Profiler::nextFrame();
+	AllocCounter::nextFrame();
+	if(frames == ALLOC_WARMUP_FRAMES)
+		startAllocCount();
+	PROFILE_SCOPE("frame");
+
+	if(!g_pipeline)
+	{
+		if(fusedActive() && g_format == VertexQuantizer::FLOAT32)
+			simulateMapped();
+		else
+		{
+			simulateFrame(g_frames.writeBuffer());
+			g_frames.publish();
+		}
 	}
 	
-	for(int i = 0; i < numMass; i++)
+	// A recording gets every simulated frame exactly once
+	bool fresh = g_frames.acquire();
+	if(g_pipeline && recorder.recording() && !fresh)
 	{
-			resolveForces(&masses[i]);
-			animateQuad(masses[i]);
+		PROFILE_SCOPE("wait frame");
+		while(!fresh)
+		{
+			std::this_thread::yield();
+			fresh = g_frames.acquire();
+		}
 	}
 	
+	if(fresh)
+	{
+		auto start = std::chrono::steady_clock::now();
+		uploadFrame(g_frames.readBuffer());
+		g_uploadMs = millisecondsSince(start);
+		
+		if(g_pipeline)
+		{
+			std::lock_guard<std::mutex> lock(g_physicsMutex);
+			g_frameTaken = true;
+			g_physicsWake.notify_one();
+		}
+	}
+	
+	if(recorder.recording())
+		recorder.beginFrame();
+	
     displayFunc();
-    verts.clear();	
-    verts2.clear();
-    	
+	if(g_overlay)
+		drawOverlay();
+    
+	if(recorder.recording())
+	{
+		PROFILE_SCOPE("record");
+		recorder.endFrame();
+		if(window)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			recorder.blitToScreen(width, height);
+		}
+		// A dead encoder or a full disk ends the recording, and a run
+		// without a window with it
+		if(recorder.failed())
+		{
+			ALLOC_ALLOW();
+			recorder.stop();
+			recordFailed = true;
+			std::cerr << "Recording stopped after "
+			          << recorder.framesWritten() << " frames" << std::endl;
+			if(!window)
+				break;
+		}
+	}
+	
+	if(++frames == g_maxFrames)
+		break;
+	if(!window)
+		continue;
+	
     moveCamera();
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    {
+      PROFILE_SCOPE("swap");
+      glfwSwapBuffers(window);
+    }
+    {
+      // Key callbacks may rebuild the scene
+      ALLOC_ALLOW();
+      glfwPollEvents();
+    }
   }
+  AllocCounter::forbid(false);
 
   // clean up after loop
+  if (g_physicsThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(g_physicsMutex);
+      g_running = false;
+    }
+    g_physicsWake.notify_one();
+    g_physicsThread.join();
+  }
+
+  if (recorder.recording()) {
+    recorder.stop();
+    std::cout << "Recorded " << recorder.framesWritten() << " frames"
+              << std::endl;
+  }
+
+  bool ok = finishProfile();
   deleteIDs();
-  return 0;
+  if (g_headless)
+    destroyHeadlessContext();
+  return ok && !recordFailed ? 0 : 1;
+}
+
+// Count from here on: the warm-up frames have sized every buffer
+void startAllocCount() {
+  AllocCounter::reset();
+  g_poolAllocations = BufferPool::global().systemAllocations();
+  if (g_allocCheck)
+    AllocCounter::forbid(true);
+}
+
+// Exit reports; false if --alloc-check saw the buffer pool grow
+bool finishProfile() {
+  AllocCounter::forbid(false);
+  if (g_allocReport || g_allocCheck) {
+    std::cout << "After the first " << ALLOC_WARMUP_FRAMES << " frames: ";
+    AllocCounter::report(std::cout);
+    BufferPool::global().report(std::cout);
+  }
+  int64_t poolGrowth =
+      BufferPool::global().systemAllocations() - g_poolAllocations;
+  bool ok = !g_allocCheck || poolGrowth == 0;
+  if (!ok)
+    std::cerr << "The buffer pool allocated " << poolGrowth
+              << " buffers after the warm-up" << std::endl;
+
+  if (PerfCounters::enabled()) {
+    PerfCounters::disable();
+    PerfCounters::report(std::cout);
+  }
+
+  if (g_profileTarget.empty())
+    return ok;
+
+  Profiler::enable(false);
+  Profiler::writeReport(std::cout);
+  if (Profiler::writeChromeTrace(g_profileTarget.c_str()))
+    std::cout << "Trace written to " << g_profileTarget << std::endl;
+  else
+    std::cerr << "Cannot write " << g_profileTarget << std::endl;
+  return ok;
 }
 
 //==================== CALLBACK FUNCTIONS ====================//
@@ -891,16 +1428,192 @@ void windowKeyFunc(GLFWwindow *window, int key, int scancode, int action,
     g_moveUpDown = set ? 1 : 0;
     break;
   case GLFW_KEY_1:
-	initSim1();
+	runCommand([] { loadSim(1); });
 	break;
   case GLFW_KEY_2:
-    initSim2();
+    runCommand([] { loadSim(2); });
     break;
   case GLFW_KEY_3:
-	initSim3();
+	runCommand([] { loadSim(3); });
 	break;
   case GLFW_KEY_4:
-    initSim4();
+    runCommand([] { loadSim(4); });
+    break;
+  case GLFW_KEY_5:
+    runCommand([] { loadSim(5); });
+    break;
+  case GLFW_KEY_6:
+    runCommand([] { loadSim(6); });
+    break;
+  case GLFW_KEY_O:
+    // Cycle mass order: initSim order -> Morton -> Hilbert
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_reorder = Reorder((g_reorder + 1) % 3);
+        g_reorderBeforeCull = g_reorder;
+        reorder.setInterval(g_reorder != REORDER_OFF ? g_reorderInterval
+                                                     : 0);
+        std::cout << (g_reorder == REORDER_OFF
+                          ? "Scene order"
+                          : g_reorder == REORDER_MORTON ? "Morton order"
+                                                        : "Hilbert order")
+                  << std::endl;
+        loadSim(g_sim);
+      });
+    }
+    break;
+  case GLFW_KEY_L:
+    // Stencil lattice version of the jello cube and the cloth
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_lattice = !g_lattice;
+        std::cout << (g_lattice ? "Lattice kernel" : "Spring array")
+                  << std::endl;
+        loadSim(g_sim);
+      });
+    }
+    break;
+  case GLFW_KEY_G:
+    // Per-thread domains for the force solver
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_partition = !g_partition;
+        sceneChanged();
+        if (g_partition)
+          std::cout << "Partitioned force solver (" << domains.numDomains()
+                    << " domains, " << domains.numHaloSlots()
+                    << " halo slots)" << std::endl;
+        else
+          std::cout << "Force solver" << std::endl;
+      });
+    }
+    break;
+  case GLFW_KEY_F:
+    // Fused integrate-and-pack for the force solver
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_fused = !g_fused;
+        std::cout << (g_fused ? "Fused force step" : "Separate force step")
+                  << std::endl;
+      });
+    }
+    break;
+  case GLFW_KEY_U:
+    // Cycle the vertex upload format
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_format = VertexQuantizer::Format((g_format + 1) % 3);
+        std::cout << (g_format == VertexQuantizer::FLOAT32
+                          ? "Upload 3 x float"
+                          : g_format == VertexQuantizer::UNORM16
+                                ? "Upload 3 x unorm16 over the bounding box"
+                                : "Upload 3 x half float")
+                  << std::endl;
+      });
+    }
+    break;
+  case GLFW_KEY_V:
+    // Colour the springs by strain (render side only)
+    if (action == GLFW_PRESS) {
+      g_strain = !g_strain;
+      std::cout << (g_strain ? "Strain colouring" : "Plain lines")
+                << std::endl;
+    }
+    break;
+  case GLFW_KEY_H:
+    // Frame-time overlay (render side only)
+    if (action == GLFW_PRESS)
+      g_overlay = !g_overlay;
+    break;
+  case GLFW_KEY_C:
+    // Chunked frustum culling and LOD
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_cull = !g_cull;
+        // Chunks are runs of consecutive elements, so they need the
+        // scene in a space-filling-curve order to be compact. The scene
+        // keeps the order it has when culling is turned off; only the
+        // periodic re-sort stops if culling started it.
+        if (g_cull) {
+          g_reorderBeforeCull = g_reorder;
+          if (g_reorder == REORDER_OFF) {
+            g_reorder = REORDER_MORTON;
+            reorder.setInterval(g_reorderInterval);
+            reorderMasses();
+            sceneChanged();
+          }
+        } else {
+          g_reorder = g_reorderBeforeCull;
+          reorder.setInterval(g_reorder != REORDER_OFF ? g_reorderInterval
+                                                       : 0);
+        }
+        std::cout << (g_cull ? "Chunk culling and LOD" : "Draw everything")
+                  << std::endl;
+      });
+    }
+    break;
+  case GLFW_KEY_M:
+    // Fine mesh skinned to the grid of sims 3 and 4
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_skin = !g_skin;
+        std::cout << (g_skin ? "Skinned mesh (sims 3 and 4)" : "Mass quads")
+                  << std::endl;
+      });
+    }
+    break;
+  case GLFW_KEY_X:
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        g_solver = (g_solver == XPBD_SOLVER) ? FORCE_SOLVER : XPBD_SOLVER;
+        if (g_solver == XPBD_SOLVER && g_xpbdStale) {
+          xpbd.rebuild(masses, springs);
+          g_xpbdStale = false;
+        }
+        std::cout << (g_solver == XPBD_SOLVER ? "XPBD solver"
+                                              : "Force solver")
+                  << std::endl;
+      });
+    }
+    break;
+  case GLFW_KEY_T:
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        if (g_solver == TREE_SOLVER) {
+          g_solver = FORCE_SOLVER;
+          std::cout << "Force solver" << std::endl;
+        } else if (treeSolver.isTree()) {
+          g_solver = TREE_SOLVER;
+          if (g_treeStale) {
+            treeSolver.rebuild(masses, springs);
+            g_treeStale = false;
+          }
+          std::cout << "Tree solver (" << treeSolver.numStrands()
+                    << " strands)" << std::endl;
+        } else {
+          std::cout << "Tree solver needs a scene without spring loops"
+                    << std::endl;
+        }
+      });
+    }
+    break;
+  case GLFW_KEY_J:
+    // Cycle XPBD iteration: Gauss-Seidel -> Jacobi -> Jacobi + Chebyshev
+    if (action == GLFW_PRESS) {
+      runCommand([] {
+        if (xpbd.mode() == XPBDSolver::GAUSS_SEIDEL) {
+          xpbd.setMode(XPBDSolver::JACOBI);
+          xpbd.setChebyshev(false);
+          std::cout << "XPBD Jacobi" << std::endl;
+        } else if (!xpbd.chebyshev()) {
+          xpbd.setChebyshev(true);
+          std::cout << "XPBD Jacobi + Chebyshev" << std::endl;
+        } else {
+          xpbd.setMode(XPBDSolver::GAUSS_SEIDEL);
+          std::cout << "XPBD Gauss-Seidel" << std::endl;
+        }
+      });
+    }
     break;
   default:
     break;
@@ -909,6 +1622,399 @@ void windowKeyFunc(GLFWwindow *window, int key, int scancode, int action,
 
 //==================== OPENGL HELPER FUNCTIONS ====================//
 
+// Advance the current scene by one timestep
+void stepSimulation() {
+  PROFILE_SCOPE("step");
+  PERF_PHASE("step");
+  stepArena.reset();
+
+  // Large deformations drift away from the curve order. The re-sort
+  // waits while the frames in flight still hold the spare rest lengths.
+  if (g_reorder != REORDER_OFF && spareRestBuffer().use_count() == 1 &&
+      reorder.tick()) {
+    PROFILE_SCOPE("resort");
+    resortMasses();
+  }
+
+  if (strands.numStrands() > 0)
+    strands.step(timestep, threadPool);
+  else if (lattice.size() > 0)
+    lattice.step(timestep, threadPool);
+  else if (g_solver == XPBD_SOLVER)
+    xpbd.step(masses, springs, timestep, threadPool);
+  else if (g_solver == TREE_SOLVER)
+    treeSolver.step(masses, springs, timestep, threadPool);
+  else if (g_partition) {
+    if (g_placeDomains) {
+      ALLOC_ALLOW();
+      domains.place(masses, springs, threadPool);
+      g_placeDomains = false;
+    }
+    domains.step(masses, springs, threadPool);
+  }
+  else if (fusedActive()) {
+    PERF_PHASE("fused step");
+    fused.step(masses, springs, forceColouring, g_packLines, g_packQuads,
+               threadPool);
+  }
+  else {
+    {
+      PROFILE_SCOPE("applyForces");
+      PERF_PHASE("spring forces");
+      forceColouring.applyForces(springs, threadPool);
+    }
+    char *contacts = stepArena.allocate<char>(numMass);
+    {
+      PERF_PHASE("collision");
+      threadPool.parallelFor(0, numMass, MASS_GRAIN, [&](int begin, int end) {
+        floorContacts(masses.data() + begin, end - begin, contacts + begin);
+      });
+    }
+    {
+      PROFILE_SCOPE("resolveForces");
+      PERF_PHASE("integration");
+      threadPool.parallelFor(0, numMass, MASS_GRAIN, [&](int begin, int end) {
+        integrateMasses(masses.data() + begin, contacts + begin, end - begin);
+      });
+    }
+  }
+}
+
+// True when the step also packs the frame (plain force solver scenes)
+bool fusedActive() {
+  return g_fused && g_solver == FORCE_SOLVER && !g_partition &&
+         strands.numStrands() == 0 && lattice.size() == 0;
+}
+
+// Advance one step and leave the result in f
+void simulateFrame(Frame &f) {
+  PROFILE_SCOPE("simulate");
+  auto start = std::chrono::steady_clock::now();
+  if (fusedActive()) {
+    f.lines.resize(2 * numSpring);
+    f.quads.resize(6 * numMass);
+    g_packLines = reinterpret_cast<float *>(f.lines.data());
+    g_packQuads = reinterpret_cast<float *>(f.quads.data());
+    stepSimulation();
+  } else {
+    stepSimulation();
+    packFrame(f);
+  }
+
+  if (g_cull) {
+    PROFILE_SCOPE("bounds");
+    ChunkCuller::bounds(f.lines.data(), f.lines.size() / 2, 2, f.lineChunks,
+                        threadPool);
+    ChunkCuller::bounds(f.quads.data(), f.quads.size() / 6, 6, f.quadChunks,
+                        threadPool);
+  } else {
+    f.lineChunks.clear();
+    f.quadChunks.clear();
+  }
+
+  encodeFrame(f);
+  packGrid(f.grid, f.gridPositions);
+  f.restLengths = g_restLengths;
+  f.restVersion = g_restVersion;
+  f.simMs = millisecondsSince(start);
+}
+
+// Fused step straight into mapped GL buffers. Only the GL thread can map
+// them, so the pipelined path packs into the frame instead.
+void simulateMapped() {
+  PROFILE_SCOPE("simulate");
+  auto start = std::chrono::steady_clock::now();
+  uploadRestLengths(g_restLengths, g_restVersion);
+  useVertexFormat(VertexQuantizer::FLOAT32);
+  g_positionOffset = vec3(0.f);
+  g_positionScale = vec3(1.f);
+
+  GLsizeiptr lineBytes = sizeof(Vec3f) * 2 * numSpring;
+  GLsizeiptr quadBytes = sizeof(Vec3f) * 6 * numMass;
+  GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+
+  // Orphan last frame's storage so the map does not wait for the GPU
+  glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
+  glBufferData(GL_ARRAY_BUFFER, lineBytes, NULL, GL_STREAM_DRAW);
+  void *lines = lineBytes > 0
+                    ? glMapBufferRange(GL_ARRAY_BUFFER, 0, lineBytes, access)
+                    : NULL;
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
+  glBufferData(GL_ARRAY_BUFFER, quadBytes, NULL, GL_STREAM_DRAW);
+  void *quads = quadBytes > 0
+                    ? glMapBufferRange(GL_ARRAY_BUFFER, 0, quadBytes, access)
+                    : NULL;
+
+  Frame scratch;
+  if ((lineBytes > 0 && !lines) || (quadBytes > 0 && !quads)) {
+    // Mapping failed: go through a frame like the unfused path
+    scratch.lines.resize(2 * numSpring);
+    scratch.quads.resize(6 * numMass);
+    lines = scratch.lines.data();
+    quads = scratch.quads.data();
+  }
+
+  g_packLines = static_cast<float *>(lines);
+  g_packQuads = static_cast<float *>(quads);
+  stepSimulation();
+
+  if (!scratch.lines.empty() || !scratch.quads.empty()) {
+    uploadFrame(scratch);
+    return;
+  }
+
+  if (lineBytes > 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  if (quadBytes > 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+
+  g_lineVerts = 2 * numSpring;
+  g_quadVerts = 6 * numMass;
+
+  if (g_cull) {
+    ChunkCuller::springBounds(springs, g_lineChunks, threadPool);
+    ChunkCuller::massBounds(masses, 0.05f, g_quadChunks, threadPool);
+  } else {
+    g_lineChunks.clear();
+    g_quadChunks.clear();
+  }
+
+  ivec3 grid;
+  packGrid(grid, g_mappedGrid);
+  uploadGrid(grid, g_mappedGrid);
+  g_simMs = millisecondsSince(start);
+}
+
+// Positions of the mass grid in grid order, for the skinned mesh
+void packGrid(ivec3 &grid, vector<Vec3f> &positions) {
+  grid = massGrid;
+  int n = grid.x * grid.y * grid.z;
+  if (!g_skin || n == 0) {
+    positions.clear();
+    return;
+  }
+
+  positions.resize(n);
+  for (int g = 0; g < n; g++) {
+    vec3 p = lattice.size() > 0 ? lattice.position(g)
+                                : masses[reorder.currentIndex(g)].position;
+    positions[g].set(p.x, p.y, p.z);
+  }
+}
+
+// Pin the pool to cores, from the thread that steps the simulation
+void pinThreads() {
+  if (NumaPlacement::pinThreads(threadPool))
+    std::cout << "Pinned " << threadPool.size() << " threads on "
+              << NumaPlacement::numNodes() << " NUMA nodes" << std::endl;
+}
+
+// Physics thread: run queued commands, then simulate and publish the next
+// frame once the display has taken the previous one (so physics stays at
+// most one frame ahead and keeps the one-step-per-frame pace)
+void physicsLoop() {
+  Profiler::setThreadName("physics");
+  if (g_numa)
+    pinThreads();
+  vector<std::function<void()>> commands;
+  std::unique_lock<std::mutex> lock(g_physicsMutex);
+
+  for (;;) {
+    g_physicsWake.wait(lock, [] {
+      return !g_running || g_frameTaken || !g_commands.empty();
+    });
+    if (!g_running)
+      break;
+
+    commands.swap(g_commands);
+    bool step = g_frameTaken;
+    g_frameTaken = false;
+    lock.unlock();
+
+    {
+      ALLOC_ALLOW();
+      for (auto const &command : commands)
+        command();
+      commands.clear();
+    }
+
+    if (step) {
+      simulateFrame(g_frames.writeBuffer());
+      g_frames.publish();
+    }
+
+    lock.lock();
+  }
+}
+
+// Scene and solver changes from the key callbacks. With the pipeline on
+// they are handed to the physics thread so they never overlap a step.
+void runCommand(std::function<void()> const &command) {
+  if (!g_physicsThread.joinable()) {
+    command();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(g_physicsMutex);
+    g_commands.push_back(command);
+  }
+  g_physicsWake.notify_one();
+}
+
+// Build simulation n and refresh everything that depends on the scene
+void loadSim(int n) {
+  g_sim = n;
+
+  switch (n) {
+  case 1:
+    initSim1();
+    break;
+  case 2:
+    initSim2();
+    break;
+  case 3:
+    g_lattice ? initLatticeSim3() : initSim3();
+    break;
+  case 4:
+    g_lattice ? initLatticeSim4() : initSim4();
+    break;
+  case 5:
+    initSim5();
+    break;
+  case 6:
+    initSim6();
+    break;
+  }
+
+  reorder.reset(numMass);
+  if (g_reorder != REORDER_OFF)
+    reorderMasses();
+
+  sceneChanged();
+}
+
+// Sort masses and springs along the selected curve
+void reorderMasses() {
+  reorder.apply(masses, springs,
+                g_reorder == REORDER_HILBERT ? SpatialReorder::HILBERT
+                                             : SpatialReorder::MORTON);
+}
+
+// Periodic re-sort of the current scene. The masses and springs are
+// permuted in place and only the index tables of the solvers that use
+// them are remapped, so nothing is rebuilt on the stepping thread.
+void resortMasses() {
+  if (masses.empty())
+    return; // strands and lattice have their own layout
+
+  // Inside each domain only, so the partition stays valid
+  reorder.apply(masses, springs,
+                g_reorder == REORDER_HILBERT ? SpatialReorder::HILBERT
+                                             : SpatialReorder::MORTON,
+                g_partition ? &domains.massStart() : nullptr);
+  PoolVector<int> const &massIndex = reorder.massIndex();
+  PoolVector<int> const &springIndex = reorder.springIndex();
+
+  if (g_partition)
+    domains.remap(massIndex, springIndex);
+  forceColouring.remap(springIndex);
+  fused.rebuild(masses, springs);
+
+  if (g_solver == XPBD_SOLVER)
+    xpbd.remap(masses, springs, springIndex);
+  else
+    g_xpbdStale = true;
+  if (g_solver == TREE_SOLVER)
+    treeSolver.remap(masses, springs, massIndex, springIndex);
+  else
+    g_treeStale = true;
+
+  // Line vertices follow the spring order
+  packRestLengths();
+}
+
+// Split the masses into one graph partition per thread and make each
+// partition contiguous in memory
+void partitionMasses() {
+  int parts = threadPool.size();
+  std::vector<int> part = partitioner.partition(masses, springs, parts);
+  reorder.group(masses, springs, part);
+  domains.rebuild(masses, springs, part, parts);
+}
+
+// Rebuild per-scene solver data after an initSim call
+void sceneChanged() {
+  // Partitioning moves masses, so it goes first; the solvers only read
+  // the scene and build in parallel
+  bool isTree = false;
+  TaskGraph build;
+  int xpbdNode = build.add([] { xpbd.rebuild(masses, springs); });
+  int treeNode =
+      build.add([&] { isTree = treeSolver.rebuild(masses, springs); });
+  int fusedNode = build.add([] { fused.rebuild(masses, springs); });
+  int colourNode =
+      build.add([] { forceColouring.rebuild(masses, springs); });
+  if (g_partition) {
+    int partitionNode = build.add(partitionMasses);
+    build.precede(partitionNode, xpbdNode);
+    build.precede(partitionNode, treeNode);
+    build.precede(partitionNode, fusedNode);
+    build.precede(partitionNode, colourNode);
+  }
+  build.run(threadPool);
+  g_placeDomains = g_numa && g_partition;
+  g_xpbdStale = g_treeStale = false;
+
+  // Fall back to the force solver if the new scene has loops
+  if (!isTree && g_solver == TREE_SOLVER) {
+    g_solver = FORCE_SOLVER;
+    std::cout << "Force solver" << std::endl;
+  }
+
+  packRestLengths();
+  // Room for the repack of the next re-sort
+  std::shared_ptr<vector<float>> &spare = spareRestBuffer();
+  if (!spare || spare.use_count() > 1)
+    spare = std::make_shared<vector<float>>();
+  spare->reserve(g_restLengths->size());
+
+  // Buffers of the previous scene that the rebuild did not reuse
+  BufferPool::global().trim();
+}
+
+// The rest length buffer that is not current
+std::shared_ptr<vector<float>> &spareRestBuffer() {
+  return g_restBuffers[g_restBuffers[0] == g_restLengths ? 1 : 0];
+}
+
+// Rest length of every line vertex, in packFrame order, into the spare
+// buffer (a new one while a frame still holds it)
+void packRestLengths() {
+  std::shared_ptr<vector<float>> &rest = spareRestBuffer();
+  if (!rest || rest.use_count() > 1)
+    rest = std::make_shared<vector<float>>();
+  rest->clear();
+
+  if (strands.numStrands() > 0)
+    strands.packRestLengths(*rest);
+  else if (lattice.size() > 0)
+    lattice.packRestLengths(*rest);
+  else {
+    rest->reserve(2 * numSpring);
+    for (int i = 0; i < numSpring; i++)
+      rest->insert(rest->end(), 2, springs[i].restLength);
+  }
+
+  g_restLengths = rest;
+  ++g_restVersion;
+}
+
 void moveCamera() {
   Vec3f dir;
 